@@ -27,6 +27,205 @@ router.post('/config',
   }
 )
 
+router.get('/kinematics',
+  async (req, res) => {
+    const kinematics = await tools.motor.getKinematics()
+    res.json(kinematics)
+  }
+)
+
+router.post('/kinematics',
+  validator({
+    body: z.object({
+      maxVelocity: z.number().int().min(0).max(0xFFFF),
+      acceleration: z.number().int().min(0).max(0xFFFF),
+      jerk: z.number().int().min(0).max(0xFFFF).default(0)
+    }).refine(k => k.maxVelocity === 0 || k.acceleration > 0, {
+      message: 'Acceleration must be positive when maxVelocity is set'
+    })).refine(tools.motor.kinematicsFit, {
+      message: 'Ramp too long for the step counter: raise acceleration or jerk, or lower maxVelocity'
+    })
+  }),
+  async (req, res) => {
+    await tools.motor.setKinematics(res.locals.parsed.body)
+    res.sendStatus(200)
+  }
+)
+
+router.get('/axis',
+  async (req, res) => {
+    const axis = await tools.motor.getAxis()
+    res.json(axis)
+  }
+)
+
+router.post('/axis',
+  validator({
+    body: z.object({
+      axis: z.number().int().min(0).max(0xFF)
+    })
+  }),
+  async (req, res) => {
+    const { axis } = res.locals.parsed.body
+    await tools.motor.selectAxis(axis)
+    res.sendStatus(200)
+  }
+)
+
+router.post('/coordinated',
+  validator({
+    body: z.object({
+      degrees: z.array(z.number().int()).min(1)
+    })
+  }),
+  async (req, res) => {
+    const { degrees } = res.locals.parsed.body
+    await tools.motor.moveCoordinated(degrees)
+    res.sendStatus(200)
+  }
+)
+
+router.get('/free-run',
+  async (req, res) => {
+    const freeRun = await tools.motor.getFreeRun()
+    res.json(freeRun)
+  }
+)
+
+router.post('/free-run',
+  validator({
+    body: z.object({
+      velocity: z.number().int().min(0).max(0xFFFF),
+      acceleration: z.number().int().min(0).max(0xFFFF)
+    }).refine(f => f.velocity === 0 || f.acceleration > 0, {
+      message: 'Acceleration must be positive when velocity is set'
+    })
+  }),
+  async (req, res) => {
+    await tools.motor.setFreeRun(res.locals.parsed.body)
+    res.sendStatus(200)
+  }
+)
+
+router.get('/plan-cache',
+  async (req, res) => {
+    const stats = await tools.motor.getPlanCacheStats()
+    res.json(stats)
+  }
+)
+
+router.post('/plan-cache/reset',
+  async (req, res) => {
+    await tools.motor.resetPlanCacheStats()
+    res.sendStatus(200)
+  }
+)
+
+router.get('/position',
+  async (req, res) => {
+    const position = await tools.motor.getPosition()
+    res.json(position)
+  }
+)
+
+router.post('/position',
+  validator({
+    body: z.object({
+      position: z.number().int().default(0)
+    })
+  }),
+  async (req, res) => {
+    const { position } = res.locals.parsed.body
+    await tools.motor.setPosition(position)
+    res.sendStatus(200)
+  }
+)
+
+router.post('/goto',
+  validator({
+    body: z.object({
+      degrees: z.number().int()
+    })
+  }),
+  async (req, res) => {
+    const { degrees } = res.locals.parsed.body
+    await tools.motor.goTo(degrees)
+    res.sendStatus(200)
+  }
+)
+
+router.get('/latency',
+  async (req, res) => {
+    const histograms = []
+    for (let stage = 0; stage < tools.motor.LATENCY_STAGES.length; stage++) {
+      histograms.push(await tools.motor.getLatency(stage))
+    }
+    res.json(histograms)
+  }
+)
+
+router.post('/latency/reset',
+  async (req, res) => {
+    await tools.motor.resetLatency()
+    res.sendStatus(200)
+  }
+)
+
+const programStep = z.lazy(() => z.discriminatedUnion('op', [
+  z.object({ op: z.enum(['move', 'goto']), degrees: z.number().int().min(-32768).max(32767), hold: z.boolean().default(false) }),
+  z.object({ op: z.literal('dwell'), ms: z.number().int().min(0).max(0xFFFF) }),
+  z.object({ op: z.enum(['hold', 'release']) }),
+  z.object({ op: z.literal('repeat'), count: z.number().int().min(0).max(0xFFFF), body: z.array(programStep) })
+]))
+
+const programId = z.object({
+  id: z.coerce.number().int().min(0).max(254)
+})
+
+router.get('/program',
+  async (req, res) => {
+    const status = await tools.motor.getProgramStatus()
+    res.json(status)
+  }
+)
+
+router.post('/program/:id',
+  validator({
+    params: programId,
+    body: z.object({
+      steps: z.array(programStep).min(1)
+    })
+  }),
+  async (req, res) => {
+    const { id } = res.locals.parsed.params
+    const { steps } = res.locals.parsed.body
+    await tools.motor.storeProgram(id, steps)
+    res.sendStatus(200)
+  }
+)
+
+router.post('/program/:id/run',
+  validator({
+    params: programId
+  }),
+  async (req, res) => {
+    const { id } = res.locals.parsed.params
+    await tools.motor.runProgram(id)
+    res.sendStatus(200)
+  }
+)
+
+router.post('/program/:id/erase',
+  validator({
+    params: programId
+  }),
+  async (req, res) => {
+    const { id } = res.locals.parsed.params
+    await tools.motor.eraseProgram(id)
+    res.sendStatus(200)
+  }
+)
+
 router.post(
   '/profile',
   validator({
@@ -47,6 +246,30 @@ router.post(
   }
 )
 
+router.post(
+  '/profile/v2',
+  validator({
+    body: z.object({
+      moves: z.array(
+        z.object({
+          steps: z.number().int().min(-0x7FFFFFFF).max(0x7FFFFFFF),
+          factor: z.number().refine(x => [1, 2, 4, 8, 16, 32, 64, 128].includes(x), {
+            message: 'Must be a power of 2, ranged from 1 to 128 inclusive'
+          }).optional(),
+          hold: z.boolean().default(false),
+          absolute: z.boolean().default(false),
+          delay: z.number().int().nonnegative().max(0xFFFFFFFF).default(0)
+        })
+      ).min(1)
+    })
+  }),
+  async (req, res) => {
+    const { moves } = res.locals.parsed.body
+    await tools.motor.runProfileV2(moves)
+    res.sendStatus(200)
+  }
+)
+
 router.post(
   '/free',
   validator({
@@ -63,11 +286,139 @@ router.post(
 
 router.post(
   '/stop',
+  validator({
+    body: z.object({
+      decelerate: z.boolean().default(false)
+    }).default({})
+  }),
+  async (req, res) => {
+    const { decelerate } = res.locals.parsed.body
+    await tools.motor.stop({ decelerate })
+    res.sendStatus(200)
+  }
+)
+
+router.get(
+  '/last-move',
+  async (req, res) => {
+    const lastMove = await tools.motor.getLastMove()
+    res.json(lastMove)
+  }
+)
+router.get(
+  '/completions',
+  async (req, res) => {
+    const completions = await tools.motor.getCompletions()
+    res.json(completions)
+  }
+)
+router.get(
+  '/completions/status',
+  async (req, res) => {
+    const status = await tools.motor.getCompletionStatus()
+    res.json(status)
+  }
+)
+router.post(
+  '/completions/:id/wait',
+  validator({
+    params: z.object({
+      id: z.coerce.number().int().min(1)
+    })
+  }),
+  async (req, res) => {
+    const { id } = res.locals.parsed.params
+    const done = await tools.motor.waitForCompletion(id)
+    res.sendStatus(done ? 200 : 408)
+  }
+)
+router.post(
+  '/clock/sync',
+  async (req, res) => {
+    const { offsetUs, rttUs } = await tools.motor.syncClock()
+    res.json({ offsetUs: Number(offsetUs), rttUs: Number(rttUs) })
+  }
+)
+router.post(
+  '/schedule',
+  validator({
+    body: z.object({
+      degrees: z.number().int(),
+      inMs: z.number().int().min(0),
+      absolute: z.boolean().default(false),
+      coast: z.boolean().default(false)
+    })
+  }),
+  async (req, res) => {
+    const { degrees, inMs, absolute, coast } = res.locals.parsed.body
+    const startUs = tools.motor.hostNowUs() + BigInt(inMs) * 1000n
+    await tools.motor.moveAt(startUs, degrees, { absolute, coast })
+    res.json({ startUs: Number(startUs) })
+  }
+)
+router.get(
+  '/jog',
+  async (req, res) => {
+    const jog = await tools.motor.getJog()
+    res.json(jog)
+  }
+)
+router.post(
+  '/jog',
+  validator({
+    body: z.object({
+      velocity: z.number().int().min(-0x7FFFFFFF).max(0x7FFFFFFF)
+    })
+  }),
+  async (req, res) => {
+    const { velocity } = res.locals.parsed.body
+    await tools.motor.jog(velocity)
+    res.sendStatus(200)
+  }
+)
+router.get(
+  '/homing',
+  async (req, res) => {
+    const homing = await tools.motor.getHoming()
+    res.json(homing)
+  }
+)
+router.post(
+  '/homing',
+  validator({
+    body: z.object({
+      fastVelocity: z.number().int().min(1).max(0xFFFF),
+      slowVelocity: z.number().int().min(1).max(0xFFFF),
+      acceleration: z.number().int().min(1).max(0xFFFF),
+      backoffDegrees: z.number().int().min(1).max(0xFFFF),
+      touches: z.number().int().min(1).max(8)
+    })
+  }),
   async (req, res) => {
-    await tools.motor.stop()
+    await tools.motor.setHoming(res.locals.parsed.body)
     res.sendStatus(200)
   }
 )
+router.post(
+  '/home',
+  validator({
+    body: z.object({
+      dir: z.number().int().default(-1)
+    })
+  }),
+  async (req, res) => {
+    const { dir } = res.locals.parsed.body
+    await tools.motor.home(dir)
+    res.sendStatus(200)
+  }
+)
+router.get(
+  '/home/report',
+  async (req, res) => {
+    const report = await tools.motor.getHomingReport()
+    res.json(report)
+  }
+)
 router.post(
   '/hold',
   async (req, res) => {
@@ -82,6 +433,40 @@ router.post(
     res.sendStatus(200)
   }
 )
+router.post(
+  '/dwell',
+  validator({
+    body: z.object({
+      ms: z.number().int().min(0).max(0xFFFFFFFF)
+    })
+  }),
+  async (req, res) => {
+    const { ms } = res.locals.parsed.body
+    await tools.motor.dwell(ms)
+    res.sendStatus(200)
+  }
+)
+router.post(
+  '/trace/start',
+  async (req, res) => {
+    await tools.motor.startTrace()
+    res.sendStatus(200)
+  }
+)
+router.post(
+  '/trace/stop',
+  async (req, res) => {
+    await tools.motor.stopTrace()
+    res.sendStatus(200)
+  }
+)
+router.get(
+  '/trace',
+  async (req, res) => {
+    const trace = await tools.motor.readTrace()
+    res.json({ ...trace, moves: tools.motor.reconstructTrace(trace.events) })
+  }
+)
 
 
 
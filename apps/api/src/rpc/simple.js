@@ -23,8 +23,8 @@ export default (rpcRequest, {
         args: []
       })
       await rpcRequest({
-        target: 'tools',
-        method: 'sleep',
+        target: 'motor',
+        method: 'dwell',
         args: [3_000]
       })
       await rpcRequest({
@@ -85,8 +85,8 @@ export default (rpcRequest, {
       args: []
     })
     await rpcRequest({
-      target: 'tools',
-      method: 'sleep',
+      target: 'motor',
+      method: 'dwell',
       args: [3_000]
     })
     await rpcRequest({
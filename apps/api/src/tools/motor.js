@@ -20,8 +20,113 @@ export const runProfile = async (profile = [], repeat = 1) => {
       buffer.writeInt16LE(move.degrees, idx * 4)
       buffer.writeUInt16LE(move.delay, idx * 4 + 2)
     })
+    if (i > 0) {
+      // The previous chunk has to leave the queue before the next one fits
+      const { lastQueued } = await getCompletionStatus()
+      await waitForCompletion(lastQueued)
+    }
     await writeRegister(0x23, buffer)
-    await sleep(2000)
+  }
+}
+
+const PROFILE_FLAG = { long: 0x80, hold: 0x01, absolute: 0x02, delay: 0x04, factor: 0x08 }
+const PROFILE_MAX_REPEAT = 7
+const PROFILE_MAX_BYTES = 63
+const PROFILE_MAX_MOVES = 64
+
+const varint = (value) => {
+  const bytes = []
+  let v = value >>> 0
+  do {
+    const byte = v & 0x7F
+    v >>>= 7
+    bytes.push(v ? byte | 0x80 : byte)
+  } while (v)
+  return bytes
+}
+
+const zigzag = (n) => ((n << 1) ^ (n >> 31)) >>> 0
+
+/**
+ * Packs moves into v2 profile frames, each one decodable on its own (see ProfileCodec.hpp)
+ * A move like the previous one, a step delta in -64..63 apart, takes one byte
+ * @param {Array<{steps: number, factor?: number, hold?: boolean, absolute?: boolean, delay?: number}>} moves
+ * Steps at factor, which stays in effect for the moves after; without one the axis factor applies
+ * @returns {Array<Buffer>} Frames of at most 63 bytes and 64 moves
+ */
+export const encodeProfile = (moves = []) => {
+  const frames = []
+  const same = (a, b) => a.steps === b.steps && !!a.hold === !!b.hold && !!a.absolute === !!b.absolute
+    && (a.delay ?? 0) === (b.delay ?? 0) && (b.factor === undefined || b.factor === a.factor)
+  let bytes, count, prev, frameFactor
+  const startFrame = () => {
+    bytes = []
+    count = 0
+    prev = { steps: 0, hold: false, absolute: false, delay: 0 }
+    frameFactor = undefined // The axis factor, as the device starts decoding
+  }
+  startFrame()
+  let factor
+  for (let i = 0; i < moves.length;) {
+    const move = {
+      steps: moves[i].steps,
+      hold: !!moves[i].hold,
+      absolute: !!moves[i].absolute,
+      delay: moves[i].delay ?? 0,
+      factor: moves[i].factor ?? factor
+    }
+    const delta = move.steps - prev.steps
+    const short = move.hold === prev.hold && move.absolute === prev.absolute && move.delay === prev.delay
+      && move.factor === frameFactor && delta >= -64 && delta <= 63
+    let repeat = 1
+    while (repeat <= PROFILE_MAX_REPEAT && i + repeat < moves.length && same(move, moves[i + repeat])) {
+      repeat++
+    }
+    const header = PROFILE_FLAG.long | (move.hold ? PROFILE_FLAG.hold : 0) | (move.absolute ? PROFILE_FLAG.absolute : 0)
+      | (move.delay ? PROFILE_FLAG.delay : 0) | (move.factor !== frameFactor ? PROFILE_FLAG.factor : 0)
+      | ((repeat - 1) << 4)
+    let record = [
+      header,
+      ...(move.factor !== frameFactor ? [Math.log2(move.factor)] : []),
+      ...(move.delay ? varint(move.delay) : []),
+      ...varint(zigzag(move.steps))
+    ]
+    // A run of the same move is cheaper as one repeated record than as one byte each
+    if (short && record.length > repeat) {
+      record = [delta & 0x7F]
+      repeat = 1
+    }
+    if (bytes.length + record.length > PROFILE_MAX_BYTES || count + repeat > PROFILE_MAX_MOVES) {
+      frames.push(Buffer.from(bytes))
+      startFrame()
+      continue // Encoded again against the fresh frame
+    }
+    bytes.push(...record)
+    count += repeat
+    prev = move
+    frameFactor = move.factor
+    factor = move.factor
+    i += repeat
+  }
+  if (bytes.length) {
+    frames.push(Buffer.from(bytes))
+  }
+  return frames
+}
+
+/**
+ * Queues moves given in steps through the v2 profile register, a frame at a time
+ * @param {Array<object>} moves See encodeProfile
+ */
+export const runProfileV2 = async (moves = []) => {
+  const frames = encodeProfile(moves)
+  for (let i = 0; i < frames.length; i++) {
+    if (i > 0) {
+      // The previous frame has to leave the queue before the next one surely fits
+      const { lastQueued } = await getCompletionStatus()
+      await waitForCompletion(lastQueued)
+    }
+    await writeRegister(0x57, frames[i])
   }
 }
 
@@ -41,6 +146,288 @@ export const getConfig = async () => {
   }
 }
 
+/**
+ * @param {{maxVelocity: number, acceleration: number, jerk: number}} kinematics Ramp limits in full
+ * steps/s, steps/s^2 and steps/s^3. Zero maxVelocity restores the built-in ramp, zero jerk gives a trapezoid
+ */
+export const setKinematics = async ({ maxVelocity = 0, acceleration = 0, jerk = 0 } = {}) => {
+  const buffer = Buffer.alloc(6)
+  buffer.writeUInt16LE(maxVelocity, 0)
+  buffer.writeUInt16LE(acceleration, 2)
+  buffer.writeUInt16LE(jerk, 4)
+  await writeRegister(0x27, buffer)
+}
+
+export const getKinematics = async () => {
+  const buffer = await readRegister(0x27)
+  return {
+    maxVelocity: buffer.readUInt16LE(0),
+    acceleration: buffer.readUInt16LE(2),
+    jerk: buffer.readUInt16LE(4)
+  }
+}
+
+// Firmware limits of a ramp table, see RampedMove::rampTable
+const BASE_PERIOD_US = 3072n
+const MIN_PERIOD_US = 50n
+const MAX_RAMP_SEGMENTS = 32n
+const MAX_SEGMENT_STEPS = 32767n
+
+const bigMin = (a, b) => a < b ? a : b
+const bigMax = (a, b) => a > b ? a : b
+
+// Same integer steps as the firmware: whether the ramp at factor reaches maxVelocity
+const rampReaches = ({ maxVelocity, acceleration, jerk }, factor) => {
+  const vmax = bigMin(BigInt(maxVelocity) * factor, 1000000n / MIN_PERIOD_US) * 1000n
+  const v0 = bigMin(1000000000n * factor / BASE_PERIOD_US, vmax)
+  const amax = BigInt(acceleration) * factor
+  const j = BigInt(jerk) * factor
+  let rampSteps = (vmax * vmax - v0 * v0) / 1000000n / (2n * amax)
+  if (j) {
+    rampSteps += vmax / 1000n * amax / j
+  }
+  let segmentSteps = bigMin(bigMax(rampSteps / (MAX_RAMP_SEGMENTS - 1n) + 1n, 1n), MAX_SEGMENT_STEPS)
+  let v = v0
+  for (let attempt = 0; attempt < 16; ++attempt) {
+    let size = 0n
+    let a = j ? 0n : amax
+    v = v0
+    while (size < MAX_RAMP_SEGMENTS - 1n && v < vmax) {
+      const dtUs = segmentSteps * 1000000000n / v
+      if (j) {
+        const easing = v + a * a * 1000n / (2n * j) >= vmax
+        a = easing ? bigMax(amax / 16n + 1n, a - j * dtUs / 1000000n) : bigMin(amax, a + j * dtUs / 1000000n)
+      }
+      size++
+      v = bigMin(vmax, v + a * dtUs / 1000n)
+    }
+    if (v >= vmax || segmentSteps === MAX_SEGMENT_STEPS) {
+      break
+    }
+    segmentSteps = bigMin(2n * segmentSteps, MAX_SEGMENT_STEPS)
+  }
+  return v >= vmax
+}
+
+/**
+ * Mirrors the firmware check of setKinematics: the ramp must reach maxVelocity in at most 32 segments
+ * the step counter can watch (32767 steps), at every step factor
+ * @param {{maxVelocity: number, acceleration: number, jerk: number}} kinematics
+ */
+export const kinematicsFit = ({ maxVelocity = 0, acceleration = 0, jerk = 0 } = {}) =>
+  maxVelocity === 0 || acceleration === 0 ||
+  [1n, 2n, 4n, 8n, 16n, 32n, 64n, 128n].every(factor => rampReaches({ maxVelocity, acceleration, jerk }, factor))
+
+/**
+ * @param {{velocity: number, acceleration: number}} freeRun Cruise speed (full steps/s) and acceleration
+ * (full steps/s^2) of free runs, also braking past the stopper. Zero velocity restores the unramped run
+ */
+export const setFreeRun = async ({ velocity = 0, acceleration = 0 } = {}) => {
+  const buffer = Buffer.alloc(4)
+  buffer.writeUInt16LE(velocity, 0)
+  buffer.writeUInt16LE(acceleration, 2)
+  await writeRegister(0x2D, buffer)
+}
+
+/**
+ * Free run limits and how far the last ramped run braked past the stopper, in 1/128 full steps
+ */
+export const getFreeRun = async () => {
+  const buffer = await readRegister(0x2D)
+  const overshoot = buffer.readInt32LE(4)
+  return {
+    velocity: buffer.readUInt16LE(0),
+    acceleration: buffer.readUInt16LE(2),
+    overshoot,
+    overshootDegrees: overshoot * 360 / (200 * 128)
+  }
+}
+
+/**
+ * Motion plan cache counters, a repeated choreography should only add hits
+ */
+export const getPlanCacheStats = async () => {
+  const buffer = await readRegister(0x28)
+  return {
+    hits: buffer.readUInt32LE(0),
+    misses: buffer.readUInt32LE(4)
+  }
+}
+
+export const resetPlanCacheStats = async () => {
+  await writeRegister(0x28, null)
+}
+
+/**
+ * Absolute position in 1/128 full steps, zeroed at the stopper by a free run
+ */
+export const getPosition = async () => {
+  const buffer = await readRegister(0x29)
+  const position = buffer.readInt32LE(0)
+  return {
+    position,
+    degrees: position * 360 / (200 * 128),
+    known: buffer.readUInt8(4) === 1
+  }
+}
+
+/**
+ * @param {number} position Declares the current shaft position, in 1/128 full steps
+ */
+export const setPosition = async (position = 0) => {
+  const buffer = Buffer.alloc(4)
+  buffer.writeInt32LE(position)
+  await writeRegister(0x29, buffer)
+}
+
+/**
+ * @param {number} degrees Absolute angle to move to, the position has to be known
+ */
+export const goTo = async (degrees = 0) => {
+  const buffer = Buffer.alloc(4)
+  buffer.writeInt32LE(degrees)
+  await writeRegister(0x2A, buffer)
+}
+
+/**
+ * Selected axis, which the other motor calls address, and the number of axes
+ */
+export const getAxis = async () => {
+  const buffer = await readRegister(0x2E)
+  return {
+    axis: buffer.readUInt8(0),
+    count: buffer.readUInt8(1)
+  }
+}
+
+/**
+ * @param {number} axis Axis the other motor calls address from now on
+ */
+export const selectAxis = async (axis = 0) => {
+  await writeRegister(0x2E, Buffer.from([axis]))
+}
+
+/**
+ * @param {number[]} degrees Relative move of each axis from axis 0, they all start and finish together
+ */
+export const moveCoordinated = async (degrees = []) => {
+  const buffer = Buffer.alloc(degrees.length * 4)
+  degrees.forEach((d, i) => buffer.writeInt32LE(d, i * 4))
+  await writeRegister(0x2F, buffer)
+}
+
+export const LATENCY_STAGES = [
+  'rxToSubmit', 'queueWait', 'setup', 'setupToPulse', 'rxToPulse', 'segmentSwitch', 'move', 'scheduleLate', 'deadTime'
+]
+
+/**
+ * Log2-bucketed latency histogram of one stage, bucket b counts intervals in [2^(b-1), 2^b) us
+ * @param {number} stage Index into LATENCY_STAGES
+ */
+export const getLatency = async (stage = 0) => {
+  await writeRegister(0x2B, Buffer.from([stage]))
+  const buffer = await readRegister(0x2B)
+  const buckets = buffer.readUInt8(1)
+  return {
+    stage: LATENCY_STAGES[buffer.readUInt8(0)],
+    maxUs: buffer.readUInt32LE(2),
+    counts: Array.from({ length: buckets }, (_, i) => buffer.readUInt16LE(6 + i * 2))
+  }
+}
+
+export const resetLatency = async () => {
+  await writeRegister(0x2B, Buffer.from([0xFF]))
+}
+
+const PROGRAM_OPS = { move: 1, goto: 2, dwell: 3, hold: 4, release: 5, repeat: 6, loop: 7 }
+const PROGRAM_CMD = { begin: 1, append: 2, commit: 3, run: 4, erase: 5 }
+const PROGRAM_FLAG_HOLD = 0x01
+
+/**
+ * Flattens a program into its 4-byte instructions {uint8 op, uint8 flags, int16 arg}
+ * @param {Array<object>} steps {op: 'move'|'goto', degrees, hold}, {op: 'dwell', ms}, {op: 'hold'|'release'}
+ * or {op: 'repeat', count, body: steps}, count 0 repeats forever
+ */
+export const compileProgram = (steps = []) => {
+  const instrs = []
+  const emit = (op, arg = 0, flags = 0) => instrs.push({ op: PROGRAM_OPS[op], flags, arg })
+  const walk = (list) => list.forEach(step => {
+    switch (step.op) {
+      case 'move':
+      case 'goto':
+        emit(step.op, step.degrees, step.hold ? PROGRAM_FLAG_HOLD : 0)
+        break
+      case 'dwell':
+        emit('dwell', step.ms)
+        break
+      case 'repeat':
+        emit('repeat', step.count)
+        walk(step.body)
+        emit('loop')
+        break
+      default:
+        emit(step.op)
+    }
+  })
+  walk(steps)
+  const buffer = Buffer.alloc(instrs.length * 4)
+  instrs.forEach(({ op, flags, arg }, idx) => {
+    buffer.writeUInt8(op, idx * 4)
+    buffer.writeUInt8(flags, idx * 4 + 1)
+    // DWELL and REPEAT args are unsigned
+    if (op === PROGRAM_OPS.dwell || op === PROGRAM_OPS.repeat) {
+      buffer.writeUInt16LE(arg, idx * 4 + 2)
+    } else {
+      buffer.writeInt16LE(arg, idx * 4 + 2)
+    }
+  })
+  return buffer
+}
+
+/**
+ * Result of the last program command (esp_err_t, 0 on success) and the running program id
+ */
+export const getProgramStatus = async () => {
+  const buffer = await readRegister(0x2C)
+  const running = buffer.readUInt8(4)
+  return {
+    error: buffer.readInt32LE(0),
+    running: running === 0xFF ? null : running
+  }
+}
+
+/**
+ * Stores a motion program on the device under id, replacing the previous one
+ * @param {number} id Program id 0..254
+ * @param {Array<object>} steps See compileProgram
+ */
+export const storeProgram = async (id, steps) => {
+  const program = compileProgram(steps)
+  // 15 instructions per I2C write (60 bytes)
+  const MAX_BYTES_PER_WRITE = 60
+  await writeRegister(0x2C, Buffer.from([PROGRAM_CMD.begin, id]))
+  for (let i = 0; i < program.length; i += MAX_BYTES_PER_WRITE) {
+    const chunk = program.subarray(i, i + MAX_BYTES_PER_WRITE)
+    await writeRegister(0x2C, Buffer.from([PROGRAM_CMD.append, ...chunk]))
+  }
+  await writeRegister(0x2C, Buffer.from([PROGRAM_CMD.commit]))
+  const { error } = await getProgramStatus()
+  if (error) {
+    throw new Error(`Program ${id} rejected: esp_err_t 0x${error.toString(16)}`)
+  }
+}
+
+/**
+ * @param {number} id Stored program to run, after the moves already queued
+ */
+export const runProgram = async (id) => {
+  await writeRegister(0x2C, Buffer.from([PROGRAM_CMD.run, id]))
+}
+
+export const eraseProgram = async (id) => {
+  await writeRegister(0x2C, Buffer.from([PROGRAM_CMD.erase, id]))
+}
+
 /**
  * @param {number} dir Direction (+1/-1) of the free run
  */
@@ -49,10 +436,207 @@ export const freeRun = async (dir = -1) => {
   await writeRegister(0x22, Buffer.from([dirByte]))
 }
 
-export const stop = async () => {
-  await writeRegister(0x21, null)
+/**
+ * @param {{decelerate: boolean}} options Ramp down from the current speed instead of cutting the steps
+ */
+export const stop = async ({ decelerate = false } = {}) => {
+  await writeRegister(0x21, decelerate ? Buffer.from([0x01]) : null)
+}
+
+const MOVE_ENDS = ['completed', 'decelerated', 'emergency', 'failed']
+const MOVE_TYPES = ['fixed', 'free', 'stop', 'hold', 'release', 'goto', 'program', 'jog', 'home', 'dwell']
+
+/**
+ * Steps the last fixed move ran (at its step factor) and how it ended
+ */
+export const getLastMove = async () => {
+  const buffer = await readRegister(0x21)
+  const steps = buffer.readUInt32LE(0)
+  const factor = buffer.readUInt16LE(4)
+  return {
+    steps: steps === 0xFFFFFFFF ? null : steps,
+    factor,
+    end: MOVE_ENDS[buffer.readUInt8(6)]
+  }
+}
+
+/**
+ * Takes the completion records waiting in the FIFO of the selected axis, oldest first. Moves blended
+ * into one complete in one record, which covers the ids firstId through id
+ */
+export const getCompletions = async () => {
+  const records = []
+  for (;;) {
+    const buffer = await readRegister(0x50)
+    const count = buffer.readUInt8(0)
+    for (let i = 0; i < count; i++) {
+      const offset = 1 + i * 20
+      const steps = buffer.readUInt32LE(offset + 4)
+      records.push({
+        id: buffer.readUInt32LE(offset),
+        firstId: buffer.readUInt32LE(offset + 16),
+        steps: steps === 0xFFFFFFFF ? null : steps,
+        durationUs: buffer.readUInt32LE(offset + 8),
+        factor: buffer.readUInt16LE(offset + 12),
+        type: MOVE_TYPES[buffer.readUInt8(offset + 14)],
+        end: MOVE_ENDS[buffer.readUInt8(offset + 15)]
+      })
+    }
+    if (count < 3) {
+      return records
+    }
+  }
+}
+
+/**
+ * Ids of the selected axis: last completed, last queued, and the last one dropped by a stop or reset
+ */
+export const getCompletionStatus = async () => {
+  const buffer = await readRegister(0x51)
+  return {
+    lastCompleted: buffer.readUInt32LE(0),
+    lastQueued: buffer.readUInt32LE(4),
+    flushedThrough: buffer.readUInt32LE(8),
+    dropped: buffer.readUInt16LE(12)
+  }
 }
 
+/**
+ * Polls until the move id has completed or been dropped by a stop, ids complete in order
+ * @returns {Promise<boolean>} false when it timed out
+ */
+export const waitForCompletion = async (id, { timeoutMs = 30000, intervalMs = 50 } = {}) => {
+  const deadline = Date.now() + timeoutMs
+  while (Date.now() < deadline) {
+    const { lastCompleted, flushedThrough } = await getCompletionStatus()
+    if (lastCompleted >= id || flushedThrough >= id) {
+      return true
+    }
+    await sleep(intervalMs)
+  }
+  return false
+}
+
+// Host monotonic clock, in us
+export const hostNowUs = () => process.hrtime.bigint() / 1000n
+
+// Device clock minus host clock, set by syncClock
+let clockOffsetUs = null
+
+/**
+ * Estimates the device clock offset from the read with the shortest round trip
+ * @returns {Promise<{offsetUs: bigint, rttUs: bigint}>} The offset is within rttUs / 2
+ */
+export const syncClock = async (samples = 8) => {
+  let best = null
+  for (let i = 0; i < samples; i++) {
+    const t0 = hostNowUs()
+    const buffer = await readRegister(0x52)
+    const t1 = hostNowUs()
+    const rttUs = t1 - t0
+    if (!best || rttUs < best.rttUs) {
+      best = { offsetUs: buffer.readBigInt64LE(0) - (t0 + t1) / 2n, rttUs }
+    }
+  }
+  clockOffsetUs = best.offsetUs
+  return best
+}
+
+/**
+ * @param {bigint} hostUs Host time from hostNowUs, converted with the offset of the last syncClock
+ */
+export const toDeviceUs = (hostUs) => {
+  if (clockOffsetUs === null) {
+    throw new Error('Motor clock not synced, call syncClock first')
+  }
+  return hostUs + clockOffsetUs
+}
+
+/**
+ * Queues a move whose first step goes out at a host time, to line it up with other host actions
+ * @param {bigint} hostUs Start time on the hostNowUs clock
+ * @param {number} degrees Relative move, or absolute angle when absolute is set
+ */
+export const moveAt = async (hostUs, degrees, { absolute = false, coast = false } = {}) => {
+  const buffer = Buffer.alloc(13)
+  buffer.writeBigInt64LE(toDeviceUs(hostUs), 0)
+  buffer.writeInt32LE(degrees, 8)
+  buffer.writeUInt8((absolute ? 0x01 : 0) | (coast ? 0x02 : 0), 12)
+  await writeRegister(0x53, buffer)
+}
+
+/**
+ * @param {number} velocity Target speed in full steps/s, signed for the direction, 0 ramps down and stops
+ */
+export const jog = async (velocity = 0) => {
+  const buffer = Buffer.alloc(4)
+  buffer.writeInt32LE(velocity)
+  await writeRegister(0x54, buffer)
+}
+
+export const getJog = async () => {
+  const buffer = await readRegister(0x54)
+  return {
+    velocity: buffer.readInt32LE(0),
+    jogging: buffer.readUInt8(4) === 1
+  }
+}
+
+/**
+ * @param {{fastVelocity: number, slowVelocity: number, acceleration: number, backoffDegrees: number, touches: number}} homing
+ * Approach speeds (full steps/s) and acceleration (full steps/s^2), the back-off before each slow approach
+ * and how many slow approaches (1-8) measure the trigger point
+ */
+export const setHoming = async ({ fastVelocity, slowVelocity, acceleration, backoffDegrees, touches }) => {
+  const buffer = Buffer.alloc(10)
+  buffer.writeUInt16LE(fastVelocity, 0)
+  buffer.writeUInt16LE(slowVelocity, 2)
+  buffer.writeUInt16LE(acceleration, 4)
+  buffer.writeUInt16LE(backoffDegrees, 6)
+  buffer.writeUInt16LE(touches, 8)
+  await writeRegister(0x55, buffer)
+}
+
+export const getHoming = async () => {
+  const buffer = await readRegister(0x55)
+  return {
+    fastVelocity: buffer.readUInt16LE(0),
+    slowVelocity: buffer.readUInt16LE(2),
+    acceleration: buffer.readUInt16LE(4),
+    backoffDegrees: buffer.readUInt16LE(6),
+    touches: buffer.readUInt16LE(8)
+  }
+}
+
+/**
+ * @param {number} dir Direction (+1/-1) of the stopper, the position is zeroed at its edge
+ */
+export const home = async (dir = -1) => {
+  const dirByte = dir > 0 ? 0x01 : 0xFF
+  await writeRegister(0x56, Buffer.from([dirByte]))
+}
+
+/**
+ * Trigger points of the last homing in 1/128 full steps: where the fast approach found the edge and the
+ * spread of the slow ones, all relative to the first slow edge
+ */
+export const getHomingReport = async () => {
+  const buffer = await readRegister(0x56)
+  const minDeviation = buffer.readInt32LE(4)
+  const maxDeviation = buffer.readInt32LE(8)
+  return {
+    fastError: buffer.readInt32LE(0),
+    minDeviation,
+    maxDeviation,
+    repeatability: maxDeviation - minDeviation,
+    samples: buffer.readUInt16LE(12),
+    end: MOVE_ENDS[buffer.readUInt8(14)],
+    homed: buffer.readUInt8(15) === 1
+  }
+}
+
+// Hold, release and dwell are queued: they run in order with the moves around them
+
 export const hold = async () => {
   await writeRegister(0x24, null)
 }
@@ -60,3 +644,140 @@ export const hold = async () => {
 export const release = async () => {
   await writeRegister(0x25, null)
 }
+
+/**
+ * @param {number} ms Pause between the moves queued before and after it
+ */
+export const dwell = async (ms = 0) => {
+  const buffer = Buffer.alloc(4)
+  buffer.writeUInt32LE(ms)
+  await writeRegister(0x58, buffer)
+}
+
+const TRACE_KINDS = ['start', 'segment', 'decel', 'stopper', 'pause', 'stop']
+
+// Motion trace of the selected axis, recorded when the firmware is built with CONFIG_MOTOR_TRACE
+export const startTrace = async () => {
+  await writeRegister(0x59, Buffer.from([1]))
+}
+
+export const stopTrace = async () => {
+  await writeRegister(0x59, Buffer.from([0]))
+}
+
+/**
+ * Takes the trace events waiting in the ring of the selected axis, oldest first
+ * @returns {Promise<{compiled: boolean, recording: boolean, dropped: number, events: Array<object>}>}
+ * dropped counts the events lost to a full ring since startTrace
+ */
+export const readTrace = async () => {
+  const events = []
+  for (;;) {
+    const buffer = await readRegister(0x59)
+    const count = buffer.readUInt8(0)
+    for (let i = 0; i < count; i++) {
+      const offset = 4 + i * 16
+      events.push({
+        tUs: buffer.readUInt32LE(offset),
+        value: buffer.readInt32LE(offset + 4),
+        periodUs: buffer.readUInt16LE(offset + 8),
+        steps: buffer.readUInt16LE(offset + 10),
+        count: buffer.readUInt16LE(offset + 12),
+        kind: TRACE_KINDS[buffer.readUInt8(offset + 14)],
+        arg: buffer.readUInt8(offset + 15)
+      })
+    }
+    if (count < 3) {
+      const flags = buffer.readUInt8(1)
+      return {
+        compiled: (flags & 0x01) !== 0,
+        recording: (flags & 0x02) !== 0,
+        dropped: buffer.readUInt16LE(2),
+        events
+      }
+    }
+  }
+}
+
+/**
+ * Rebuilds each traced move: position and velocity over time, and every segment as commanded
+ * against as run. Events of a move whose start was not traced are skipped.
+ * Steps are at the move step factor, velocities in full steps/s, times in us from the move start.
+ * @param {Array<object>} events As returned by readTrace, several reads may be concatenated
+ * @returns {Array<object>} Moves with their samples and segments; a segment took errorUs longer than
+ * its counted steps at the commanded period, and ran overrun steps past its planned length
+ */
+export const reconstructTrace = (events = []) => {
+  const moves = []
+  let move = null
+  let segment = null
+  let now = 0
+  let lastUs = null
+  for (const event of events) {
+    // Device timestamps are the low 32 bits of its clock
+    now = lastUs === null ? 0 : now + ((event.tUs - lastUs) >>> 0)
+    lastUs = event.tUs
+    if (event.kind === 'start') {
+      if (!move) {
+        const type = MOVE_TYPES[event.arg]
+        move = {
+          type,
+          factor: event.count,
+          plannedSteps: type === 'fixed' ? Math.abs(event.value) : null,
+          startUs: now,
+          steps: 0,
+          samples: [{ tUs: 0, steps: 0, velocity: 0, commandedVelocity: 0 }],
+          segments: []
+        }
+        moves.push(move)
+      }
+      // A stopped jog starts again, possibly the other way
+      move.direction = event.value < 0 ? -1 : 1
+      segment = { index: 0, kind: 'start', periodUs: event.periodUs, steps: event.steps, startUs: now }
+      continue
+    }
+    if (!move) {
+      continue
+    }
+    const tUs = now - move.startUs
+    move.steps += move.direction * event.count
+    if (segment) {
+      const measuredUs = now - segment.startUs
+      const plannedUs = event.count * segment.periodUs
+      move.segments.push({
+        index: segment.index,
+        kind: segment.kind,
+        periodUs: segment.periodUs,
+        steps: segment.steps,
+        counted: event.count,
+        plannedUs,
+        measuredUs,
+        errorUs: measuredUs - plannedUs,
+        overrun: segment.steps && event.kind !== 'decel' && event.kind !== 'stopper' && event.kind !== 'stop'
+          ? event.count - segment.steps
+          : 0
+      })
+      move.samples.push({
+        tUs,
+        steps: move.steps,
+        velocity: measuredUs ? event.count * 1e6 / measuredUs / move.factor : 0,
+        commandedVelocity: segment.periodUs ? 1e6 / segment.periodUs / move.factor : 0
+      })
+    }
+    segment = event.periodUs
+      ? { index: event.value, kind: event.kind, periodUs: event.periodUs, steps: event.steps, startUs: now }
+      : null
+    if (event.kind === 'stopper') {
+      move.stopperUs = tUs
+    }
+    if (event.kind === 'stop') {
+      move.durationUs = tUs
+      move.position = event.value
+      move.planRanOut = event.arg === 1
+      move.stepError = move.plannedSteps === null ? null : Math.abs(move.steps) - move.plannedSteps
+      move = null
+      segment = null
+    }
+  }
+  return moves
+}
@@ -1,6 +1,8 @@
+#include <cinttypes>
 #include <esp_app_format.h>
 #include <esp_check.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 
 #include "Common.hpp"
 #include "I2C.hpp"
@@ -19,7 +21,7 @@ namespace i2c_slave {
     void *ctx
   ) {
     I2C *self = reinterpret_cast<I2C *>(ctx);
-    i2c_slave_event_t evt = {.type = I2C_SLAVE_EVT_TX, .data = nullptr};
+    i2c_slave_event_t evt = {.type = I2C_SLAVE_EVT_TX, .data = nullptr, .t_us = esp_timer_get_time()};
     BaseType_t xTaskWoken = 0;
     xQueueSendFromISR(self->getEventQueue(), &evt, &xTaskWoken);
     return xTaskWoken;
@@ -30,7 +32,7 @@ namespace i2c_slave {
     void *ctx
   ) {
     I2C *self = reinterpret_cast<I2C *>(ctx);
-    i2c_slave_event_t evt = {.type = I2C_SLAVE_EVT_RX, .data = evt_data};
+    i2c_slave_event_t evt = {.type = I2C_SLAVE_EVT_RX, .data = evt_data, .t_us = esp_timer_get_time()};
     BaseType_t xTaskWoken = 0;
     xQueueSendFromISR(self->getEventQueue(), &evt, &xTaskWoken);
     return xTaskWoken;
@@ -81,6 +83,59 @@ namespace i2c_slave {
     self->taskLoop();
   }
 
+  /**
+   * @brief Motion program upload and control
+   *
+   * BEGIN {id} starts an upload, APPEND {instructions} adds to it, COMMIT validates and stores it in
+   * NVS. RUN {id} queues the stored program like a move, ERASE {id} deletes it.
+   */
+  esp_err_t I2C::handleProgramCmd(const uint8_t *data, size_t length) {
+    switch (static_cast<ProgramCmd>(data[0])) {
+      case ProgramCmd::BEGIN:
+      case ProgramCmd::RUN:
+      case ProgramCmd::ERASE:
+        if (length != 2) {
+          return ESP_ERR_INVALID_SIZE;
+        }
+        break;
+      default:
+        break;
+    }
+    switch (static_cast<ProgramCmd>(data[0])) {
+      case ProgramCmd::BEGIN:
+        program_id_ = data[1];
+        program_len_ = 0;
+        ESP_LOGI(TAG, "Motor program %u upload", program_id_);
+        return ESP_OK;
+      case ProgramCmd::APPEND:
+        if (program_len_ + length - 1 > sizeof(program_buf_)) {
+          return ESP_ERR_INVALID_SIZE;
+        }
+        memcpy(program_buf_ + program_len_, data + 1, length - 1);
+        program_len_ += length - 1;
+        return ESP_OK;
+      case ProgramCmd::COMMIT: {
+        MotionProgram program;
+        ESP_RETURN_ON_ERROR(program.assign(program_buf_, program_len_), TAG, "Invalid motor program");
+        ESP_LOGI(TAG, "Motor program %u stored: %d bytes", program_id_, program_len_);
+        return ProgramStore::save(program_id_, program);
+      }
+      case ProgramCmd::RUN:
+        ESP_LOGI(TAG, "Motor program %u run", data[1]);
+        return axisMotor().submit(
+          Move {
+            .degrees = data[1],
+            .end_action = EndAction::HOLD,
+            .move_type = MoveType::PROGRAM,
+          }
+        );
+      case ProgramCmd::ERASE:
+        ESP_LOGI(TAG, "Motor program %u erase", data[1]);
+        return ProgramStore::erase(data[1]);
+    }
+    return ESP_ERR_INVALID_ARG;
+  }
+
   void I2C::taskLoop() {
     enum class ReadState { WAITING_FOR_ADDR, SENT_LENGTH, SENDING_DATA };
 
@@ -98,6 +153,10 @@ namespace i2c_slave {
             lastAddr = evt.data->buffer[0];
             readState = ReadState::WAITING_FOR_ADDR; // Reset on new address
             if (evt.data->length > 1) {
+              // Moves submitted while handling this write carry its RX time, cleared on the same axis
+              // even when the write selects another one
+              motor::Motor &rxMotor = axisMotor();
+              rxMotor.markRx(evt.t_us);
               switch (lastAddr) {
                 case REG_DEVICE_RESTART: {
                   ESP_LOGI(TAG, "System restart requested");
@@ -134,36 +193,223 @@ namespace i2c_slave {
                 case I2C::REG_MOTOR_CONFIG: {
                   auto factor = *(uint16_t *)(evt.data->buffer + 1);
                   ESP_LOGI(TAG, "Set motor config: { .factor = %u }", factor);
-                  Motor::instance().setStepFactor(factor);
+                  axisMotor().setStepFactor(factor);
+                  break;
+                }
+                case I2C::REG_MOTOR_KINEMATICS: {
+                  // Write: Kinematic limits (uint16 max velocity, acceleration, jerk in full steps)
+                  if (evt.data->length - 1 != sizeof(Kinematics)) {
+                    ESP_LOGW(TAG, "Invalid motor kinematics length: %d bytes", evt.data->length - 1);
+                    break;
+                  }
+                  Kinematics kinematics;
+                  memcpy(&kinematics, evt.data->buffer + 1, sizeof(Kinematics));
+                  ESP_LOGI(
+                    TAG,
+                    "Set motor kinematics: { .max_velocity = %u, .acceleration = %u, .jerk = %u }",
+                    kinematics.max_velocity,
+                    kinematics.acceleration,
+                    kinematics.jerk
+                  );
+                  esp_err_t ret = axisMotor().setKinematics(kinematics);
+                  if (ret != ESP_OK) {
+                    ESP_LOGE(TAG, "Failed: %s", esp_err_to_name(ret));
+                  }
+                  break;
+                }
+                case I2C::REG_MOTOR_FREE_RUN_CFG: {
+                  // Write: Set free run limits (uint16 velocity, uint16 acceleration)
+                  if (evt.data->length - 1 != sizeof(FreeRunCfg)) {
+                    ESP_LOGW(TAG, "Invalid motor free run config length: %d bytes", evt.data->length - 1);
+                    break;
+                  }
+                  FreeRunCfg freeRun;
+                  memcpy(&freeRun, evt.data->buffer + 1, sizeof(freeRun));
+                  ESP_LOGI(TAG, "Motor free run config: v=%u a=%u", freeRun.velocity, freeRun.acceleration);
+                  esp_err_t ret = axisMotor().setFreeRun(freeRun);
+                  if (ret != ESP_OK) {
+                    ESP_LOGE(TAG, "Failed: %s", esp_err_to_name(ret));
+                  }
+                  break;
+                }
+                case I2C::REG_MOTOR_PLAN_CACHE: {
+                  // Write: Reset plan cache counters
+                  ESP_LOGI(TAG, "Motor plan cache counters reset");
+                  axisMotor().resetPlanCacheStats();
+                  break;
+                }
+                case I2C::REG_MOTOR_POSITION: {
+                  // Write: Declare current position (int32, 1/128 full steps)
+                  if (evt.data->length - 1 != sizeof(int32_t)) {
+                    ESP_LOGW(TAG, "Invalid motor position length: %d bytes", evt.data->length - 1);
+                    break;
+                  }
+                  int32_t position;
+                  memcpy(&position, evt.data->buffer + 1, sizeof(position));
+                  ESP_LOGI(TAG, "Set motor position: %" PRIi32, position);
+                  axisMotor().setPosition(position);
+                  break;
+                }
+                case I2C::REG_MOTOR_GOTO: {
+                  // Write: Move to absolute angle (int32 degrees)
+                  if (evt.data->length - 1 != sizeof(int32_t)) {
+                    ESP_LOGW(TAG, "Invalid motor goto length: %d bytes", evt.data->length - 1);
+                    break;
+                  }
+                  int32_t degrees;
+                  memcpy(&degrees, evt.data->buffer + 1, sizeof(degrees));
+                  ESP_LOGI(TAG, "Motor goto %" PRIi32 " degrees", degrees);
+                  esp_err_t ret = axisMotor().submit(
+                    Move {
+                      .degrees = degrees,
+                      .end_action = EndAction::HOLD,
+                      .move_type = MoveType::GOTO,
+                    }
+                  );
+                  if (ret != ESP_OK) {
+                    ESP_LOGE(TAG, "Failed: %s", esp_err_to_name(ret));
+                  }
+                  break;
+                }
+                case I2C::REG_MOTOR_LATENCY: {
+                  // Write: Select the latency stage to read (uint8), 0xFF resets all histograms
+                  uint8_t stage = evt.data->buffer[1];
+                  if (stage == 0xFF) {
+                    ESP_LOGI(TAG, "Motor latency histograms reset");
+                    axisMotor().latency().reset();
+                  } else if (stage < static_cast<uint8_t>(LatencyStage::COUNT)) {
+                    latency_stage_ = stage;
+                  } else {
+                    ESP_LOGW(TAG, "Invalid motor latency stage: %u", stage);
+                  }
+                  break;
+                }
+                case I2C::REG_MOTOR_AXIS: {
+                  // Write: Select the axis the motor registers address (uint8)
+                  uint8_t axis = evt.data->buffer[1];
+                  if (axis < Motor::kAxisCount) {
+                    axis_ = axis;
+                  } else {
+                    ESP_LOGW(TAG, "Invalid motor axis: %u", axis);
+                  }
+                  break;
+                }
+                case I2C::REG_MOTOR_COORDINATED: {
+                  // Write: int32 degrees per axis from axis 0, all the axes start and finish together
+                  size_t length = evt.data->length - 1;
+                  if (length % sizeof(int32_t) || length / sizeof(int32_t) > Motor::kAxisCount) {
+                    ESP_LOGW(TAG, "Invalid motor coordinated length: %d bytes", evt.data->length - 1);
+                    break;
+                  }
+                  int32_t degrees[Motor::kAxisCount];
+                  memcpy(degrees, evt.data->buffer + 1, length);
+                  esp_err_t ret = Motor::submitCoordinated(degrees, length / sizeof(int32_t));
+                  if (ret != ESP_OK) {
+                    ESP_LOGE(TAG, "Failed: %s", esp_err_to_name(ret));
+                  }
+                  break;
+                }
+                case I2C::REG_MOTOR_SCHEDULE: {
+                  // Write: int64 start time (esp_timer us, see REG_MOTOR_CLOCK), int32 degrees, uint8 flags
+                  if (evt.data->length - 1 != sizeof(int64_t) + sizeof(int32_t) + 1) {
+                    ESP_LOGW(TAG, "Invalid motor schedule length: %d bytes", evt.data->length - 1);
+                    break;
+                  }
+                  int64_t at_us;
+                  int32_t degrees;
+                  memcpy(&at_us, evt.data->buffer + 1, sizeof(at_us));
+                  memcpy(&degrees, evt.data->buffer + 1 + sizeof(at_us), sizeof(degrees));
+                  uint8_t flags = evt.data->buffer[1 + sizeof(at_us) + sizeof(degrees)];
+                  ESP_LOGI(TAG, "Motor move %" PRIi32 " degrees at %" PRIi64 " us", degrees, at_us);
+                  esp_err_t ret = axisMotor().submitAt(
+                    Move {
+                      .degrees = degrees,
+                      .end_action = flags & SCHEDULE_FLAG_COAST ? EndAction::COAST : EndAction::HOLD,
+                      .move_type = flags & SCHEDULE_FLAG_ABSOLUTE ? MoveType::GOTO : MoveType::FIXED,
+                    },
+                    at_us
+                  );
+                  if (ret != ESP_OK) {
+                    ESP_LOGE(TAG, "Failed: %s", esp_err_to_name(ret));
+                  }
+                  break;
+                }
+                case I2C::REG_MOTOR_JOG: {
+                  // Write: int32 target velocity (full steps/s, signed), 0 ramps down and stops
+                  if (evt.data->length - 1 != sizeof(int32_t)) {
+                    ESP_LOGW(TAG, "Invalid motor jog length: %d bytes", evt.data->length - 1);
+                    break;
+                  }
+                  int32_t velocity;
+                  memcpy(&velocity, evt.data->buffer + 1, sizeof(velocity));
+                  esp_err_t ret = axisMotor().jog(velocity);
+                  if (ret != ESP_OK) {
+                    ESP_LOGE(TAG, "Failed: %s", esp_err_to_name(ret));
+                  }
+                  break;
+                }
+                case I2C::REG_MOTOR_HOMING_CFG: {
+                  // Write: HomingCfg (uint16 fast and slow velocity, acceleration, back-off degrees, touches)
+                  if (evt.data->length - 1 != sizeof(HomingCfg)) {
+                    ESP_LOGW(TAG, "Invalid motor homing config length: %d bytes", evt.data->length - 1);
+                    break;
+                  }
+                  HomingCfg homing;
+                  memcpy(&homing, evt.data->buffer + 1, sizeof(homing));
+                  ESP_LOGI(
+                    TAG, "Motor homing config: fast=%u slow=%u a=%u backoff=%u touches=%u", homing.fast_velocity,
+                    homing.slow_velocity, homing.acceleration, homing.backoff_degrees, homing.touches
+                  );
+                  esp_err_t ret = axisMotor().setHoming(homing);
+                  if (ret != ESP_OK) {
+                    ESP_LOGE(TAG, "Failed: %s", esp_err_to_name(ret));
+                  }
+                  break;
+                }
+                case I2C::REG_MOTOR_HOME: {
+                  // Write: Home against the stopper (1 byte: direction)
+                  int8_t dir = -1;
+                  if (evt.data->length > 1) {
+                    dir = *(int8_t *)(evt.data->buffer + 1) > 0 ? +1 : -1;
+                  }
+                  ESP_LOGI(TAG, "Motor home, dir=%d", dir);
+                  esp_err_t ret = axisMotor().home(dir);
+                  if (ret != ESP_OK) {
+                    ESP_LOGE(TAG, "Failed: %s", esp_err_to_name(ret));
+                  }
+                  break;
+                }
+                case I2C::REG_MOTOR_PROGRAM: {
+                  // Write: Program sub-command (uint8) and its data
+                  program_err_ = handleProgramCmd(evt.data->buffer + 1, evt.data->length - 1);
+                  if (program_err_ != ESP_OK) {
+                    ESP_LOGE(TAG, "Failed: %s", esp_err_to_name(program_err_));
+                  }
                   break;
                 }
                 case I2C::REG_MOTOR_RESET: {
                   // Write: Stop motor
                   ESP_LOGI(TAG, "Motor task queue reset");
-                  esp_err_t ret = Motor::instance().resetQueue();
+                  esp_err_t ret = axisMotor().resetQueue();
                   if (ret != ESP_OK) {
                     ESP_LOGE(TAG, "Failed: %s", esp_err_to_name(ret));
                   }
                   break;
                 }
                 case I2C::REG_MOTOR_STOP: {
-                  // Write: Stop motor
-                  ESP_LOGI(TAG, "Motor stop");
-                  esp_err_t ret = Motor::instance().submit(
-                    Move {
-                      .end_action = EndAction::COAST, //
-                      .move_type = MoveType::STOP
-                    }
-                  );
+                  // Write: Stop motor (1 byte: 0x01 decelerates, anything else is an emergency stop)
+                  StopMode mode = evt.data->buffer[1] == 0x01 ? StopMode::DECELERATE : StopMode::EMERGENCY;
+                  ESP_LOGI(TAG, "Motor stop, %s", mode == StopMode::DECELERATE ? "decelerate" : "emergency");
+                  esp_err_t ret = axisMotor().stop(mode);
                   if (ret != ESP_OK) {
                     ESP_LOGE(TAG, "Failed: %s", esp_err_to_name(ret));
                   }
                   break;
                 }
                 case I2C::REG_MOTOR_HOLD: {
-                  // Write: Hold motor
+                  // Write: Hold motor, after the queued moves
                   ESP_LOGI(TAG, "Motor hold");
-                  esp_err_t ret = Motor::instance().submit(
+                  esp_err_t ret = axisMotor().submit(
                     Move {
                       .move_type = MoveType::HOLD //
                     }
@@ -174,9 +420,9 @@ namespace i2c_slave {
                   break;
                 }
                 case I2C::REG_MOTOR_RELEASE: {
-                  // Write: Release motor
+                  // Write: Release motor, after the queued moves
                   ESP_LOGI(TAG, "Motor release");
-                  esp_err_t ret = Motor::instance().submit(
+                  esp_err_t ret = axisMotor().submit(
                     Move {
                       .move_type = MoveType::RELEASE //
                     }
@@ -193,7 +439,7 @@ namespace i2c_slave {
                     dir = *(int8_t *)(evt.data->buffer + 1) > 0 ? +1 : -1;
                   }
                   ESP_LOGI(TAG, "Motor free run, dir=%d", dir);
-                  esp_err_t ret = Motor::instance().submit(
+                  esp_err_t ret = axisMotor().submit(
                     Move {
                       .degrees = dir,
                       .end_action = EndAction::HOLD,
@@ -212,27 +458,75 @@ namespace i2c_slave {
                     int N = dataLength / 4;
                     uint16_t *offset = (uint16_t *)(evt.data->buffer + 1);
                     ESP_LOGI(TAG, "Motor profile: %d moves", N);
+                    Move moves[15];
                     for (int i = 0; i < N; i++) {
-                      int32_t degrees = *(int16_t *)(offset + i * 2);
-                      uint32_t delay = *(offset + i * 2 + 1);
-                      esp_err_t ret = Motor::instance().submit(
-                        Move {
-                          .degrees = degrees,
-                          .delay_ms = delay,
-                          .end_action = EndAction::COAST,
-                          .move_type = MoveType::FIXED,
-                        }
-                      );
-                      if (ret != ESP_OK) {
-                        ESP_LOGE(TAG, "Failed step #%d: %s", i + 1, esp_err_to_name(ret));
-                        break;
-                      }
+                      moves[i] = Move {
+                        .degrees = *(int16_t *)(offset + i * 2),
+                        .delay_ms = *(offset + i * 2 + 1),
+                        .end_action = EndAction::COAST,
+                        .move_type = MoveType::FIXED,
+                      };
+                    }
+                    // All or nothing: a full queue rejects the whole profile
+                    esp_err_t ret = axisMotor().submitBatch(moves, N);
+                    if (ret != ESP_OK) {
+                      ESP_LOGE(TAG, "Failed: %s", esp_err_to_name(ret));
                     }
                   } else {
                     ESP_LOGW(TAG, "Invalid motor profile length: %d bytes", dataLength);
                   }
                   break;
                 }
+                case I2C::REG_MOTOR_DWELL: {
+                  // Write: Queue a pause (uint32 ms) between the moves before and after it
+                  if (evt.data->length - 1 != sizeof(uint32_t)) {
+                    ESP_LOGW(TAG, "Invalid motor dwell length: %d bytes", evt.data->length - 1);
+                    break;
+                  }
+                  uint32_t ms;
+                  memcpy(&ms, evt.data->buffer + 1, sizeof(ms));
+                  ESP_LOGI(TAG, "Motor dwell %" PRIu32 " ms", ms);
+                  esp_err_t ret = axisMotor().submit(
+                    Move {
+                      .delay_ms = ms,
+                      .move_type = MoveType::DWELL,
+                    }
+                  );
+                  if (ret != ESP_OK) {
+                    ESP_LOGE(TAG, "Failed: %s", esp_err_to_name(ret));
+                  }
+                  break;
+                }
+                case I2C::REG_MOTOR_TRACE: {
+                  // Write: uint8 1 drops the events left and starts recording, 0 stops recording
+                  if (!MotionTrace::kCompiled) {
+                    ESP_LOGW(TAG, "Motor trace not compiled in (CONFIG_MOTOR_TRACE)");
+                  } else if (evt.data->buffer[1]) {
+                    ESP_LOGI(TAG, "Motor trace started");
+                    axisMotor().trace().start();
+                  } else {
+                    ESP_LOGI(TAG, "Motor trace stopped");
+                    axisMotor().trace().stop();
+                  }
+                  break;
+                }
+                case I2C::REG_MOTOR_PROFILE_V2: {
+                  // Write: Motor profile as a ProfileCodec record stream
+                  size_t count = 0;
+                  esp_err_t ret = ProfileCodec::decode(
+                    evt.data->buffer + 1, evt.data->length - 1, axisMotor().getStepFactor(), profile_,
+                    Motor::kQueueDepth, count
+                  );
+                  if (ret == ESP_OK) {
+                    ESP_LOGI(TAG, "Motor profile v2: %zu moves from %d bytes", count, evt.data->length - 1);
+                    // All or nothing: a full queue rejects the whole profile
+                    ret = axisMotor().submitBatch(profile_, count);
+                  }
+                  if (ret != ESP_OK) {
+                    ESP_LOGE(TAG, "Failed: %s", esp_err_to_name(ret));
+                  }
+                  break;
+                }
                 case I2C::REG_WIFI_CREDENTIALS: {
                   // Write: Set WiFi credentials (SSID\0password\0)
                   // Format: [register_addr][ssid]['\0'][password]['\0']
@@ -257,6 +551,7 @@ namespace i2c_slave {
                   ESP_LOGW(TAG, "Unknown write register: 0x%02X", lastAddr);
                   break;
               }
+              rxMotor.markRx(0);
             }
           }
         } else if (evt.type == I2C_SLAVE_EVT_TX) {
@@ -292,10 +587,143 @@ namespace i2c_slave {
               }
               case I2C::REG_MOTOR_CONFIG: {
                 dataLength = 2;
-                uint32_t factor = Motor::instance().getStepFactor();
+                uint32_t factor = axisMotor().getStepFactor();
                 memcpy(dataBuffer, &factor, dataLength);
                 break;
               }
+              case I2C::REG_MOTOR_KINEMATICS: {
+                Kinematics kinematics = axisMotor().getKinematics();
+                dataLength = sizeof(Kinematics);
+                memcpy(dataBuffer, &kinematics, dataLength);
+                break;
+              }
+              case I2C::REG_MOTOR_PLAN_CACHE: {
+                PlanCacheStats stats = axisMotor().getPlanCacheStats();
+                dataLength = sizeof(PlanCacheStats);
+                memcpy(dataBuffer, &stats, dataLength);
+                break;
+              }
+              case I2C::REG_MOTOR_POSITION: {
+                // Read: int32 position (1/128 full steps), uint8 known
+                int32_t position = axisMotor().getPosition();
+                memcpy(dataBuffer, &position, sizeof(position));
+                dataBuffer[sizeof(position)] = axisMotor().isPositionKnown() ? 1 : 0;
+                dataLength = sizeof(position) + 1;
+                break;
+              }
+              case I2C::REG_MOTOR_LATENCY: {
+                // Read: uint8 stage, uint8 bucket count, uint32 max us, uint16 counts[]
+                const LatencyHistogram &h =
+                  axisMotor().latency().histogram(static_cast<LatencyStage>(latency_stage_));
+                dataBuffer[0] = latency_stage_;
+                dataBuffer[1] = LatencyHistogram::kBuckets;
+                memcpy(dataBuffer + 2, &h.max_us, sizeof(h.max_us));
+                memcpy(dataBuffer + 6, h.counts.data(), sizeof(h.counts));
+                dataLength = 6 + sizeof(h.counts);
+                break;
+              }
+              case I2C::REG_MOTOR_STOP: {
+                // Read: Last FIXED move, uint32 steps run, uint16 step factor, uint8 MoveEnd
+                MoveReport report = axisMotor().getLastMove();
+                memcpy(dataBuffer, &report.steps, sizeof(report.steps));
+                memcpy(dataBuffer + 4, &report.factor, sizeof(report.factor));
+                dataBuffer[6] = static_cast<uint8_t>(report.end);
+                dataLength = 7;
+                break;
+              }
+              case I2C::REG_MOTOR_FREE_RUN_CFG: {
+                // Read: FreeRunCfg, int32 overshoot of the last run past the stopper (1/128 full steps)
+                FreeRunCfg freeRun = axisMotor().getFreeRun();
+                int32_t overshoot = axisMotor().getOvershoot();
+                memcpy(dataBuffer, &freeRun, sizeof(freeRun));
+                memcpy(dataBuffer + sizeof(freeRun), &overshoot, sizeof(overshoot));
+                dataLength = sizeof(freeRun) + sizeof(overshoot);
+                break;
+              }
+              case I2C::REG_MOTOR_AXIS: {
+                // Read: uint8 selected axis, uint8 axis count
+                dataBuffer[0] = axis_;
+                dataBuffer[1] = Motor::kAxisCount;
+                dataLength = 2;
+                break;
+              }
+              case I2C::REG_MOTOR_PROGRAM: {
+                // Read: int32 result of the last program sub-command, uint8 running program id (0xFF none)
+                int32_t err = program_err_;
+                memcpy(dataBuffer, &err, sizeof(err));
+                dataBuffer[sizeof(err)] = axisMotor().runningProgram();
+                dataLength = sizeof(err) + 1;
+                break;
+              }
+              case I2C::REG_MOTOR_COMPLETIONS: {
+                // Read: uint8 count, then up to 3 MoveCompletion records taken from the FIFO
+                uint8_t count = 0;
+                MoveCompletion done;
+                while (1 + (count + 1) * sizeof(done) <= BUF_SIZE && axisMotor().popCompletion(done)) {
+                  memcpy(dataBuffer + 1 + count * sizeof(done), &done, sizeof(done));
+                  ++count;
+                }
+                dataBuffer[0] = count;
+                dataLength = 1 + count * sizeof(done);
+                break;
+              }
+              case I2C::REG_MOTOR_COMPLETED_ID: {
+                // Read: uint32 last completed id, last queued id, flushed-through id, uint16 dropped records
+                MotorCmdId ids[] = {
+                  axisMotor().lastCompletedId(), axisMotor().lastQueuedId(), axisMotor().flushedThroughId()
+                };
+                uint16_t dropped = axisMotor().droppedCompletions();
+                memcpy(dataBuffer, ids, sizeof(ids));
+                memcpy(dataBuffer + sizeof(ids), &dropped, sizeof(dropped));
+                dataLength = sizeof(ids) + sizeof(dropped);
+                break;
+              }
+              case I2C::REG_MOTOR_CLOCK: {
+                // Read: int64 esp_timer time the read was requested at, for the host to sync its clock
+                memcpy(dataBuffer, &evt.t_us, sizeof(evt.t_us));
+                dataLength = sizeof(evt.t_us);
+                break;
+              }
+              case I2C::REG_MOTOR_JOG: {
+                // Read: int32 target velocity, uint8 jogging
+                int32_t velocity = axisMotor().getJogVelocity();
+                memcpy(dataBuffer, &velocity, sizeof(velocity));
+                dataBuffer[sizeof(velocity)] = axisMotor().isJogging() ? 1 : 0;
+                dataLength = sizeof(velocity) + 1;
+                break;
+              }
+              case I2C::REG_MOTOR_HOMING_CFG: {
+                // Read: HomingCfg
+                HomingCfg homing = axisMotor().getHoming();
+                memcpy(dataBuffer, &homing, sizeof(homing));
+                dataLength = sizeof(homing);
+                break;
+              }
+              case I2C::REG_MOTOR_HOME: {
+                // Read: HomingReport (int32 fast error, min and max deviation in 1/128 full steps, uint16 samples,
+                // uint8 MoveEnd, uint8 homed)
+                HomingReport report = axisMotor().getHomingReport();
+                memcpy(dataBuffer, &report, sizeof(report));
+                dataLength = sizeof(report);
+                break;
+              }
+              case I2C::REG_MOTOR_TRACE: {
+                // Read: uint8 count, uint8 flags (bit 0 compiled in, bit 1 recording), uint16 dropped,
+                // then up to 3 TraceEvent records taken from the ring
+                MotionTrace &trace = axisMotor().trace();
+                uint8_t count = 0;
+                TraceEvent event;
+                while (4 + (count + 1) * sizeof(event) <= BUF_SIZE && trace.pop(event)) {
+                  memcpy(dataBuffer + 4 + count * sizeof(event), &event, sizeof(event));
+                  ++count;
+                }
+                uint16_t dropped = trace.dropped();
+                dataBuffer[0] = count;
+                dataBuffer[1] = (MotionTrace::kCompiled ? 0x01 : 0) | (trace.recording() ? 0x02 : 0);
+                memcpy(dataBuffer + 2, &dropped, sizeof(dropped));
+                dataLength = 4 + count * sizeof(event);
+                break;
+              }
               case REG_FIRMWARE_INFO: {
                 const esp_app_desc_t *app_desc = esp_app_get_description();
                 memset(dataBuffer, 0, sizeof(dataBuffer));
@@ -3,11 +3,16 @@
 #include <esp_err.h>
 #include <freertos/FreeRTOS.h>
 
+#include <MotionProgram.hpp>
+#include <Motor.hpp>
+#include <ProfileCodec.hpp>
+
 namespace i2c_slave {
   using i2c_slave_event_type_t = enum { I2C_SLAVE_EVT_RX, I2C_SLAVE_EVT_TX };
   using i2c_slave_event_t = struct {
       i2c_slave_event_type_t type;
       const i2c_slave_rx_done_event_data_t *data;
+      int64_t t_us;
   };
 
   class I2C {
@@ -42,6 +47,18 @@ namespace i2c_slave {
       static constexpr uint8_t REG_MOTOR_HOLD = 0x24;
       static constexpr uint8_t REG_MOTOR_RELEASE = 0x25;
       static constexpr uint8_t REG_MOTOR_RESET = 0x26;
+      static constexpr uint8_t REG_MOTOR_KINEMATICS = 0x27;
+      static constexpr uint8_t REG_MOTOR_PLAN_CACHE = 0x28;
+      static constexpr uint8_t REG_MOTOR_POSITION = 0x29;
+      static constexpr uint8_t REG_MOTOR_GOTO = 0x2A;
+      static constexpr uint8_t REG_MOTOR_LATENCY = 0x2B;
+      static constexpr uint8_t REG_MOTOR_PROGRAM = 0x2C;
+      static constexpr uint8_t REG_MOTOR_FREE_RUN_CFG = 0x2D;
+      static constexpr uint8_t REG_MOTOR_AXIS = 0x2E;
+      static constexpr uint8_t REG_MOTOR_COORDINATED = 0x2F;
+
+      // REG_MOTOR_PROGRAM sub-commands, first data byte
+      enum class ProgramCmd : uint8_t { BEGIN = 1, APPEND = 2, COMMIT = 3, RUN = 4, ERASE = 5 };
 
       // Firmware Info Registers (0x30 - 0x3F)
       static constexpr uint8_t REG_FIRMWARE_INFO = 0x30;
@@ -49,6 +66,22 @@ namespace i2c_slave {
       // WiFi Registers (0x40 - 0x4F)
       static constexpr uint8_t REG_WIFI_CREDENTIALS = 0x40;
 
+      // Motor Registers, continued (0x50 - 0x5F)
+      static constexpr uint8_t REG_MOTOR_COMPLETIONS = 0x50;
+      static constexpr uint8_t REG_MOTOR_COMPLETED_ID = 0x51;
+      static constexpr uint8_t REG_MOTOR_CLOCK = 0x52;
+      static constexpr uint8_t REG_MOTOR_SCHEDULE = 0x53;
+      static constexpr uint8_t REG_MOTOR_JOG = 0x54;
+      static constexpr uint8_t REG_MOTOR_HOMING_CFG = 0x55;
+      static constexpr uint8_t REG_MOTOR_HOME = 0x56;
+      static constexpr uint8_t REG_MOTOR_PROFILE_V2 = 0x57;
+      static constexpr uint8_t REG_MOTOR_DWELL = 0x58;
+      static constexpr uint8_t REG_MOTOR_TRACE = 0x59;
+
+      // REG_MOTOR_SCHEDULE flags
+      static constexpr uint8_t SCHEDULE_FLAG_ABSOLUTE = 0x01; // GOTO instead of a relative move
+      static constexpr uint8_t SCHEDULE_FLAG_COAST = 0x02; // Coast at the end instead of holding
+
       // System Registers (0xF0 - 0xFF)
       static constexpr uint8_t REG_DEVICE_ID = 0xF0;
       static constexpr uint8_t REG_DEVICE_RESTART = 0xF1;
@@ -59,6 +92,18 @@ namespace i2c_slave {
       i2c_slave_dev_handle_t i2c_slave_handle_ = nullptr;
       TaskHandle_t task_ = nullptr;
       QueueHandle_t event_queue_ = nullptr;
+      uint8_t latency_stage_ = 0;
+      // Axis the other motor registers address
+      uint8_t axis_ = 0;
+      motor::Motor &axisMotor() { return motor::Motor::axis(axis_); }
+      // Motion program being uploaded, stored in NVS on COMMIT
+      uint8_t program_buf_[motor::MotionProgram::kMaxInstrs * sizeof(motor::ProgramInstr)];
+      size_t program_len_ = 0;
+      uint8_t program_id_ = 0;
+      esp_err_t program_err_ = ESP_OK;
+      esp_err_t handleProgramCmd(const uint8_t *data, size_t length);
+      // Moves of the v2 profile being decoded, too many for the task stack
+      motor::Move profile_[motor::Motor::kQueueDepth];
       void taskLoop();
   };
 } // namespace i2c_slave
\ No newline at end of file
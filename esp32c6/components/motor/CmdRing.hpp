@@ -0,0 +1,127 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace motor {
+
+  /**
+   * @brief Bounded lock-free ring, many producers and a single consumer
+   *
+   * A producer reserves all the slots of a batch with one CAS, so a batch is queued whole or
+   * rejected whole and batches of concurrent producers never interleave. Each slot carries a
+   * sequence number telling the consumer when it is published (seq == pos + 1) and the producers
+   * when it is free again (seq == pos + N).
+   *
+   * flush() drops everything reserved so far without touching the slots: the consumer skips the
+   * positions below the flush mark as it reaches them.
+   */
+  template <typename T, size_t N> class CmdRing {
+      static_assert(N && (N & (N - 1)) == 0, "CmdRing size must be a power of two");
+
+    public:
+      CmdRing() {
+        for (uint32_t i = 0; i < N; ++i) {
+          slots_[i].seq.store(i + N, std::memory_order_relaxed);
+        }
+      }
+
+      // Producers: queues n items in order, or none of them when they do not all fit
+      bool push(const T *items, size_t n) {
+        return push(n, [items](size_t i) -> const T & { return items[i]; });
+      }
+
+      // Producers: same with the items made in place by make(i), for batches too big to build on a stack
+      template <typename F> bool push(size_t n, F &&make) {
+        if (!n || n > N) {
+          return n == 0;
+        }
+        uint32_t pos = head_.load(std::memory_order_relaxed);
+        for (;;) {
+          uint32_t tail = tail_.load(std::memory_order_acquire);
+          if (pos + n - tail > N) {
+            return false;
+          }
+          if (head_.compare_exchange_weak(pos, pos + n, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+            break;
+          }
+        }
+        for (size_t i = 0; i < n; ++i) {
+          Slot &slot = slots_[(pos + i) & (N - 1)];
+          slot.value = make(i);
+          slot.seq.store(pos + i + 1, std::memory_order_release);
+        }
+        return true;
+      }
+
+      // Any thread: drops all the items reserved so far, including the ones still being written
+      void flush() {
+        uint32_t head = head_.load(std::memory_order_acquire);
+        uint32_t mark = flush_.load(std::memory_order_relaxed);
+        while (static_cast<int32_t>(head - mark) > 0
+               && !flush_.compare_exchange_weak(mark, head, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+      }
+
+      // Consumer: copies the oldest item without taking it
+      bool peek(T &out) {
+        if (!skipFlushed()) {
+          return false;
+        }
+        out = slots_[tail_.load(std::memory_order_relaxed) & (N - 1)].value;
+        return true;
+      }
+
+      // Consumer: takes the oldest item
+      bool pop(T &out) {
+        if (!peek(out)) {
+          return false;
+        }
+        release();
+        return true;
+      }
+
+      // Consumer: takes the item returned by the last peek, false when it was flushed meanwhile
+      bool take() {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (static_cast<int32_t>(flush_.load(std::memory_order_acquire) - tail) > 0) {
+          return false;
+        }
+        release();
+        return true;
+      }
+
+    private:
+      struct Slot {
+          std::atomic<uint32_t> seq;
+          T value;
+      };
+      std::array<Slot, N> slots_;
+      std::atomic<uint32_t> head_ {0}; // Next position to reserve
+      std::atomic<uint32_t> tail_ {0}; // Next position to consume
+      std::atomic<uint32_t> flush_ {0}; // Positions below are dropped
+
+      // Frees the slot at tail, which the consumer has published and read
+      void release() {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        slots_[tail & (N - 1)].seq.store(tail + N, std::memory_order_release);
+        tail_.store(tail + 1, std::memory_order_release);
+      }
+
+      // Moves tail past the flushed items, true when a published item is waiting at tail
+      bool skipFlushed() {
+        for (;;) {
+          uint32_t tail = tail_.load(std::memory_order_relaxed);
+          if (slots_[tail & (N - 1)].seq.load(std::memory_order_acquire) != tail + 1) {
+            return false;
+          }
+          if (static_cast<int32_t>(flush_.load(std::memory_order_acquire) - tail) <= 0) {
+            return true;
+          }
+          release();
+        }
+      }
+  };
+
+} // namespace motor
@@ -1,5 +1,11 @@
 #pragma once
+#include <esp_err.h>
+#include <sdkconfig.h>
+#if CONFIG_IDF_TARGET_LINUX
+#include "SimGpio.hpp"
+#else
 #include <driver/gpio.h>
+#endif
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 
@@ -9,6 +15,12 @@ namespace motor {
 
   static constexpr int STEPS_PER_REVOLUTION = 200;
   static constexpr uint32_t BASE_PERIOD_US = 3072;
+  // Shortest step period, bounded by the LEDC duty resolution on its 80 MHz clock
+  static constexpr uint32_t MIN_PERIOD_US = 50;
+  // Longest step period, bounded by the RMT symbol duration field
+  static constexpr uint32_t MAX_PERIOD_US = 0x7FFF;
+  // Absolute position unit: 1/128 full step, the finest step mode, so any factor counts exactly
+  static constexpr int32_t POSITION_UNITS_PER_STEP = 128;
 
   typedef uint32_t MotorCmdId;
   typedef struct {
@@ -23,13 +35,89 @@ namespace motor {
   };
 
   enum class EndAction { HOLD, COAST };
-  enum class MoveType { FIXED, FREE, STOP, HOLD, RELEASE };
+  // GOTO is a FIXED move to the absolute angle in degrees, resolved against the position when dequeued
+  // PROGRAM runs the stored motion program whose id is in degrees
+  // HOLD, RELEASE and DWELL run in queue order, a DWELL is nothing but its delay_ms
+  enum class MoveType { FIXED, FREE, STOP, HOLD, RELEASE, GOTO, PROGRAM, JOG, HOME, DWELL };
   enum class MotorState { IDLE, DELAYED, STARTED, ERRORED };
+  // EMERGENCY cuts the step train at once, DECELERATE ramps down from the current rate first
+  enum class StopMode : uint8_t { EMERGENCY, DECELERATE };
+  // FAILED: the move could not be started, EMERGENCY also covers moves stopped before their first step
+  enum class MoveEnd : uint8_t { COMPLETED, DECELERATED, EMERGENCY, FAILED };
+  struct MoveReport {
+      uint32_t steps; // At factor, UINT32_MAX when the engine cannot tell
+      uint16_t factor;
+      MoveEnd end;
+  };
+  // Completion record of a dequeued command, also the I2C wire format
+  struct MoveCompletion {
+      MotorCmdId id; // Blended moves complete together under the id of the last one
+      uint32_t steps; // At factor, UINT32_MAX when the engine cannot tell
+      uint32_t duration_us; // From dequeue, pre-move delay included
+      uint16_t factor;
+      uint8_t type; // MoveType as submitted
+      MoveEnd end;
+      // Blended moves have consecutive ids, the record covers first_id through id; first_id == id otherwise
+      MotorCmdId first_id;
+  };
+  static_assert(sizeof(MoveCompletion) == 20);
+  // Where FIXED move segments are switched: in motor task (LEDC paused) or in PCNT ISR (no pause)
+  enum class SegmentSwitch { TASK, ISR };
+  // Step pulse engine: LEDC steered per segment and counted by PCNT, or RMT streaming every step
+  enum class StepEngine { LEDC_PCNT, RMT };
+
+  // Motion limits in full steps, max_velocity of 0 selects the built-in ramp profile
+  struct Kinematics {
+      uint16_t max_velocity; // full steps/s
+      uint16_t acceleration; // full steps/s^2
+      uint16_t jerk; // full steps/s^3, 0 for a trapezoid
+      bool operator==(const Kinematics &) const = default;
+  };
+  // Sent as is over I2C
+  static_assert(sizeof(Kinematics) == 6);
+
+  // Ramped FREE runs, zero velocity runs at the BASE_PERIOD_US rate and stops dead at the stopper
+  struct FreeRunCfg {
+      uint16_t velocity; // full steps/s
+      uint16_t acceleration; // full steps/s^2, also the deceleration past the stopper
+      bool operator==(const FreeRunCfg &) const = default;
+  };
+  // Sent as is over I2C
+  static_assert(sizeof(FreeRunCfg) == 4);
+
+  // Homing: a fast run to the stopper, then slow touches from backoff_degrees away
+  struct HomingCfg {
+      uint16_t fast_velocity; // full steps/s
+      uint16_t slow_velocity; // full steps/s
+      uint16_t acceleration; // full steps/s^2, both speeds
+      uint16_t backoff_degrees;
+      uint16_t touches; // Slow approaches, 1 to kMaxHomingTouches
+      bool operator==(const HomingCfg &) const = default;
+  };
+  // Sent as is over I2C
+  static_assert(sizeof(HomingCfg) == 10);
+  inline constexpr uint16_t kMaxHomingTouches = 8;
+
+  // Trigger points of the last homing in POSITION_UNITS_PER_STEP units, also the I2C wire format
+  struct HomingReport {
+      int32_t fast_error; // Fast edge relative to the first slow edge
+      int32_t min_deviation; // Slow edges relative to the first one
+      int32_t max_deviation;
+      uint16_t samples; // Slow edges measured
+      MoveEnd end;
+      bool homed; // Position zeroed at the last slow edge
+  };
+  static_assert(sizeof(HomingReport) == 16);
 
   struct MotorCfg {
     public:
       StepMode stepMode;
       MotorPins pins;
+      SegmentSwitch segmentSwitch;
+      Kinematics kinematics;
+      StepEngine engine;
+      FreeRunCfg freeRun;
+      uint8_t axis; // Selects the LEDC timer and channel of the axis
   };
 
   struct Move {
@@ -38,6 +126,9 @@ namespace motor {
       uint32_t delay_ms {0}; // pre-exec delay after dequeue
       EndAction end_action {EndAction::COAST};
       MoveType move_type {MoveType::FIXED};
+      // FIXED and GOTO: steps at step_factor instead of degrees, the axis switches to that factor; 0 moves by degrees
+      int32_t steps {0};
+      uint16_t step_factor {0};
   };
 
   const char *moveTypeToName(MoveType move);
@@ -0,0 +1,156 @@
+#include <esp_check.h>
+#include <esp_err.h>
+#include <esp_rom_sys.h>
+
+#include "DriverPins.hpp"
+#include "MotorHal.hpp"
+
+namespace motor {
+
+  static void IRAM_ATTR gpio_stopper_cb(void *ctx) {
+    MotorHal *hal = reinterpret_cast<MotorHal *>(ctx);
+    hal->onStopperISR();
+  }
+
+  esp_err_t DriverPins::init() {
+    // Configure STBY, EN, M0, M1, M2, M3 as pure outputs
+    // M2 will be reconfigured for the step engine after mode setup
+    gpio_config_t io = {
+      .pin_bit_mask = (1ULL << pins_.stby) | (1ULL << pins_.en) | (1ULL << pins_.m0) | (1ULL << pins_.m1)
+                      | (1ULL << pins_.m2) | (1ULL << pins_.m3),
+      .mode = GPIO_MODE_OUTPUT,
+      .pull_up_en = GPIO_PULLUP_DISABLE,
+      .pull_down_en = GPIO_PULLDOWN_DISABLE,
+      .intr_type = GPIO_INTR_DISABLE
+    };
+
+    ESP_RETURN_ON_ERROR(
+      gpio_config(&io), //
+      DriverPins::TAG, //
+      "gpio_config failed" //
+    );
+
+    return ESP_OK;
+  }
+
+  esp_err_t DriverPins::initStopper() {
+    // -- GPIO config
+    gpio_config_t io = {
+      .pin_bit_mask = 1ULL << pins_.stop,
+      .mode = GPIO_MODE_INPUT,
+      .pull_up_en = GPIO_PULLUP_ENABLE,
+      .pull_down_en = GPIO_PULLDOWN_DISABLE,
+      .intr_type = GPIO_INTR_NEGEDGE
+    };
+    ESP_RETURN_ON_ERROR(
+      gpio_config(&io), //
+      DriverPins::TAG, //
+      "gpio_config failed" //
+    );
+    // De-glitcher
+    gpio_pin_glitch_filter_config_t stopper_filter_cfg = {
+      .clk_src = GLITCH_FILTER_CLK_SRC_DEFAULT,
+      .gpio_num = pins_.stop,
+    };
+    ESP_RETURN_ON_ERROR(
+      gpio_new_pin_glitch_filter(&stopper_filter_cfg, &stopper_filter_),
+      DriverPins::TAG, //
+      "gpio_new_glitch_filter failed" //
+    );
+    ESP_RETURN_ON_ERROR(
+      gpio_glitch_filter_enable(stopper_filter_),
+      DriverPins::TAG, //
+      "gpio_glitch_filter_enable failed" //
+    );
+    // -- ISR
+    // Shared by the stoppers of all axes, installed by the first one
+    esp_err_t err = gpio_install_isr_service(ESP_INTR_FLAG_IRAM);
+    ESP_RETURN_ON_FALSE(
+      err == ESP_OK || err == ESP_ERR_INVALID_STATE, //
+      err, //
+      DriverPins::TAG, //
+      "gpio_install_isr_service failed" //
+    );
+    return ESP_OK;
+  }
+
+  esp_err_t DriverPins::setDirection(bool forward) {
+    ESP_RETURN_ON_ERROR(
+      gpio_set_level(pins_.m3, forward ? 1 : 0), //
+      DriverPins::TAG, //
+      "gpio_set_level"
+    );
+    return ESP_OK;
+  }
+
+  esp_err_t DriverPins::setEnable(bool enable) {
+    ESP_RETURN_ON_ERROR(
+      gpio_set_level(pins_.en, enable ? 1 : 0), //
+      DriverPins::TAG, //
+      "gpio_set_level failed"
+    );
+    return ESP_OK;
+  }
+
+  esp_err_t DriverPins::latchMode(uint8_t stepModeBits, gpio_mode_t m2Mode) {
+    // Reconfigure M2 to pure output mode for mode configuration
+    gpio_config_t m2_io = {
+      .pin_bit_mask = (1ULL << pins_.m2),
+      .mode = GPIO_MODE_OUTPUT,
+      .pull_up_en = GPIO_PULLUP_DISABLE,
+      .pull_down_en = GPIO_PULLDOWN_DISABLE,
+      .intr_type = GPIO_INTR_DISABLE
+    };
+    ESP_RETURN_ON_ERROR(gpio_config(&m2_io), DriverPins::TAG, "M2 reconfigure to output failed");
+
+    // Explicitly drive M2 LOW to ensure clean state
+    gpio_set_level(pins_.m2, 0);
+
+    // Put driver in standby with outputs disabled
+    gpio_set_level(pins_.stby, 0);
+    gpio_set_level(pins_.en, 0);
+    esp_rom_delay_us(200);
+
+    // Prepare MODE pins (Fixed mode) BEFORE releasing STBY
+    gpio_set_level(pins_.m0, (stepModeBits >> 0) & 1);
+    gpio_set_level(pins_.m1, (stepModeBits >> 1) & 1);
+    gpio_set_level(pins_.m2, (stepModeBits >> 2) & 1);
+    gpio_set_level(pins_.m3, (stepModeBits >> 3) & 1);
+
+    // Delay before STBY edge
+    esp_rom_delay_us(200);
+
+    // Release Standby => latches control mode per MODE[3:0]
+    gpio_set_level(pins_.stby, 1);
+
+    // Delay after STBY edge
+    esp_rom_delay_us(500);
+
+    // Now reconfigure M2 for the step engine
+    m2_io.mode = m2Mode;
+    ESP_RETURN_ON_ERROR(gpio_config(&m2_io), DriverPins::TAG, "M2 reconfigure for step engine failed");
+
+    return ESP_OK;
+  }
+
+  esp_err_t DriverPins::armStopper(MotorHal *hal) {
+    ESP_RETURN_ON_ERROR(
+      gpio_isr_handler_add(pins_.stop, gpio_stopper_cb, hal), //
+      DriverPins::TAG, //
+      "gpio_isr_handler_add failed" //
+    );
+    ESP_RETURN_ON_ERROR(
+      gpio_intr_enable(pins_.stop), //
+      DriverPins::TAG, //
+      "gpio_intr_enable failed" //
+    );
+    return ESP_OK;
+  }
+
+  esp_err_t DriverPins::disarmStopper() {
+    ESP_ERROR_CHECK(gpio_intr_disable(pins_.stop));
+    ESP_ERROR_CHECK(gpio_isr_handler_remove(pins_.stop));
+    return ESP_OK;
+  }
+
+} // namespace motor
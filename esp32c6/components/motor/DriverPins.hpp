@@ -0,0 +1,33 @@
+#pragma once
+#include <driver/gpio.h>
+#include <driver/gpio_filter.h>
+
+#include "Common.hpp"
+
+namespace motor {
+
+  class MotorHal;
+
+  /**
+   * @brief TC78H670 control pins and the stopper switch, shared by the step engines
+   *
+   * The engine owning STEP (M2) passes the mode M2 is left in after a mode latch.
+   */
+  class DriverPins {
+    public:
+      explicit DriverPins(MotorPins &pins) : pins_(pins) {}
+      esp_err_t init();
+      esp_err_t latchMode(uint8_t modeBits, gpio_mode_t m2Mode);
+      esp_err_t setDirection(bool forward);
+      esp_err_t setEnable(bool enable);
+      esp_err_t initStopper();
+      esp_err_t armStopper(MotorHal *hal);
+      esp_err_t disarmStopper();
+
+    private:
+      static constexpr const char *TAG = "DriverPins";
+      MotorPins &pins_;
+      gpio_glitch_filter_handle_t stopper_filter_ = nullptr;
+  };
+
+} // namespace motor
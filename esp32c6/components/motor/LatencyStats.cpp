@@ -0,0 +1,19 @@
+#include <algorithm>
+#include <esp_attr.h>
+
+#include "LatencyStats.hpp"
+
+namespace motor {
+
+  void IRAM_ATTR LatencyStats::record(LatencyStage stage, int64_t us) {
+    LatencyHistogram &h = histograms_[static_cast<uint8_t>(stage)];
+    uint32_t value = static_cast<uint32_t>(std::clamp<int64_t>(us, 0, UINT32_MAX));
+    uint8_t bucket = value ? 32 - __builtin_clz(value) : 0;
+    bucket = std::min<uint8_t>(bucket, LatencyHistogram::kBuckets - 1);
+    if (h.counts[bucket] != UINT16_MAX) {
+      h.counts[bucket]++;
+    }
+    h.max_us = std::max(h.max_us, value);
+  }
+
+} // namespace motor
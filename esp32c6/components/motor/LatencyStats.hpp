@@ -0,0 +1,43 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+namespace motor {
+  // Measured intervals of a move, from the I2C write that submitted it to its completion
+  enum class LatencyStage : uint8_t {
+    RX_TO_SUBMIT, // I2C RX callback -> Motor::submit queue insert
+    QUEUE_WAIT, // queue insert -> dequeue in the motor task
+    SETUP, // startMove entry -> mode and direction set
+    SETUP_TO_PULSE, // mode and direction set -> step pulses started
+    RX_TO_PULSE, // I2C RX callback -> step pulses started, end to end
+    SEGMENT_SWITCH, // time spent in the segment switch ISR
+    MOVE, // step pulses started -> move stopped
+    SCHEDULE_LATE, // scheduled start time -> step pulses started
+    DEAD_TIME, // move stopped -> step pulses of the move queued behind it started
+    COUNT
+  };
+
+  struct LatencyHistogram {
+      // Bucket b counts intervals in [2^(b-1), 2^b) us, bucket 0 the ones under 1 us
+      static constexpr uint8_t kBuckets = 24;
+      uint32_t max_us;
+      std::array<uint16_t, kBuckets> counts;
+  };
+
+  /**
+   * @brief Log2-bucketed latency histograms, one per LatencyStage
+   *
+   * Counts saturate instead of wrapping. record() is ISR safe.
+   */
+  class LatencyStats {
+    public:
+      void record(LatencyStage stage, int64_t us);
+      const LatencyHistogram &histogram(LatencyStage stage) const {
+        return histograms_[static_cast<uint8_t>(stage)];
+      }
+      void reset() { histograms_ = {}; }
+
+    private:
+      std::array<LatencyHistogram, static_cast<uint8_t>(LatencyStage::COUNT)> histograms_ {};
+  };
+} // namespace motor
@@ -0,0 +1,268 @@
+#include <esp_check.h>
+#include <esp_err.h>
+#include <esp_log.h>
+
+#include "LedcPcntBackend.hpp"
+#include "MotorHal.hpp"
+#include "hal/ledc_ll.h"
+#include "hal/ledc_types.h"
+
+namespace motor {
+
+  static bool IRAM_ATTR
+  pcnt_on_reach_cb(pcnt_unit_handle_t pcnt, const pcnt_watch_event_data_t *ed, void *ctx) {
+    MotorHal *hal = reinterpret_cast<MotorHal *>(ctx);
+    hal->onReachISR(ed->watch_point_value);
+    return false;
+  }
+
+  // Non-virtual, see MotorBackend::IsrOps
+  static void IRAM_ATTR releasePulsesISR(MotorBackend &backend) {
+    static_cast<LedcPcntBackend &>(backend).LedcPcntBackend::releasePulsesFromISR();
+  }
+
+  static void IRAM_ATTR setPeriodISR(MotorBackend &backend, uint32_t period_us) {
+    static_cast<LedcPcntBackend &>(backend).LedcPcntBackend::setPeriodFromISR(period_us);
+  }
+
+  static void IRAM_ATTR pausePulsesISR(MotorBackend &backend) {
+    static_cast<LedcPcntBackend &>(backend).LedcPcntBackend::pausePulsesFromISR();
+  }
+
+  static esp_err_t IRAM_ATTR getCountISR(MotorBackend &backend, int &count) {
+    return static_cast<LedcPcntBackend &>(backend).LedcPcntBackend::getCount(count);
+  }
+
+  static void IRAM_ATTR clearCountISR(MotorBackend &backend) {
+    static_cast<LedcPcntBackend &>(backend).LedcPcntBackend::clearCountFromISR();
+  }
+
+  esp_err_t LedcPcntBackend::init(MotorHal *hal) {
+    hal_ = hal;
+    isr_ops_ = {
+      .releasePulses = releasePulsesISR,
+      .setPeriod = setPeriodISR,
+      .pausePulses = pausePulsesISR,
+      .getCount = getCountISR,
+      .clearCount = clearCountISR,
+    };
+    ESP_RETURN_ON_ERROR(pins_.init(), LedcPcntBackend::TAG, "GPIO initialization failed");
+    ESP_RETURN_ON_ERROR(pins_.initStopper(), LedcPcntBackend::TAG, "Stopper initialization failed");
+    ESP_RETURN_ON_ERROR(initPCNT(), LedcPcntBackend::TAG, "PCNT initialization failed");
+    return ESP_OK;
+  }
+
+  esp_err_t LedcPcntBackend::initPCNT() {
+    // -- Unit
+    pcnt_unit_config_t pcnt_unit_cfg = {};
+    pcnt_unit_cfg.low_limit = -1;
+    // Chained cruise segments end on the limit itself, which resets the count on its own
+    pcnt_unit_cfg.high_limit = RampedMove::maxSegmentSteps;
+    ESP_RETURN_ON_ERROR(pcnt_new_unit(&pcnt_unit_cfg, &pcnt_unit_), LedcPcntBackend::TAG, "pcnt_new_unit failed");
+    // -- Channel
+    pcnt_chan_config_t pcnt_chan_cfg = {};
+    pcnt_chan_cfg.edge_gpio_num = motor_cfg_.pins.m2;
+    pcnt_chan_cfg.level_gpio_num = -1;
+    ESP_RETURN_ON_ERROR(
+      pcnt_new_channel(pcnt_unit_, &pcnt_chan_cfg, &pcnt_channel_), //
+      LedcPcntBackend::TAG, //
+      "pcnt_new_channel failed"
+    );
+    ESP_RETURN_ON_ERROR(
+      pcnt_channel_set_edge_action(
+        pcnt_channel_, PCNT_CHANNEL_EDGE_ACTION_INCREASE, PCNT_CHANNEL_EDGE_ACTION_HOLD
+      ), //
+      LedcPcntBackend::TAG, //
+      "pcnt_channel_set_edge_action"
+    );
+    pcnt_event_callbacks_t cbs {.on_reach = pcnt_on_reach_cb};
+    ESP_RETURN_ON_ERROR(
+      pcnt_unit_register_event_callbacks(pcnt_unit_, &cbs, hal_), //
+      LedcPcntBackend::TAG, //
+      "pcnt_unit_register_event_callbacks failed"
+    );
+    ESP_RETURN_ON_ERROR(
+      pcnt_unit_enable(pcnt_unit_), //
+      LedcPcntBackend::TAG, //
+      "pcnt_unit_enable failed"
+    );
+    return ESP_OK;
+  }
+
+  esp_err_t LedcPcntBackend::setDirection(bool forward) { return pins_.setDirection(forward); }
+
+  esp_err_t LedcPcntBackend::setEnable(bool enable) { return pins_.setEnable(enable); }
+
+  esp_err_t LedcPcntBackend::startPulses(uint32_t period_us) { return configurePulses(period_us, false); }
+
+  esp_err_t LedcPcntBackend::armPulses(uint32_t period_us) { return configurePulses(period_us, true); }
+
+  void IRAM_ATTR LedcPcntBackend::releasePulsesFromISR() {
+    ledc_ll_timer_resume(LEDC_LL_GET_HW(), ledc_mode_, ledc_timer_);
+  }
+
+  // Armed: the timer is left paused at zero, the first pulse goes out on releasePulsesFromISR
+  esp_err_t LedcPcntBackend::configurePulses(uint32_t period_us, bool armed) {
+    if (period_us == 0) {
+      return ESP_ERR_INVALID_ARG;
+    }
+
+    const uint32_t freq_hz = 1000000UL / period_us;
+    // 10 bits keep both BASE_PERIOD_US and MIN_PERIOD_US within the clock divider range
+    const ledc_timer_bit_t duty_resolution = LEDC_TIMER_10_BIT;
+    // Duty cycle of 12.5%
+    const uint32_t duty = 1U << (duty_resolution - 3);
+
+    if (ledc_configured_) {
+      // Timer and channel are kept from the previous move: retune, restart the period and resume
+      ESP_RETURN_ON_ERROR(
+        ledc_set_freq(ledc_mode_, ledc_timer_, freq_hz), //
+        LedcPcntBackend::TAG, //
+        "LEDC set freq failed"
+      );
+      ESP_RETURN_ON_ERROR(
+        ledc_timer_rst(ledc_mode_, ledc_timer_), //
+        LedcPcntBackend::TAG, //
+        "LEDC timer reset failed"
+      );
+      ESP_ERROR_CHECK(ledc_set_duty(ledc_mode_, ledc_channel_, duty));
+      ESP_ERROR_CHECK(ledc_update_duty(ledc_mode_, ledc_channel_));
+      if (!armed) {
+        ESP_RETURN_ON_ERROR(
+          ledc_timer_resume(ledc_mode_, ledc_timer_), //
+          LedcPcntBackend::TAG, //
+          "LEDC timer resume failed"
+        );
+      }
+      ledc_ll_get_clock_divider(LEDC_LL_GET_HW(), ledc_mode_, ledc_timer_, &base_divider_);
+      base_period_us_ = period_us;
+      return ESP_OK;
+    }
+
+    // Configure LEDC timer
+    ledc_timer_config_t ledc_timer_cfg = {};
+    ledc_timer_cfg.speed_mode = ledc_mode_;
+    ledc_timer_cfg.duty_resolution = duty_resolution;
+    ledc_timer_cfg.timer_num = ledc_timer_;
+    ledc_timer_cfg.freq_hz = freq_hz;
+    ledc_timer_cfg.clk_cfg = LEDC_AUTO_CLK;
+
+    ESP_RETURN_ON_ERROR(
+      ledc_timer_config(&ledc_timer_cfg), //
+      LedcPcntBackend::TAG, //
+      "LEDC timer config failed"
+    );
+    if (armed) {
+      // Stopped before the channel routes it to M2, so no pulse leaves early
+      ESP_ERROR_CHECK(ledc_timer_pause(ledc_mode_, ledc_timer_));
+      ESP_ERROR_CHECK(ledc_timer_rst(ledc_mode_, ledc_timer_));
+    }
+
+    // Configure LEDC channel on M2 (STEP pin)
+    ledc_channel_config_t ledc_chan_cfg = {};
+    ledc_chan_cfg.gpio_num = motor_cfg_.pins.m2;
+    ledc_chan_cfg.speed_mode = ledc_mode_;
+    ledc_chan_cfg.channel = ledc_channel_;
+    ledc_chan_cfg.timer_sel = ledc_timer_;
+    ledc_chan_cfg.duty = 0;
+    ledc_chan_cfg.hpoint = 0;
+
+    ESP_RETURN_ON_ERROR(
+      ledc_channel_config(&ledc_chan_cfg), //
+      LedcPcntBackend::TAG, //
+      "LEDC channel config failed"
+    );
+
+    ESP_ERROR_CHECK(ledc_set_duty(ledc_mode_, ledc_channel_, duty));
+    ESP_ERROR_CHECK(ledc_update_duty(ledc_mode_, ledc_channel_));
+
+    ledc_ll_get_clock_divider(LEDC_LL_GET_HW(), ledc_mode_, ledc_timer_, &base_divider_);
+    base_period_us_ = period_us;
+    ledc_configured_ = true;
+    return ESP_OK;
+  }
+
+  esp_err_t LedcPcntBackend::pausePulses() { return ledc_timer_pause(ledc_mode_, ledc_timer_); }
+
+  esp_err_t LedcPcntBackend::resumePulses() { return ledc_timer_resume(ledc_mode_, ledc_timer_); }
+
+  esp_err_t LedcPcntBackend::setPeriod(uint32_t period_us) {
+    return ledc_set_freq(ledc_mode_, ledc_timer_, 1000000 / period_us);
+  }
+
+  esp_err_t LedcPcntBackend::stopPulses() {
+    // Output is parked low with timer and channel left configured for the next move
+    ESP_ERROR_CHECK(ledc_stop(ledc_mode_, ledc_channel_, 0));
+    ESP_ERROR_CHECK(ledc_timer_pause(ledc_mode_, ledc_timer_));
+    return ESP_OK;
+  }
+
+  esp_err_t LedcPcntBackend::deconfigurePulses() {
+    if (!ledc_configured_) {
+      return ESP_OK;
+    }
+    ESP_ERROR_CHECK(ledc_stop(ledc_mode_, ledc_channel_, 0));
+    ESP_ERROR_CHECK(ledc_timer_pause(ledc_mode_, ledc_timer_));
+    ESP_ERROR_CHECK(ledc_set_duty(ledc_mode_, ledc_channel_, 0));
+    ESP_ERROR_CHECK(ledc_update_duty(ledc_mode_, ledc_channel_));
+
+    ledc_channel_config_t ledc_chan_cfg = {};
+    ledc_chan_cfg.deconfigure = true;
+    ESP_RETURN_ON_ERROR(
+      ledc_channel_config(&ledc_chan_cfg), //
+      LedcPcntBackend::TAG, //
+      "LEDC channel deconfig failed"
+    );
+
+    ledc_timer_config_t ledc_timer_cfg = {};
+    ledc_timer_cfg.deconfigure = true;
+    ledc_timer_cfg.timer_num = ledc_timer_;
+    ledc_timer_cfg.speed_mode = ledc_mode_;
+    ESP_RETURN_ON_ERROR(
+      ledc_timer_config(&ledc_timer_cfg), //
+      LedcPcntBackend::TAG, //
+      "LEDC timer deconfig failed"
+    );
+    ledc_configured_ = false;
+    return ESP_OK;
+  }
+
+  void IRAM_ATTR LedcPcntBackend::setPeriodFromISR(uint32_t period_us) {
+    // The timer latches the new divider at its next overflow
+    uint32_t divider = base_divider_ * period_us / base_period_us_;
+    ledc_ll_set_clock_divider(LEDC_LL_GET_HW(), ledc_mode_, ledc_timer_, divider);
+    ledc_ll_ls_timer_update(LEDC_LL_GET_HW(), ledc_mode_, ledc_timer_);
+  }
+
+  void IRAM_ATTR LedcPcntBackend::pausePulsesFromISR() {
+    ledc_ll_timer_pause(LEDC_LL_GET_HW(), ledc_mode_, ledc_timer_);
+  }
+
+  esp_err_t LedcPcntBackend::startCounter() { return pcnt_unit_start(pcnt_unit_); }
+
+  esp_err_t LedcPcntBackend::stopCounter() { return pcnt_unit_stop(pcnt_unit_); }
+
+  esp_err_t LedcPcntBackend::clearCount() { return pcnt_unit_clear_count(pcnt_unit_); }
+
+  esp_err_t LedcPcntBackend::addWatchPoint(int value) { return pcnt_unit_add_watch_point(pcnt_unit_, value); }
+
+  esp_err_t LedcPcntBackend::removeWatchPoint(int value) {
+    return pcnt_unit_remove_watch_point(pcnt_unit_, value);
+  }
+
+  esp_err_t IRAM_ATTR LedcPcntBackend::getCount(int &count) { return pcnt_unit_get_count(pcnt_unit_, &count); }
+
+  void IRAM_ATTR LedcPcntBackend::clearCountFromISR() { pcnt_unit_clear_count(pcnt_unit_); }
+
+  esp_err_t LedcPcntBackend::latchMode(uint8_t stepModeBits) {
+    // M2 is taken back from LEDC for the mode pins, the channel gets routed again by startPulses
+    ESP_RETURN_ON_ERROR(deconfigurePulses(), LedcPcntBackend::TAG, "LEDC deconfigure failed");
+    // M2 is left as LEDC output and PCNT input at once
+    return pins_.latchMode(stepModeBits, GPIO_MODE_INPUT_OUTPUT);
+  }
+
+  esp_err_t LedcPcntBackend::armStopper() { return pins_.armStopper(hal_); }
+
+  esp_err_t LedcPcntBackend::disarmStopper() { return pins_.disarmStopper(); }
+
+} // namespace motor
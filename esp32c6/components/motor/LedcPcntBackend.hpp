@@ -0,0 +1,64 @@
+#pragma once
+#include <driver/ledc.h>
+#include <driver/pulse_cnt.h>
+
+#include "DriverPins.hpp"
+#include "MotorBackend.hpp"
+
+namespace motor {
+
+  /**
+   * @brief Step generation on LEDC (STEP on M2) with pulses counted back by PCNT from the same pin
+   */
+  class LedcPcntBackend : public MotorBackend {
+    public:
+      explicit LedcPcntBackend(MotorCfg &motorConfig)
+        : motor_cfg_(motorConfig),
+          pins_(motorConfig.pins),
+          ledc_timer_(static_cast<ledc_timer_t>(LEDC_TIMER_0 + motorConfig.axis)),
+          ledc_channel_(static_cast<ledc_channel_t>(LEDC_CHANNEL_0 + motorConfig.axis)) {}
+      esp_err_t init(MotorHal *hal) override;
+      esp_err_t latchMode(uint8_t modeBits) override;
+      esp_err_t setDirection(bool forward) override;
+      esp_err_t setEnable(bool enable) override;
+      esp_err_t startPulses(uint32_t period_us) override;
+      esp_err_t armPulses(uint32_t period_us) override;
+      void releasePulsesFromISR() override;
+      esp_err_t pausePulses() override;
+      esp_err_t resumePulses() override;
+      esp_err_t setPeriod(uint32_t period_us) override;
+      esp_err_t stopPulses() override;
+      void setPeriodFromISR(uint32_t period_us) override;
+      void pausePulsesFromISR() override;
+      esp_err_t startCounter() override;
+      esp_err_t stopCounter() override;
+      esp_err_t clearCount() override;
+      esp_err_t addWatchPoint(int value) override;
+      esp_err_t removeWatchPoint(int value) override;
+      esp_err_t getCount(int &count) override;
+      void clearCountFromISR() override;
+      esp_err_t armStopper() override;
+      esp_err_t disarmStopper() override;
+
+    private:
+      static constexpr const char *TAG = "LedcPcntBackend";
+      MotorCfg &motor_cfg_;
+      DriverPins pins_;
+      MotorHal *hal_ = nullptr;
+      pcnt_unit_handle_t pcnt_unit_ = nullptr;
+      pcnt_channel_handle_t pcnt_channel_ = nullptr;
+      ledc_mode_t ledc_mode_ = LEDC_LOW_SPEED_MODE;
+      // One timer and channel per axis
+      ledc_timer_t ledc_timer_;
+      ledc_channel_t ledc_channel_;
+      // LEDC divider is proportional to the period, ISR updates scale from the one set by startPulses
+      uint32_t base_divider_ = 0;
+      uint32_t base_period_us_ = 0;
+      // Timer and channel survive stopPulses, only a mode latch releases them
+      bool ledc_configured_ = false;
+      esp_err_t configurePulses(uint32_t period_us, bool armed);
+      esp_err_t deconfigurePulses();
+      esp_err_t initPCNT();
+  };
+
+} // namespace motor
@@ -0,0 +1,148 @@
+#include <cstdio>
+#include <cstring>
+#include <nvs.h>
+
+#include "MotionProgram.hpp"
+
+namespace motor {
+
+  static constexpr const char *NVS_NAMESPACE = "motor_prog";
+
+  esp_err_t MotionProgram::assign(const uint8_t *data, size_t length) {
+    count_ = 0;
+    rewind();
+    if (length == 0 || length % sizeof(ProgramInstr) || length / sizeof(ProgramInstr) > kMaxInstrs) {
+      return ESP_ERR_INVALID_SIZE;
+    }
+    size_t count = length / sizeof(ProgramInstr);
+    memcpy(instrs_.data(), data, length);
+    size_t depth = 0;
+    for (size_t i = 0; i < count; ++i) {
+      switch (instrs_[i].op) {
+        case ProgramOp::MOVE:
+        case ProgramOp::GOTO:
+        case ProgramOp::DWELL:
+        case ProgramOp::HOLD:
+        case ProgramOp::RELEASE:
+          break;
+        case ProgramOp::REPEAT:
+          if (++depth > kMaxDepth) {
+            return ESP_ERR_INVALID_ARG;
+          }
+          break;
+        case ProgramOp::LOOP:
+          if (depth-- == 0) {
+            return ESP_ERR_INVALID_ARG;
+          }
+          break;
+        default:
+          return ESP_ERR_INVALID_ARG;
+      }
+    }
+    if (depth) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    count_ = count;
+    return ESP_OK;
+  }
+
+  void MotionProgram::rewind() {
+    pc_ = 0;
+    depth_ = 0;
+  }
+
+  bool MotionProgram::next(ProgramInstr &out) {
+    while (pc_ < count_) {
+      const ProgramInstr &instr = instrs_[pc_++];
+      if (instr.op == ProgramOp::REPEAT) {
+        uint16_t passes = static_cast<uint16_t>(instr.arg);
+        frames_[depth_++] = Frame {
+          .body = pc_,
+          .remaining = static_cast<uint16_t>(passes ? passes - 1 : 0),
+          .forever = !passes,
+          .progressed = false,
+        };
+        continue;
+      }
+      if (instr.op == ProgramOp::LOOP) {
+        Frame &frame = frames_[depth_ - 1];
+        if (frame.progressed && (frame.forever || frame.remaining)) {
+          frame.remaining -= frame.forever ? 0 : 1;
+          frame.progressed = false;
+          pc_ = frame.body;
+        } else {
+          --depth_;
+        }
+        continue;
+      }
+      if ((instr.op == ProgramOp::MOVE || instr.op == ProgramOp::DWELL) && !instr.arg) {
+        continue; // No-ops
+      }
+      out = instr;
+      return true;
+    }
+    return false;
+  }
+
+  void MotionProgram::progressed() {
+    // The enclosing loops progressed with it
+    for (size_t i = 0; i < depth_; ++i) {
+      frames_[i].progressed = true;
+    }
+  }
+
+  namespace ProgramStore {
+    static void keyFor(uint8_t id, char (&key)[8]) { snprintf(key, sizeof(key), "prog%u", id); }
+
+    esp_err_t save(uint8_t id, const MotionProgram &program) {
+      nvs_handle_t nvs_handle;
+      esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+      if (err != ESP_OK) {
+        return err;
+      }
+      char key[8];
+      keyFor(id, key);
+      err = nvs_set_blob(nvs_handle, key, program.data(), program.length());
+      if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+      }
+      nvs_close(nvs_handle);
+      return err;
+    }
+
+    esp_err_t load(uint8_t id, MotionProgram &program) {
+      nvs_handle_t nvs_handle;
+      esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+      if (err != ESP_OK) {
+        return err;
+      }
+      char key[8];
+      keyFor(id, key);
+      uint8_t data[MotionProgram::kMaxInstrs * sizeof(ProgramInstr)];
+      size_t length = sizeof(data);
+      err = nvs_get_blob(nvs_handle, key, data, &length);
+      nvs_close(nvs_handle);
+      if (err != ESP_OK) {
+        return err;
+      }
+      return program.assign(data, length);
+    }
+
+    esp_err_t erase(uint8_t id) {
+      nvs_handle_t nvs_handle;
+      esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+      if (err != ESP_OK) {
+        return err;
+      }
+      char key[8];
+      keyFor(id, key);
+      err = nvs_erase_key(nvs_handle, key);
+      if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+      }
+      nvs_close(nvs_handle);
+      return err;
+    }
+  } // namespace ProgramStore
+
+} // namespace motor
@@ -0,0 +1,70 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <esp_err.h>
+
+namespace motor {
+
+  enum class ProgramOp : uint8_t {
+    MOVE = 1, // Relative move by arg degrees
+    GOTO = 2, // Absolute move to arg degrees
+    DWELL = 3, // Wait for arg ms (uint16)
+    HOLD = 4, // Energize the coils
+    RELEASE = 5, // De-energize the coils
+    REPEAT = 6, // Runs the body up to the matching LOOP arg times (uint16), 0 forever
+    LOOP = 7 // Ends a REPEAT body
+  };
+
+  // Wire and storage format of one instruction, little endian
+  struct ProgramInstr {
+      ProgramOp op;
+      uint8_t flags; // MOVE, GOTO: PROGRAM_FLAG_HOLD to hold at the end instead of coasting
+      int16_t arg;
+  };
+  static_assert(sizeof(ProgramInstr) == 4);
+
+  static constexpr uint8_t PROGRAM_FLAG_HOLD = 0x01;
+
+  /**
+   * @brief A validated motion program and the cursor of its execution
+   *
+   * next() unrolls the REPEAT/LOOP blocks and yields the MOVE, GOTO, DWELL, HOLD and RELEASE
+   * instructions in execution order. The runner calls progressed() when one of them ran steps or
+   * waited; a loop pass without it ends the loop, so a forever loop cannot spin without moving.
+   */
+  class MotionProgram {
+    public:
+      static constexpr size_t kMaxInstrs = 64;
+      static constexpr size_t kMaxDepth = 4;
+      // Copies and validates raw instructions, the program is left empty when they are invalid
+      esp_err_t assign(const uint8_t *data, size_t length);
+      const uint8_t *data() const { return reinterpret_cast<const uint8_t *>(instrs_.data()); }
+      size_t length() const { return count_ * sizeof(ProgramInstr); }
+      void rewind();
+      bool next(ProgramInstr &out);
+      // The last instruction from next() moved the motor or waited
+      void progressed();
+
+    private:
+      struct Frame {
+          size_t body; // Index of the first instruction after REPEAT
+          uint16_t remaining; // Passes left after the current one, unused when forever
+          bool forever;
+          bool progressed; // The current pass moved or waited
+      };
+      std::array<ProgramInstr, kMaxInstrs> instrs_ {};
+      size_t count_ = 0;
+      size_t pc_ = 0;
+      std::array<Frame, kMaxDepth> frames_ {};
+      size_t depth_ = 0;
+  };
+
+  // Programs kept in NVS by id
+  namespace ProgramStore {
+    esp_err_t save(uint8_t id, const MotionProgram &program);
+    esp_err_t load(uint8_t id, MotionProgram &program);
+    esp_err_t erase(uint8_t id);
+  } // namespace ProgramStore
+
+} // namespace motor
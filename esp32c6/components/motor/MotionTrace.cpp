@@ -0,0 +1,35 @@
+#include <algorithm>
+#include <esp_attr.h>
+#include <esp_timer.h>
+
+#include "MotionTrace.hpp"
+
+namespace motor {
+
+  void MotionTrace::start() {
+    recording_.store(false, std::memory_order_release);
+    events_.flush();
+    dropped_.store(0, std::memory_order_relaxed);
+    recording_.store(kCompiled, std::memory_order_release);
+  }
+
+  void IRAM_ATTR
+  MotionTrace::push(TraceKind kind, int32_t value, uint32_t period_us, uint32_t steps, uint32_t count, uint8_t arg) {
+    TraceEvent event {
+      .t_us = static_cast<uint32_t>(esp_timer_get_time()),
+      .value = value,
+      .period_us = static_cast<uint16_t>(std::min<uint32_t>(period_us, UINT16_MAX)),
+      .steps = static_cast<uint16_t>(std::min<uint32_t>(steps, UINT16_MAX)),
+      .count = static_cast<uint16_t>(std::min<uint32_t>(count, UINT16_MAX)),
+      .kind = kind,
+      .arg = arg,
+    };
+    if (!events_.push(&event, 1)) {
+      uint16_t dropped = dropped_.load(std::memory_order_relaxed);
+      if (dropped != UINT16_MAX) {
+        dropped_.store(dropped + 1, std::memory_order_relaxed);
+      }
+    }
+  }
+
+} // namespace motor
@@ -0,0 +1,72 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <sdkconfig.h>
+
+#include "CmdRing.hpp"
+
+namespace motor {
+
+  /**
+   * What the step engine did, each kind filling the TraceEvent fields as listed
+   *
+   * period_us and steps are the segment running from the event on, count the steps the counter
+   * saw since the previous event of the move, 0 when it cannot tell.
+   */
+  enum class TraceKind : uint8_t {
+    START, // Pulses out: value signed planned steps (+1/-1 when unbounded), count step factor, arg MoveType
+    SEGMENT, // Watch point reached or period switched: value plan or ramp table index
+    DECEL, // Rest of the move replaced by its ramp-down: value ramp-down start index
+    STOPPER, // Stopper edge: value steps from the start to the edge, ramped FREE runs only
+    PAUSE, // End of the plan or ramp: value its index, pulses paused
+    STOP, // Move stopped by the task: value position after it, arg 1 when the plan ran out
+  };
+
+  // Also the I2C wire format
+  struct TraceEvent {
+      uint32_t t_us; // esp_timer, low 32 bits
+      int32_t value;
+      uint16_t period_us;
+      uint16_t steps; // 0 for no bound
+      uint16_t count;
+      TraceKind kind;
+      uint8_t arg;
+  };
+  static_assert(sizeof(TraceEvent) == 16);
+
+  /**
+   * @brief Recorder of the motion as executed, for diffing against the plan
+   *
+   * Compiled in with CONFIG_MOTOR_TRACE, records between start() and stop(). Events go to a fixed
+   * ring drained by a single reader, the ones that do not fit are dropped and counted. record() is
+   * ISR safe and returns at once when not recording.
+   */
+  class MotionTrace {
+    public:
+#if CONFIG_MOTOR_TRACE
+      static constexpr bool kCompiled = true;
+      static constexpr size_t kDepth = CONFIG_MOTOR_TRACE_DEPTH;
+#else
+      static constexpr bool kCompiled = false;
+      static constexpr size_t kDepth = 1;
+#endif
+      // Drops the events left over and records from now on
+      void start();
+      void stop() { recording_.store(false, std::memory_order_release); }
+      bool recording() const { return kCompiled && recording_.load(std::memory_order_acquire); }
+      void record(TraceKind kind, int32_t value, uint32_t period_us, uint32_t steps, uint32_t count, uint8_t arg = 0) {
+        if (recording()) {
+          push(kind, value, period_us, steps, count, arg);
+        }
+      }
+      bool pop(TraceEvent &out) { return kCompiled && events_.pop(out); }
+      uint16_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    private:
+      CmdRing<TraceEvent, kDepth> events_;
+      std::atomic<bool> recording_ {false};
+      std::atomic<uint16_t> dropped_ {0}; // Since start(), saturated
+      void push(TraceKind kind, int32_t value, uint32_t period_us, uint32_t steps, uint32_t count, uint8_t arg);
+  };
+
+} // namespace motor
@@ -1,3 +1,9 @@
+#include <algorithm>
+#include <cassert>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <esp_attr.h>
 #include <esp_check.h>
 
 #include "Common.hpp"
@@ -5,6 +11,7 @@
 #include "MotorHal.hpp"
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 namespace motor {
 
@@ -20,13 +27,67 @@ namespace motor {
         return "HOLD";
       case MoveType::RELEASE:
         return "RELEASE";
+      case MoveType::GOTO:
+        return "GOTO";
+      case MoveType::PROGRAM:
+        return "PROGRAM";
+      case MoveType::JOG:
+        return "JOG";
+      case MoveType::HOME:
+        return "HOME";
+      case MoveType::DWELL:
+        return "DWELL";
     }
     return NULL;
   };
 
+  // Pins of each axis' driver, axis 0 is the original single driver wiring
+  static constexpr std::array<MotorPins, 2> kAxisPins = {{
+    {.stby = GPIO_NUM_5,
+     .en = GPIO_NUM_4,
+     .m0 = GPIO_NUM_19,
+     .m1 = GPIO_NUM_18,
+     .m2 = GPIO_NUM_17,
+     .m3 = GPIO_NUM_16,
+     .stop = GPIO_NUM_3},
+    {.stby = GPIO_NUM_20,
+     .en = GPIO_NUM_21,
+     .m0 = GPIO_NUM_22,
+     .m1 = GPIO_NUM_23,
+     .m2 = GPIO_NUM_10,
+     .m3 = GPIO_NUM_11,
+     .stop = GPIO_NUM_2},
+  }};
+  static_assert(Motor::kAxisCount <= kAxisPins.size(), "No pins for every axis");
+
+  Motor &Motor::axis(uint8_t index) {
+    static std::array<Motor, kAxisCount> axes = makeAxes(std::make_index_sequence<kAxisCount> {});
+    assert(index < kAxisCount);
+    return axes[index];
+  }
+
   void Motor::setStepFactor(uint16_t factor) { motor_config_.stepMode.setFactor(factor); }
   uint16_t Motor::getStepFactor() { return motor_config_.stepMode.getFactor(); }
 
+  // Zero max_velocity restores the built-in ramp profile; takes effect from the next move
+  esp_err_t Motor::setKinematics(const Kinematics &kinematics) {
+    // A ramp too long for the table would have segments past what the step counter can watch
+    if (kinematics.max_velocity && (!kinematics.acceleration || !RampedMove::fits(kinematics))) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    motor_config_.kinematics = kinematics;
+    return ESP_OK;
+  }
+
+  // Zero velocity restores the unramped run at the BASE_PERIOD_US rate; takes effect from the next run
+  esp_err_t Motor::setFreeRun(const FreeRunCfg &freeRun) {
+    if (freeRun.velocity && !freeRun.acceleration) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    motor_config_.freeRun = freeRun;
+    return ESP_OK;
+  }
+
   esp_err_t Motor::init() {
     if (initialized_) {
       ESP_LOGW(TAG, "Already initialized");
@@ -34,19 +95,14 @@ namespace motor {
     }
     motor_config_ = MotorCfg {
       .stepMode = StepMode(StepMode::ModeBits::FixedFull),
-      .pins = {
-        .stby = GPIO_NUM_5,
-        .en = GPIO_NUM_4,
-        .m0 = GPIO_NUM_19,
-        .m1 = GPIO_NUM_18,
-        .m2 = GPIO_NUM_17,
-        .m3 = GPIO_NUM_16,
-        .stop = GPIO_NUM_3
-      }
+      .pins = kAxisPins[index_],
+      .segmentSwitch = SegmentSwitch::ISR,
+      .engine = StepEngine::LEDC_PCNT,
+      .axis = index_
     };
-    if (!cmd_q_) {
-      cmd_q_ = xQueueCreate(Motor::kQueueDepth, sizeof(QueuedCmd));
-      if (!cmd_q_) {
+    if (!cmd_ready_) {
+      cmd_ready_ = xSemaphoreCreateBinary();
+      if (!cmd_ready_) {
         return ESP_ERR_NO_MEM;
       }
     }
@@ -56,97 +112,900 @@ namespace motor {
 
     ESP_RETURN_ON_ERROR(hal_->init(), Motor::TAG, "MotorHal::init failed");
 
+    if (!start_timer_) {
+      esp_timer_create_args_t timer_args = {
+        .callback = Motor::onStartTimer,
+        .arg = this,
+#if CONFIG_ESP_TIMER_SUPPORTS_ISR_DISPATCH_METHOD
+        // Released from the timer ISR, not behind the esp_timer task
+        .dispatch_method = ESP_TIMER_ISR,
+#else
+        .dispatch_method = ESP_TIMER_TASK,
+#endif
+        .name = "motor_start",
+        .skip_unhandled_events = false,
+      };
+      ESP_RETURN_ON_ERROR(esp_timer_create(&timer_args, &start_timer_), Motor::TAG, "esp_timer_create failed");
+    }
+
     if (!task_) {
-      xTaskCreate(Motor::taskTrampoline, "motor_task", 4096, this, 7, &task_);
+      char name[configMAX_TASK_NAME_LEN];
+      snprintf(name, sizeof(name), "motor_task%u", index_);
+      xTaskCreate(Motor::taskTrampoline, name, 4096, this, 7, &task_);
       hal_->registerTaskHandle(task_);
     }
     initialized_ = true;
-    ESP_LOGI(TAG, "Motor initialized");
+    ESP_LOGI(TAG, "Motor axis %u initialized", index_);
     return ESP_OK;
   }
 
   esp_err_t Motor::resetQueue() {
-    if (!cmd_q_) {
+    if (!cmd_ready_) {
       return ESP_ERR_INVALID_STATE;
     }
-    return xQueueReset(cmd_q_);
+    flushQueue();
+    return ESP_OK;
   }
 
-  esp_err_t Motor::submit(const Move &mv) {
-    bool isIdle = motor_state_.load(std::memory_order_acquire) == MotorState::IDLE;
-    if (mv.move_type == MoveType::HOLD) {
-      return isIdle ? hal_->holdOrRelease(true) : ESP_ERR_INVALID_STATE;
+  void Motor::flushQueue() {
+    flushed_through_.store(next_id_.load(std::memory_order_relaxed) - 1, std::memory_order_release);
+    cmd_q_.flush();
+    cancelCoordinated();
+    portENTER_CRITICAL(&jog_lock_);
+    if (jog_state_ == JogState::QUEUED) {
+      jog_state_ = JogState::OFF; // Its JOG move was just dropped
+    }
+    portEXIT_CRITICAL(&jog_lock_);
+  }
+
+  esp_err_t Motor::jog(int32_t velocity) {
+    if (!cmd_ready_) {
+      return ESP_ERR_INVALID_STATE;
     }
-    if (mv.move_type == MoveType::RELEASE) {
-      return isIdle ? hal_->holdOrRelease(false) : ESP_ERR_INVALID_STATE;
+    portENTER_CRITICAL(&jog_lock_);
+    jog_velocity_ = velocity;
+    JogState state = jog_state_;
+    if (state == JogState::OFF && velocity) {
+      jog_state_ = JogState::QUEUED;
     }
-    if (!cmd_q_) {
+    portEXIT_CRITICAL(&jog_lock_);
+    if (state == JogState::RUNNING) {
+      xTaskNotifyGive(task_); // The motor task applies the new target
+      return ESP_OK;
+    }
+    if (state != JogState::OFF || !velocity) {
+      return ESP_OK; // Queued already, it starts with the latest target
+    }
+    Move mv {.degrees = velocity > 0 ? +1 : -1, .end_action = EndAction::HOLD, .move_type = MoveType::JOG};
+    esp_err_t err = submitBatch(&mv, 1);
+    if (err != ESP_OK) {
+      portENTER_CRITICAL(&jog_lock_);
+      jog_state_ = JogState::OFF;
+      portEXIT_CRITICAL(&jog_lock_);
+    }
+    return err;
+  }
+
+  int32_t Motor::getJogVelocity() {
+    portENTER_CRITICAL(&jog_lock_);
+    int32_t velocity = jog_velocity_;
+    portEXIT_CRITICAL(&jog_lock_);
+    return velocity;
+  }
+
+  bool Motor::isJogging() {
+    portENTER_CRITICAL(&jog_lock_);
+    bool running = jog_state_ == JogState::RUNNING;
+    portEXIT_CRITICAL(&jog_lock_);
+    return running;
+  }
+
+  esp_err_t Motor::home(int8_t direction) {
+    Move mv {.degrees = direction > 0 ? +1 : -1, .end_action = EndAction::HOLD, .move_type = MoveType::HOME};
+    return submitBatch(&mv, 1);
+  }
+
+  // Takes effect from the next homing
+  esp_err_t Motor::setHoming(const HomingCfg &cfg) {
+    if (
+      !cfg.fast_velocity || !cfg.slow_velocity || !cfg.acceleration || !cfg.backoff_degrees || !cfg.touches
+      || cfg.touches > kMaxHomingTouches
+    ) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&homing_lock_);
+    homing_ = cfg;
+    portEXIT_CRITICAL(&homing_lock_);
+    return ESP_OK;
+  }
+
+  HomingCfg Motor::getHoming() {
+    portENTER_CRITICAL(&homing_lock_);
+    HomingCfg cfg = homing_;
+    portEXIT_CRITICAL(&homing_lock_);
+    return cfg;
+  }
+
+  HomingReport Motor::getHomingReport() {
+    portENTER_CRITICAL(&homing_lock_);
+    HomingReport report = homing_report_;
+    portEXIT_CRITICAL(&homing_lock_);
+    return report;
+  }
+
+  esp_err_t Motor::submit(const Move &mv) {
+    if (!cmd_ready_) {
       return ESP_ERR_INVALID_STATE;
     }
 
     if (mv.move_type == MoveType::STOP) {
-      xQueueReset(cmd_q_);
-      if (motor_state_.load(std::memory_order_acquire) == MotorState::STARTED) {
-        stop_requested_ = true;
-        xTaskNotifyGive(task_);
-      }
-      return ESP_OK;
-    }
-    QueuedCmd q {mv, next_id_++};
-    if (xQueueSend(cmd_q_, &q, 0) != pdTRUE) {
-      return ESP_ERR_NO_MEM;
+      return stop(StopMode::EMERGENCY);
     }
     if (mv.move_type == MoveType::FREE) {
+      // The run to the stopper is followed by a back-off, queued together
       int dir = mv.degrees > 0 ? +1 : -1;
-      submit(
+      Move run[] = {
+        mv,
         Move {
           .degrees = -dir * 180,
           .end_action = EndAction::HOLD,
           .move_type = MoveType::FIXED,
-        }
-      );
+        },
+      };
+      return submitBatch(run, 2);
+    }
+    return submitBatch(&mv, 1);
+  }
+
+  esp_err_t Motor::stop(StopMode mode) {
+    if (!cmd_ready_) {
+      return ESP_ERR_INVALID_STATE;
+    }
+    flushQueue();
+    // Ends the move or the delay in progress, a delayed move is dropped. Raised whatever the state:
+    // a command dequeued but not started yet checks it before its first pulse
+    stop_mode_.store(mode, std::memory_order_relaxed);
+    stop_requested_.store(true, std::memory_order_release);
+    xTaskNotifyGive(task_);
+    return ESP_OK;
+  }
+
+  MoveReport Motor::getLastMove() {
+    return {
+      .steps = hal_->lastMoveSteps(),
+      .factor = hal_->lastMoveFactor(),
+      .end = last_end_.load(std::memory_order_relaxed),
+    };
+  }
+
+  // Stamps ids and submission times on the commands make(i) returns as they go into the ring, queued whole
+  template <typename F> esp_err_t Motor::enqueue(size_t count, F &&make) {
+    MotorCmdId id = next_id_.fetch_add(count, std::memory_order_relaxed);
+    int64_t rx_us = rx_us_.load(std::memory_order_relaxed);
+    int64_t submit_us = esp_timer_get_time();
+    bool queued = cmd_q_.push(count, [&](size_t i) {
+      QueuedCmd c = make(i);
+      c.id = id + static_cast<MotorCmdId>(i);
+      c.rx_us = rx_us;
+      c.submit_us = submit_us;
+      return c;
+    });
+    if (!queued) {
+      return ESP_ERR_NO_MEM;
+    }
+    xSemaphoreGive(cmd_ready_);
+    if (rx_us) {
+      hal_->latency().record(LatencyStage::RX_TO_SUBMIT, submit_us - rx_us);
     }
-    stop_requested_ = false;
     return ESP_OK;
   }
 
+  esp_err_t Motor::submitBatch(const Move *moves, size_t count) {
+    if (!cmd_ready_) {
+      return ESP_ERR_INVALID_STATE;
+    }
+    if (!count || count > kQueueDepth) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < count; ++i) {
+      MoveType type = moves[i].move_type;
+      if (
+        type != MoveType::FIXED && type != MoveType::FREE && type != MoveType::GOTO && type != MoveType::PROGRAM
+        && type != MoveType::JOG && type != MoveType::HOME && type != MoveType::HOLD && type != MoveType::RELEASE
+        && type != MoveType::DWELL
+      ) {
+        return ESP_ERR_INVALID_ARG;
+      }
+    }
+    return enqueue(count, [moves](size_t i) { return QueuedCmd {moves[i], 0, 0, 0, 0, 0, 0}; });
+  }
+
+  esp_err_t Motor::submitAt(const Move &mv, int64_t at_us) {
+    if (!cmd_ready_) {
+      return ESP_ERR_INVALID_STATE;
+    }
+    if ((mv.move_type != MoveType::FIXED && mv.move_type != MoveType::GOTO) || at_us <= 0) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    QueuedCmd c {mv, 0, 0, 0, 0, 0, at_us};
+    c.mv.delay_ms = 0;
+    return enqueue(&c, 1);
+  }
+
+  esp_err_t Motor::enqueue(const QueuedCmd *batch, size_t count) {
+    return enqueue(count, [batch](size_t i) -> const QueuedCmd & { return batch[i]; });
+  }
+
+  esp_err_t Motor::submitCoordinated(const int32_t *degrees, size_t count) {
+    if (!count || count > kAxisCount) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    // -- planning every axis as it would run alone, the longest one sets the pace
+    QueuedCmd cmds[kAxisCount] {};
+    uint64_t duration_us[kAxisCount] {};
+    uint64_t longest_us = 0;
+    uint8_t members = 0;
+    for (uint8_t i = 0; i < count; ++i) {
+      Motor &m = axis(i);
+      if (!m.cmd_ready_) {
+        return ESP_ERR_INVALID_STATE;
+      }
+      uint16_t factor = m.motor_config_.stepMode.getFactor();
+      int32_t steps = RampedMove::stepsFor(degrees[i], factor);
+      if (!steps) {
+        continue; // Axis stays put
+      }
+      duration_us[i] = RampedMove(steps, RampedMove::rampTable(m.motor_config_.kinematics, factor)).durationUs();
+      longest_us = std::max(longest_us, duration_us[i]);
+      members |= 1u << i;
+    }
+    if (!members) {
+      return ESP_OK;
+    }
+    // -- forming the group
+    portENTER_CRITICAL(&sync_lock_);
+    bool busy = sync_.state == SyncState::FORMING;
+    uint32_t gen = 0;
+    if (!busy) {
+      gen = ++sync_.generation ? sync_.generation : ++sync_.generation;
+      sync_.state = SyncState::FORMING;
+      sync_.members = members;
+      sync_.arrived = 0;
+    }
+    portEXIT_CRITICAL(&sync_lock_);
+    if (busy) {
+      return ESP_ERR_INVALID_STATE;
+    }
+    // -- queueing the stretched moves, one axis refusing cancels the group
+    for (uint8_t i = 0; i < count; ++i) {
+      if (!(members & (1u << i))) {
+        continue;
+      }
+      cmds[i] = QueuedCmd {
+        .mv = Move {.degrees = degrees[i], .end_action = EndAction::HOLD, .move_type = MoveType::FIXED},
+        .id = 0,
+        .rx_us = 0,
+        .submit_us = 0,
+        .stretch_q16 = static_cast<uint32_t>((longest_us << 16) / duration_us[i]),
+        .sync_gen = gen,
+        .start_at_us = 0,
+      };
+      esp_err_t err = axis(i).enqueue(&cmds[i], 1);
+      if (err != ESP_OK) {
+        cancelCoordinated();
+        return err;
+      }
+    }
+    return ESP_OK;
+  }
+
+  // Cancels the group being formed and wakes its armed axes, which stop without a step
+  void Motor::cancelCoordinated() {
+    portENTER_CRITICAL(&sync_lock_);
+    uint8_t arrived = 0;
+    if (sync_.state == SyncState::FORMING) {
+      sync_.state = SyncState::CANCELLED;
+      arrived = sync_.arrived;
+    }
+    portEXIT_CRITICAL(&sync_lock_);
+    for (uint8_t i = 0; i < kAxisCount; ++i) {
+      if (arrived & (1u << i)) {
+        xTaskNotifyGive(axis(i).task_);
+      }
+    }
+  }
+
+  /**
+   * @brief Joins the coordinated move gen once this axis is armed
+   *
+   * The last axis to arrive resumes the paused timers of all of them in one critical section,
+   * then starts the engines that stream their plans. The others wait for it here.
+   * @return Whether the move was released, false when the group got cancelled
+   */
+  bool Motor::awaitRelease(uint32_t gen) {
+    motor_state_.store(MotorState::STARTED, std::memory_order_release);
+    portENTER_CRITICAL(&sync_lock_);
+    if (sync_.generation != gen || sync_.state != SyncState::FORMING) {
+      portEXIT_CRITICAL(&sync_lock_);
+      return false;
+    }
+    sync_.arrived |= 1u << index_;
+    uint8_t members = sync_.members;
+    bool last = sync_.arrived == members;
+    if (last) {
+      for (uint8_t i = 0; i < kAxisCount; ++i) {
+        if (members & (1u << i)) {
+          axis(i).hal_->releaseArmedFromISR();
+          axis(i).released_gen_.store(gen, std::memory_order_release);
+        }
+      }
+      sync_.state = SyncState::RELEASED;
+    }
+    portEXIT_CRITICAL(&sync_lock_);
+
+    if (last) {
+      for (uint8_t i = 0; i < kAxisCount; ++i) {
+        if (members & (1u << i)) {
+          Motor &m = axis(i);
+          ESP_ERROR_CHECK_WITHOUT_ABORT(m.hal_->releaseArmedPlan());
+          if (&m != this) {
+            xTaskNotifyGive(m.task_);
+          }
+        }
+      }
+      return true;
+    }
+    for (;;) {
+      // Takes one notification at a time: a segment reach right after the release must not be lost
+      ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+      if (released_gen_.load(std::memory_order_acquire) == gen) {
+        return true;
+      }
+      if (stop_requested_.load(std::memory_order_acquire)) {
+        cancelCoordinated();
+        return released_gen_.load(std::memory_order_acquire) == gen;
+      }
+      portENTER_CRITICAL(&sync_lock_);
+      bool cancelled = sync_.generation != gen || sync_.state == SyncState::CANCELLED;
+      portEXIT_CRITICAL(&sync_lock_);
+      if (cancelled) {
+        return false;
+      }
+    }
+  }
+
+  // esp_timer ISR: releases the armed move unless a STOP got to it first
+  void IRAM_ATTR Motor::onStartTimer(void *arg) {
+    Motor *m = static_cast<Motor *>(arg);
+    if (m->releaseArmed()) {
+      BaseType_t hp = pdFALSE;
+      vTaskNotifyGiveFromISR(m->task_, &hp);
+      portYIELD_FROM_ISR(hp);
+    }
+  }
+
+  // @return Whether the armed move was released here, false when a STOP cancelled it first
+  bool IRAM_ATTR Motor::releaseArmed() {
+    StartState armed = StartState::ARMED;
+    if (!start_state_.compare_exchange_strong(armed, StartState::RELEASED, std::memory_order_acq_rel)) {
+      return false;
+    }
+    hal_->releaseArmedFromISR();
+    return true;
+  }
+
+  /**
+   * @brief Waits for the scheduled start of the armed move, then starts the engines the timer cannot
+   * @return Whether the move was released, false when a STOP cancelled it
+   */
+  bool Motor::awaitStart(int64_t at_us) {
+    motor_state_.store(MotorState::STARTED, std::memory_order_release);
+    start_state_.store(StartState::ARMED, std::memory_order_release);
+    int64_t wait_us = at_us - esp_timer_get_time();
+    if (wait_us > 0) {
+      ESP_ERROR_CHECK(esp_timer_start_once(start_timer_, wait_us));
+    } else {
+      ESP_LOGW(TAG, "Scheduled start %" PRIi64 " us late", -wait_us);
+      if (releaseArmed()) {
+        xTaskNotifyGive(task_);
+      }
+    }
+    for (;;) {
+      // Takes one notification at a time: a segment reach right after the release must not be lost
+      ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+      if (start_state_.load(std::memory_order_acquire) == StartState::RELEASED) {
+        break;
+      }
+      StartState armed = StartState::ARMED;
+      if (
+        stop_requested_.load(std::memory_order_acquire)
+        && start_state_.compare_exchange_strong(armed, StartState::CANCELLED, std::memory_order_acq_rel)
+      ) {
+        esp_timer_stop(start_timer_);
+        return false;
+      }
+    }
+    ESP_ERROR_CHECK_WITHOUT_ABORT(hal_->releaseArmedPlan());
+    hal_->latency().record(LatencyStage::SCHEDULE_LATE, hal_->pulseStartUs() - at_us);
+    return true;
+  }
+
   void Motor::taskTrampoline(void *arg) { static_cast<Motor *>(arg)->taskLoop(); }
 
+  // Signed steps of a FIXED move at factor, the one it switches to when it carries its own
+  static int32_t stepsOf(const Move &mv, uint16_t factor) {
+    return mv.step_factor ? mv.steps : RampedMove::stepsFor(mv.degrees, factor);
+  }
+
+  /**
+   * @brief Lookahead: merge the queued FIXED moves that continue c in the same direction
+   *
+   * A follower blends in when it has no delay_ms, so the motor runs through the joint at cruise
+   * speed instead of ramping down to a stop and up again. The merged move ends with the end action
+   * of the last blended move and takes its id. Only consecutive ids blend, so that the completion
+   * record covers a range of them: submitters racing each other can interleave their ids in the queue.
+   * @return Signed step count of the merged move at factor
+   */
+  int32_t Motor::blendQueued(QueuedCmd &c, uint16_t factor) {
+    int32_t steps = stepsOf(c.mv, factor);
+    int blended = 1;
+    QueuedCmd next;
+    while (cmd_q_.peek(next)) {
+      int32_t nextSteps = stepsOf(next.mv, factor);
+      if ( //
+        next.mv.move_type != MoveType::FIXED || 
+        (next.mv.step_factor && next.mv.step_factor != factor) || 
+        next.sync_gen || 
+        next.start_at_us || 
+        next.mv.delay_ms || 
+        next.id != c.id + 1 || 
+        (nextSteps > 0) != (steps > 0) || 
+        nextSteps == 0 || 
+        std::abs(int64_t(steps) + nextSteps) > kMaxBlendSteps
+      ) {
+        break;
+      }
+      if (!cmd_q_.take()) {
+        break; // Flushed by a STOP in between
+      }
+      steps += nextSteps;
+      c.mv.end_action = next.mv.end_action;
+      c.id = next.id;
+      ++blended;
+    }
+    if (blended > 1) {
+      ESP_LOGI(TAG, "Blended %d moves into %" PRIi32 " steps", blended, steps);
+    }
+    return steps;
+  }
+
+  // Waits ms, or less when a STOP comes in. @return Whether the wait ran to its end
+  bool Motor::dwell(uint32_t ms) {
+    gap_from_us_ = 0;
+    motor_state_.store(MotorState::DELAYED, std::memory_order_release);
+    // Other notifications (jog, submit, a late segment reach) wake the task early, wait out the rest
+    int64_t deadline_us = esp_timer_get_time() + static_cast<int64_t>(ms) * 1000;
+    for (;;) {
+      if (stop_requested_.load(std::memory_order_acquire)) {
+        return false;
+      }
+      int64_t left_us = deadline_us - esp_timer_get_time();
+      if (left_us <= 0) {
+        return true;
+      }
+      int64_t tick_us = static_cast<int64_t>(portTICK_PERIOD_MS) * 1000;
+      int64_t ticks = std::clamp<int64_t>((left_us + tick_us - 1) / tick_us, 1, portMAX_DELAY - 1);
+      ulTaskNotifyTake(pdTRUE, static_cast<TickType_t>(ticks));
+    }
+  }
+
+  /**
+   * @brief Pipeline stage: takes the FIXED move at the head of the queue, blends it like runMove
+   * would and plans it, so the move starts as soon as the current one ends
+   *
+   * Moves queued after this point no longer blend into it. Scheduled and coordinated moves are left
+   * in the queue, they set up on their own.
+   */
+  void Motor::prepareNext() {
+    QueuedCmd next;
+    if (
+      staged_.valid || !cmd_q_.peek(next) || next.mv.move_type != MoveType::FIXED || next.sync_gen
+      || next.start_at_us || !cmd_q_.take()
+    ) {
+      return;
+    }
+    uint16_t factor = next.mv.step_factor ? next.mv.step_factor : motor_config_.stepMode.getFactor();
+    MotorCmdId first_id = next.id;
+    int32_t steps = blendQueued(next, factor);
+    staged_ = StagedMove {.valid = true, .cmd = next, .first_id = first_id, .steps = steps, .factor = factor};
+    if (steps && !hal_->preparePlan(steps, factor)) {
+      ESP_LOGW(TAG, "Queued move of %" PRIi32 " steps has no segments", steps);
+    }
+  }
+
+  /**
+   * @brief Runs one FIXED, FREE or GOTO move to its end
+   * @param blend Whether FIXED moves merge with the queued ones that continue them, and the move
+   * queued behind gets planned while this one runs
+   * @param staged The prepareNext stage c comes from, already blended and planned
+   */
+  esp_err_t Motor::runMove(QueuedCmd &c, bool blend, const StagedMove *staged) {
+    // -- switching to the step factor the move is given in, it stays in effect
+    if (c.mv.step_factor && c.mv.step_factor != motor_config_.stepMode.getFactor()) {
+      setStepFactor(c.mv.step_factor);
+      done_.factor = c.mv.step_factor;
+    }
+    // -- resolving the absolute target against the position left by the previous move
+    int32_t steps = 0;
+    if (c.mv.move_type == MoveType::GOTO) {
+      if (!hal_->positionKnown()) {
+        ESP_LOGE(TAG, "GOTO %" PRIi32 " degrees without a known position", c.mv.degrees);
+        return ESP_ERR_INVALID_STATE;
+      }
+      steps = c.mv.step_factor
+                ? hal_->stepsToPosition(int64_t(c.mv.steps) * (POSITION_UNITS_PER_STEP / c.mv.step_factor))
+                : hal_->stepsTo(c.mv.degrees);
+      if (!steps) {
+        return ESP_OK; // Already there
+      }
+      c.mv.move_type = MoveType::FIXED;
+    } else if (c.mv.move_type == MoveType::FIXED) {
+      uint16_t factor = motor_config_.stepMode.getFactor();
+      if (staged) {
+        // The factor only differs when it was set between the stages, the power of 2 ratio scales it
+        steps = static_cast<int32_t>(int64_t(staged->steps) * factor / staged->factor);
+      } else {
+        // Coordinated and scheduled moves keep their own length
+        steps = blend && !c.sync_gen && !c.start_at_us ? blendQueued(c, factor) : stepsOf(c.mv, factor);
+      }
+      if (!steps) {
+        return ESP_OK; // Only its delay to run
+      }
+    }
+    // -- starting the move by sending details to HAL, a late STOP notification must not end it
+    ulTaskNotifyTake(pdTRUE, 0);
+    if (stop_requested_.load(std::memory_order_acquire)) {
+      done_.end = MoveEnd::EMERGENCY;
+      return ESP_OK;
+    }
+    bool armed = c.sync_gen || (c.start_at_us && c.mv.move_type == MoveType::FIXED);
+    esp_err_t err = hal_->startMove(c.mv, c.id, steps, c.stretch_q16, armed);
+    if (err != ESP_OK && c.sync_gen) {
+      cancelCoordinated();
+    }
+    ESP_RETURN_ON_ERROR(err, Motor::TAG, "startMove failed");
+    if (c.sync_gen ? !awaitRelease(c.sync_gen) : armed && !awaitStart(c.start_at_us)) {
+      ESP_LOGW(TAG, "Armed move cancelled");
+      last_end_.store(MoveEnd::EMERGENCY, std::memory_order_relaxed);
+      done_.end = MoveEnd::EMERGENCY;
+      return hal_->stopMove();
+    }
+    if (c.rx_us) {
+      hal_->latency().record(LatencyStage::RX_TO_PULSE, hal_->pulseStartUs() - c.rx_us);
+    }
+    if (gap_from_us_ && !armed && c.submit_us <= gap_from_us_) {
+      // Waiting since before the previous move stopped: the whole gap is setup
+      hal_->latency().record(LatencyStage::DEAD_TIME, hal_->pulseStartUs() - gap_from_us_);
+    }
+    // -- wait for the end of current move
+    motor_state_.store(MotorState::STARTED, std::memory_order_release);
+    // The task only wakes up at the end unless it switches the segments itself
+    if (
+      blend
+      && (c.mv.move_type != MoveType::FIXED || motor_config_.segmentSwitch == SegmentSwitch::ISR
+          || hal_->backend().runsPlans())
+    ) {
+      prepareNext();
+    }
+    MoveEnd end = MoveEnd::COMPLETED;
+    for (;;) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      if (stop_requested_.load(std::memory_order_acquire)) {
+        if (stop_mode_.load(std::memory_order_relaxed) == StopMode::EMERGENCY) {
+          end = MoveEnd::EMERGENCY;
+          break;
+        }
+        if (end != MoveEnd::DECELERATED) {
+          // The ramp-down runs like the rest of a plan, an engine that cannot do it stops at once
+          end = MoveEnd::DECELERATED;
+          bool stopped = true;
+          if (hal_->decelerate(stopped) != ESP_OK || stopped) {
+            break;
+          }
+          continue;
+        }
+      }
+      if (c.mv.move_type != MoveType::FIXED || hal_->nextSegment()) {
+        break;
+      }
+    }
+    ESP_LOGW(TAG, "Done");
+    if (c.mv.move_type == MoveType::FIXED) {
+      last_end_.store(end, std::memory_order_relaxed);
+    }
+    esp_err_t ret = hal_->stopMove();
+    gap_from_us_ = hal_->pulseStopUs();
+    // Steps add up over the moves of a program, unknown once any of them is
+    uint32_t ran = c.mv.move_type == MoveType::FIXED ? hal_->lastMoveSteps() : UINT32_MAX;
+    done_.steps = ran == UINT32_MAX || done_.steps == UINT32_MAX ? UINT32_MAX : done_.steps + ran;
+    done_.end = end;
+    return ret;
+  }
+
+  /**
+   * @brief Runs a JOG move until its target goes to 0 or a STOP
+   *
+   * The task only wakes up for new targets and when the ISR has ramped down to a stop, where it
+   * either ends the jog or restarts it the other way. A DECELERATE stop is a zero target.
+   */
+  esp_err_t Motor::runJog(QueuedCmd &c) {
+    portENTER_CRITICAL(&jog_lock_);
+    int32_t velocity = jog_velocity_;
+    jog_state_ = velocity ? JogState::RUNNING : JogState::OFF;
+    portEXIT_CRITICAL(&jog_lock_);
+    if (!velocity) {
+      return ESP_OK; // Set back to 0 before it started
+    }
+    ulTaskNotifyTake(pdTRUE, 0);
+    bool stopped = stop_requested_.load(std::memory_order_acquire);
+    esp_err_t ret = ESP_OK;
+    if (!stopped) {
+      c.mv.degrees = velocity > 0 ? +1 : -1;
+      ret = hal_->startMove(c.mv, c.id);
+    }
+    if (stopped || ret != ESP_OK) {
+      portENTER_CRITICAL(&jog_lock_);
+      jog_state_ = JogState::OFF;
+      portEXIT_CRITICAL(&jog_lock_);
+      done_.end = MoveEnd::EMERGENCY;
+      ESP_RETURN_ON_ERROR(ret, Motor::TAG, "startMove failed");
+      return ESP_OK;
+    }
+    hal_->setJogTarget(velocity);
+    motor_state_.store(MotorState::STARTED, std::memory_order_release);
+    MoveEnd end = MoveEnd::COMPLETED;
+    for (;;) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      bool emergency = false;
+      if (stop_requested_.exchange(false, std::memory_order_acq_rel)) {
+        emergency = stop_mode_.load(std::memory_order_relaxed) == StopMode::EMERGENCY;
+        end = emergency ? MoveEnd::EMERGENCY : MoveEnd::DECELERATED;
+      }
+      portENTER_CRITICAL(&jog_lock_);
+      if (end != MoveEnd::COMPLETED) {
+        jog_velocity_ = 0;
+      }
+      velocity = jog_velocity_;
+      bool over = emergency || (!velocity && hal_->jogStopped());
+      if (over) {
+        jog_state_ = JogState::OFF;
+      }
+      portEXIT_CRITICAL(&jog_lock_);
+      if (over) {
+        break;
+      }
+      if (hal_->jogStopped()) {
+        ret = hal_->restartJog(velocity > 0 ? +1 : -1);
+        if (ret != ESP_OK) {
+          portENTER_CRITICAL(&jog_lock_);
+          jog_state_ = JogState::OFF;
+          portEXIT_CRITICAL(&jog_lock_);
+          break;
+        }
+      }
+      hal_->setJogTarget(velocity);
+    }
+    done_.end = end;
+    done_.steps = UINT32_MAX;
+    esp_err_t stop_ret = hal_->stopMove();
+    return ret != ESP_OK ? ret : stop_ret;
+  }
+
+  /**
+   * @brief Runs a HOME move: the fast approach, then the slow touches, each after a back-off
+   *
+   * Every FREE run zeroes the position at the edge it finds, so the position an approach starts
+   * from plus the steps it ran up to the edge tell where the new edge is relative to the previous
+   * one, to the step.
+   */
+  esp_err_t Motor::runHome(QueuedCmd &c) {
+    HomingCfg cfg = getHoming();
+    int32_t dir = c.mv.degrees > 0 ? +1 : -1;
+    HomingReport report {
+      .fast_error = 0, .min_deviation = 0, .max_deviation = 0, .samples = 0, .end = MoveEnd::COMPLETED, .homed = false
+    };
+    portENTER_CRITICAL(&homing_lock_);
+    homing_report_ = report;
+    portEXIT_CRITICAL(&homing_lock_);
+    if (hal_->backend().runsPlans()) {
+      ESP_LOGE(TAG, "Homing needs the step counter");
+      return ESP_ERR_NOT_SUPPORTED;
+    }
+    const FreeRunCfg fast {.velocity = cfg.fast_velocity, .acceleration = cfg.acceleration};
+    const FreeRunCfg slow {.velocity = cfg.slow_velocity, .acceleration = cfg.acceleration};
+    QueuedCmd approach = c;
+    approach.mv = Move {.degrees = dir, .end_action = EndAction::HOLD, .move_type = MoveType::FREE};
+    QueuedCmd backoff = c;
+    backoff.mv = Move {.degrees = -dir * cfg.backoff_degrees, .end_action = EndAction::HOLD, .move_type = MoveType::FIXED};
+    esp_err_t ret = ESP_OK;
+    int32_t edge = 0; // Last slow edge relative to the first one
+    for (uint16_t touch = 0; touch <= cfg.touches; ++touch) {
+      int32_t from = hal_->position();
+      hal_->overrideFreeRun(touch ? &slow : &fast);
+      ret = runMove(approach, false);
+      hal_->overrideFreeRun(nullptr);
+      if (ret != ESP_OK || done_.end != MoveEnd::COMPLETED || !hal_->positionKnown()) {
+        break;
+      }
+      if (touch) {
+        // The new edge, in the frame zeroed at the previous one
+        int32_t run = static_cast<int32_t>(hal_->freeRunEdgeSteps()) * (POSITION_UNITS_PER_STEP / hal_->lastMoveFactor());
+        int32_t shift = from + dir * run;
+        if (touch == 1) {
+          report.fast_error = -shift;
+        } else {
+          edge += shift;
+          report.min_deviation = std::min(report.min_deviation, edge);
+          report.max_deviation = std::max(report.max_deviation, edge);
+        }
+        ++report.samples;
+        ESP_LOGI(TAG, "Homing touch %u: edge shifted %" PRIi32 " units", touch, shift);
+      }
+      ret = runMove(backoff, false);
+      if (ret != ESP_OK || done_.end != MoveEnd::COMPLETED) {
+        break;
+      }
+    }
+    report.end = ret != ESP_OK ? MoveEnd::FAILED : done_.end;
+    report.homed = report.samples == cfg.touches && report.end == MoveEnd::COMPLETED;
+    if (report.homed) {
+      ESP_LOGI(
+        TAG, "Homed: fast error %" PRIi32 ", spread %" PRIi32 " units", report.fast_error,
+        report.max_deviation - report.min_deviation
+      );
+    }
+    portENTER_CRITICAL(&homing_lock_);
+    homing_report_ = report;
+    portEXIT_CRITICAL(&homing_lock_);
+    return ret;
+  }
+
+  /**
+   * @brief Runs the stored program c.mv.degrees to its end or to a STOP
+   *
+   * Moves submitted meanwhile wait in the queue until the program is over.
+   */
+  esp_err_t Motor::runProgram(const QueuedCmd &c) {
+    uint8_t id = static_cast<uint8_t>(c.mv.degrees);
+    ESP_RETURN_ON_ERROR(ProgramStore::load(id, program_), Motor::TAG, "Program %u load failed", id);
+    running_program_.store(id, std::memory_order_relaxed);
+    ESP_LOGI(TAG, "Running program %u", id);
+    esp_err_t ret = ESP_OK;
+    ProgramInstr instr;
+    while (ret == ESP_OK && !stop_requested_.load(std::memory_order_acquire) && program_.next(instr)) {
+      int32_t position = hal_->position();
+      switch (instr.op) {
+        case ProgramOp::MOVE:
+        case ProgramOp::GOTO: {
+          QueuedCmd move {
+            .mv = Move {
+              .degrees = instr.arg,
+              .end_action = instr.flags & PROGRAM_FLAG_HOLD ? EndAction::HOLD : EndAction::COAST,
+              .move_type = instr.op == ProgramOp::GOTO ? MoveType::GOTO : MoveType::FIXED,
+            },
+            .id = c.id,
+            .rx_us = 0,
+            .submit_us = 0,
+            .stretch_q16 = 0,
+            .sync_gen = 0,
+            .start_at_us = 0,
+          };
+          ret = runMove(move, false);
+          // A GOTO where the motor already is, or a move rounded to no steps, makes no progress
+          if (hal_->position() != position) {
+            program_.progressed();
+          }
+          break;
+        }
+        case ProgramOp::DWELL:
+          if (dwell(static_cast<uint16_t>(instr.arg))) {
+            program_.progressed();
+          }
+          break;
+        case ProgramOp::HOLD:
+        case ProgramOp::RELEASE:
+          ret = hal_->holdOrRelease(instr.op == ProgramOp::HOLD);
+          break;
+        default:
+          break;
+      }
+    }
+    running_program_.store(NO_PROGRAM, std::memory_order_relaxed);
+    if (stop_requested_.load(std::memory_order_acquire) && done_.end == MoveEnd::COMPLETED) {
+      done_.end = MoveEnd::EMERGENCY; // Stopped between moves
+    }
+    return ret;
+  }
+
+  // Publishes the record of c, whose id is the last of the moves blended into it
+  void Motor::complete(const QueuedCmd &c, int64_t start_us) {
+    done_.id = c.id;
+    done_.duration_us = static_cast<uint32_t>(esp_timer_get_time() - start_us);
+    if (!done_q_.push(&done_, 1)) {
+      done_dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+    last_done_id_.store(c.id, std::memory_order_relaxed);
+  }
+
   void Motor::taskLoop() {
     for (;;) {
       motor_state_.store(MotorState::IDLE, std::memory_order_release);
       QueuedCmd c;
-      // -- waiting for new move submission
-      if (xQueueReceive(cmd_q_, &c, portMAX_DELAY) != pdTRUE) {
+      // -- taking the move prepareNext staged, or waiting for new move submission
+      StagedMove staged = staged_;
+      staged_.valid = false;
+      if (staged.valid) {
+        c = staged.cmd;
+      } else if (!cmd_q_.pop(c)) {
+        xSemaphoreTake(cmd_ready_, portMAX_DELAY);
+        continue;
+      }
+      // A STOP raised from here on ends this command; one raised since the dequeue flushed it already
+      stop_requested_.exchange(false, std::memory_order_acq_rel);
+      if (static_cast<int32_t>(c.id - flushed_through_.load(std::memory_order_acquire)) <= 0) {
         continue;
       }
+      int64_t start_us = esp_timer_get_time();
+      hal_->latency().record(LatencyStage::QUEUE_WAIT, start_us - c.submit_us);
       ESP_LOGI(TAG, "Processing %s move type", moveTypeToName(c.mv.move_type));
-      // -- optional pre-move delay
-      if (c.mv.delay_ms) {
-        motor_state_.store(MotorState::DELAYED, std::memory_order_release);
-        vTaskDelay(pdMS_TO_TICKS(c.mv.delay_ms));
+      done_ = MoveCompletion {
+        .id = c.id,
+        .steps = 0,
+        .duration_us = 0,
+        .factor = motor_config_.stepMode.getFactor(),
+        .type = static_cast<uint8_t>(c.mv.move_type),
+        .end = MoveEnd::COMPLETED,
+        // runMove blends the moves behind c later on, the staged ones are blended already
+        .first_id = staged.valid ? staged.first_id : c.id,
+      };
+      // -- optional pre-move delay, a scheduled move wakes up early enough to set up before its start
+      uint32_t delay_ms = c.mv.delay_ms;
+      if (c.start_at_us) {
+        int64_t lead_us = c.start_at_us - kStartLeadUs - start_us;
+        delay_ms = lead_us > 0 ? static_cast<uint32_t>(lead_us / 1000) : 0;
       }
-      // -- starting the move by sending details to HAL
-      if (hal_->startMove(c.mv, c.id) != ESP_OK) {
-        motor_state_.store(MotorState::ERRORED, std::memory_order_release);
+      if (delay_ms && !dwell(delay_ms)) {
+        done_.end = MoveEnd::EMERGENCY;
+        complete(c, start_us);
         continue;
       }
-      // -- wait for the end of current move
-      motor_state_.store(MotorState::STARTED, std::memory_order_release);
-      for (;;) {
-        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
-        if ( //
-          stop_requested_ || 
-          c.mv.move_type != MoveType::FIXED || 
-          hal_->nextSegment()
-        ) {
+      esp_err_t ret = ESP_OK;
+      switch (c.mv.move_type) {
+        case MoveType::PROGRAM:
+          ret = runProgram(c);
+          break;
+        case MoveType::JOG:
+          ret = runJog(c);
+          gap_from_us_ = hal_->pulseStopUs();
+          break;
+        case MoveType::HOME:
+          ret = runHome(c);
+          break;
+        case MoveType::HOLD:
+        case MoveType::RELEASE:
+          ret = hal_->holdOrRelease(c.mv.move_type == MoveType::HOLD);
+          break;
+        case MoveType::DWELL:
+          break; // Its delay was all of it
+        default:
+          ret = runMove(c, true, staged.valid ? &staged : nullptr);
           break;
-        }
       }
-      ESP_LOGW(TAG, "Done");
-      if (hal_->stopMove() != ESP_OK) {
+      if (ret != ESP_OK) {
         motor_state_.store(MotorState::ERRORED, std::memory_order_release);
-      };
+        done_.end = MoveEnd::FAILED;
+      }
+      complete(c, start_us);
     }
   }
 } // namespace motor
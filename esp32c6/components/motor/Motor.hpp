@@ -1,45 +1,213 @@
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <esp_timer.h>
+#include <freertos/semphr.h>
 #include <memory>
+#include <sdkconfig.h>
+#include <utility>
 
+#include "CmdRing.hpp"
 #include "Common.hpp"
+#include "MotionProgram.hpp"
 #include "MotorHal.hpp"
 
 namespace motor {
   struct QueuedCmd {
       Move mv;
       MotorCmdId id;
+      // esp_timer timestamps for the latency histograms, rx_us is 0 when not submitted over I2C
+      int64_t rx_us;
+      int64_t submit_us;
+      // Coordinated move: slowed down by stretch_q16 / 65536 and started with the other axes of sync_gen
+      uint32_t stretch_q16;
+      uint32_t sync_gen;
+      // esp_timer time the first pulse is due at, 0 when the move starts once dequeued
+      int64_t start_at_us;
   };
 
   class Motor {
     public:
-      static Motor &instance() {
-        static Motor s;
-        return s;
-      }
+      static constexpr uint8_t kAxisCount = CONFIG_MOTOR_AXIS_COUNT;
+      // Most moves one submitBatch takes
+      static constexpr size_t kQueueDepth = 64;
+      // Axis 0, the one the Zigbee endpoint drives
+      static Motor &instance() { return axis(0); }
+      static Motor &axis(uint8_t index);
+      /**
+       * @brief Moves every axis by degrees[axis] so they start together and finish together
+       *
+       * Each axis plans its move as usual, then all of them but the longest are slowed down to its
+       * duration. The moves queue behind the ones already submitted: the first axes to dequeue arm
+       * their pulses and wait, the last one releases them all at once. One coordinated move can be
+       * pending at a time (ESP_ERR_INVALID_STATE), a STOP on any axis cancels it.
+       */
+      static esp_err_t submitCoordinated(const int32_t *degrees, size_t count);
+      uint8_t index() const { return index_; }
       esp_err_t init();
+      // Queues mv behind the commands already submitted, HOLD and RELEASE too; a STOP acts at once
       esp_err_t submit(const Move &mv);
+      // Drops the queued moves and ends the running one, a STOP move is an EMERGENCY stop
+      esp_err_t stop(StopMode mode);
+      // How the last FIXED move ended and the steps it ran
+      MoveReport getLastMove();
+      /**
+       * @brief Queues a FIXED or GOTO move whose first pulse goes out at the esp_timer time at_us
+       *
+       * The move is set up ahead of time with its pulses paused and an esp_timer releases them.
+       * A move dequeued after at_us starts at once, late. STOP cancels it while it waits.
+       */
+      esp_err_t submitAt(const Move &mv, int64_t at_us);
+      // Queues all the moves in order or none of them, ESP_ERR_NO_MEM when they do not fit
+      esp_err_t submitBatch(const Move *moves, size_t count);
       esp_err_t resetQueue();
       void setStepFactor(uint16_t factor);
       uint16_t getStepFactor();
+      esp_err_t setKinematics(const Kinematics &kinematics);
+      Kinematics getKinematics() { return motor_config_.kinematics; }
+      esp_err_t setFreeRun(const FreeRunCfg &freeRun);
+      FreeRunCfg getFreeRun() { return motor_config_.freeRun; }
+      // Distance the last ramped FREE run braked past the stopper, in POSITION_UNITS_PER_STEP units
+      int32_t getOvershoot() { return hal_->overshoot(); }
+      PlanCacheStats getPlanCacheStats() { return hal_->planCache().stats(); }
+      void resetPlanCacheStats() { hal_->planCache().resetStats(); }
+      // I2C RX time of the write being handled, attached to the moves it submits
+      void markRx(int64_t rx_us) { rx_us_.store(rx_us, std::memory_order_relaxed); }
+      LatencyStats &latency() { return hal_->latency(); }
+      MotionTrace &trace() { return hal_->trace(); }
+      // Absolute position in POSITION_UNITS_PER_STEP units, zero at the stopper after a FREE run
+      int32_t getPosition() { return hal_->position(); }
+      bool isPositionKnown() { return hal_->positionKnown(); }
+      // Declares the current shaft position, only meaningful while idle
+      void setPosition(int32_t position) { hal_->setPosition(position); }
+      MotorHal &hal() { return *hal_; }
+      // Completion FIFO, a single reader: false when empty
+      bool popCompletion(MoveCompletion &out) { return done_q_.pop(out); }
+      // Records lost to a full FIFO
+      uint16_t droppedCompletions() { return done_dropped_.load(std::memory_order_relaxed); }
+      MotorCmdId lastCompletedId() { return last_done_id_.load(std::memory_order_relaxed); }
+      MotorCmdId lastQueuedId() { return next_id_.load(std::memory_order_relaxed) - 1; }
+      // Ids up to this one were dropped from the queue by a STOP or reset, unless they completed
+      MotorCmdId flushedThroughId() { return flushed_through_.load(std::memory_order_relaxed); }
+      /**
+       * @brief Velocity mode: runs at velocity full steps/s until told otherwise
+       *
+       * The first non-zero velocity queues a JOG move; while it runs, each call only moves its target
+       * and the step rate ramps there segment by segment. 0 ramps down and ends the jog, the opposite
+       * sign ramps down, reverses and ramps up again. Position is kept all along.
+       */
+      esp_err_t jog(int32_t velocity);
+      int32_t getJogVelocity();
+      bool isJogging();
+      /**
+       * @brief Queues a homing run toward the stopper, direction: +1/-1
+       *
+       * A fast approach finds the stopper, then each of HomingCfg::touches slow approaches starts
+       * backoff_degrees off the edge the previous one found. The position is zeroed at the last slow
+       * edge and the motor is left backed off and held. Needs an engine with a step counter.
+       */
+      esp_err_t home(int8_t direction);
+      esp_err_t setHoming(const HomingCfg &cfg);
+      HomingCfg getHoming();
+      // Trigger points measured by the last homing, samples is 0 until one slow edge is found
+      HomingReport getHomingReport();
+      static constexpr uint8_t NO_PROGRAM = 0xFF;
+      // Id of the stored program being run, NO_PROGRAM when none
+      uint8_t runningProgram() { return running_program_.load(std::memory_order_relaxed); }
 
     private:
       static void taskTrampoline(void *arg);
+      uint8_t index_ = 0;
       bool initialized_ = false;
       static constexpr const char *TAG = "Motor";
-      static constexpr int kQueueDepth = 16;
+      static constexpr size_t kDoneDepth = 16;
+      // Longest blended move, the cruise is chained in pieces the step counter can watch
+      static constexpr int64_t kMaxBlendSteps = INT32_MAX / 2;
       std::atomic<MotorState> motor_state_ {MotorState::IDLE};
       void taskLoop();
+      int32_t blendQueued(QueuedCmd &c, uint16_t factor);
+      bool dwell(uint32_t ms);
+      // The next FIXED move, taken off the queue and blended by prepareNext while the current one runs
+      struct StagedMove {
+          bool valid;
+          QueuedCmd cmd; // Under the id of the last blended move
+          MotorCmdId first_id;
+          int32_t steps; // Merged length at factor
+          uint16_t factor;
+      };
+      StagedMove staged_ {};
+      esp_err_t runMove(QueuedCmd &c, bool blend, const StagedMove *staged = nullptr);
+      void prepareNext();
+      // Pulse stop of the last move the task went on from without a pause, 0 after a dwell
+      int64_t gap_from_us_ = 0;
+      esp_err_t runProgram(const QueuedCmd &c);
+      esp_err_t enqueue(const QueuedCmd *batch, size_t count);
+      template <typename F> esp_err_t enqueue(size_t count, F &&make);
+      void flushQueue();
+      // Record of the command being run, filled in by runMove and runProgram
+      MoveCompletion done_ {};
+      void complete(const QueuedCmd &c, int64_t start_us);
+      // Coordinated moves: the group being formed, its armed axes are released together
+      enum class SyncState : uint8_t { IDLE, FORMING, RELEASED, CANCELLED };
+      struct SyncGroup {
+          uint32_t generation;
+          SyncState state;
+          uint8_t members; // Axis bit masks
+          uint8_t arrived;
+      };
+      static inline SyncGroup sync_ {};
+      static inline portMUX_TYPE sync_lock_ = portMUX_INITIALIZER_UNLOCKED;
+      // Generation of the last group that released this axis
+      std::atomic<uint32_t> released_gen_ {0};
+      bool awaitRelease(uint32_t gen);
+      static void cancelCoordinated();
+      // Scheduled start: the esp_timer callback and a STOP race for the armed move
+      enum class StartState : uint8_t { IDLE, ARMED, RELEASED, CANCELLED };
+      static constexpr int64_t kStartLeadUs = 5000; // Setup time allowed before a scheduled start
+      esp_timer_handle_t start_timer_ = nullptr;
+      std::atomic<StartState> start_state_ {StartState::IDLE};
+      static void onStartTimer(void *arg);
+      bool releaseArmed();
+      bool awaitStart(int64_t at_us);
+      // Jog target, shared by the callers of jog() and the motor task
+      enum class JogState : uint8_t { OFF, QUEUED, RUNNING };
+      JogState jog_state_ = JogState::OFF;
+      int32_t jog_velocity_ = 0;
+      portMUX_TYPE jog_lock_ = portMUX_INITIALIZER_UNLOCKED;
+      esp_err_t runJog(QueuedCmd &c);
+      // Homing settings and the report of the last run, under homing_lock_
+      HomingCfg homing_ {
+        .fast_velocity = 400, .slow_velocity = 40, .acceleration = 1600, .backoff_degrees = 90, .touches = 3
+      };
+      HomingReport homing_report_ {};
+      portMUX_TYPE homing_lock_ = portMUX_INITIALIZER_UNLOCKED;
+      esp_err_t runHome(QueuedCmd &c);
+      // Only touched by the motor task
+      MotionProgram program_;
+      std::atomic<uint8_t> running_program_ {NO_PROGRAM};
       std::unique_ptr<MotorHal> hal_;
       MotorCfg motor_config_;
-      QueueHandle_t cmd_q_ = nullptr;
-      QueueHandle_t done_q_ = nullptr;
+      // Submitted by the I2C and Zigbee tasks, consumed by the motor task
+      CmdRing<QueuedCmd, kQueueDepth> cmd_q_;
+      // Given after each submission, the motor task waits on it while the ring is empty
+      SemaphoreHandle_t cmd_ready_ = nullptr;
       TaskHandle_t task_ = nullptr;
-      MotorCmdId next_id_ = 1;
-      bool stop_requested_ = false;
+      std::atomic<MotorCmdId> next_id_ {1};
+      std::atomic<int64_t> rx_us_ {0};
+      std::atomic<bool> stop_requested_ {false};
+      std::atomic<StopMode> stop_mode_ {StopMode::EMERGENCY};
+      std::atomic<MoveEnd> last_end_ {MoveEnd::COMPLETED};
+      // Published by the motor task, read over I2C
+      CmdRing<MoveCompletion, kDoneDepth> done_q_;
+      std::atomic<uint16_t> done_dropped_ {0};
+      std::atomic<MotorCmdId> last_done_id_ {0};
+      std::atomic<MotorCmdId> flushed_through_ {0};
       // Constructor business
-      Motor() = default;
+      template <size_t... I> static std::array<Motor, kAxisCount> makeAxes(std::index_sequence<I...>) {
+        return {Motor(I)...};
+      }
+      explicit Motor(uint8_t index) : index_(index) {}
       Motor(const Motor &) = delete;
       Motor &operator=(const Motor &) = delete;
   };
@@ -0,0 +1,24 @@
+#include <sdkconfig.h>
+
+#include "MotorBackend.hpp"
+#if CONFIG_IDF_TARGET_LINUX
+#include "SimBackend.hpp"
+#else
+#include "LedcPcntBackend.hpp"
+#include "RmtBackend.hpp"
+#endif
+
+namespace motor {
+
+  std::unique_ptr<MotorBackend> MotorBackend::create(MotorCfg &motorConfig) {
+#if CONFIG_IDF_TARGET_LINUX
+    return std::make_unique<SimBackend>(motorConfig);
+#else
+    if (motorConfig.engine == StepEngine::RMT) {
+      return std::make_unique<RmtBackend>(motorConfig);
+    }
+    return std::make_unique<LedcPcntBackend>(motorConfig);
+#endif
+  }
+
+} // namespace motor
@@ -0,0 +1,76 @@
+#pragma once
+#include <memory>
+
+#include "Common.hpp"
+
+namespace motor {
+
+  class MotorHal;
+  class RampedMove;
+
+  /**
+   * @brief Hardware primitives MotorHal sequences moves with
+   *
+   * Covers the TC78H670 control pins, the step pulse generator, the step counter with its watch
+   * points and the stopper switch. Events are reported back through MotorHal::onReachISR and
+   * MotorHal::onStopISR; methods suffixed FromISR are called from those event callbacks. Engines
+   * that run a whole plan (runsPlans) have no step counter and leave the segment methods unused.
+   */
+  class MotorBackend {
+    public:
+      static std::unique_ptr<MotorBackend> create(MotorCfg &motorConfig);
+      virtual ~MotorBackend() = default;
+      virtual esp_err_t init(MotorHal *hal) = 0;
+      // -- Driver control pins
+      virtual esp_err_t latchMode(uint8_t modeBits) = 0;
+      virtual esp_err_t setDirection(bool forward) = 0;
+      virtual esp_err_t setEnable(bool enable) = 0;
+      // -- Step pulse generator
+      virtual esp_err_t startPulses(uint32_t period_us) = 0;
+      virtual esp_err_t pausePulses() = 0;
+      virtual esp_err_t resumePulses() = 0;
+      virtual esp_err_t setPeriod(uint32_t period_us) = 0;
+      virtual esp_err_t stopPulses() = 0;
+      // Coordinated start: pulses are set up paused, several axes are then released at once
+      virtual esp_err_t armPulses(uint32_t) { return ESP_ERR_NOT_SUPPORTED; }
+      virtual void releasePulsesFromISR() {}
+      // New period takes effect at the end of the current pulse, without a gap
+      virtual void setPeriodFromISR(uint32_t period_us) = 0;
+      virtual void pausePulsesFromISR() = 0;
+      // -- Step counter
+      virtual esp_err_t startCounter() = 0;
+      virtual esp_err_t stopCounter() = 0;
+      virtual esp_err_t clearCount() = 0;
+      virtual esp_err_t addWatchPoint(int value) = 0;
+      virtual esp_err_t removeWatchPoint(int value) = 0;
+      // Also called from the stopper ISR
+      virtual esp_err_t getCount(int &count) = 0;
+      virtual void clearCountFromISR() = 0;
+      // -- Stopper switch
+      virtual esp_err_t armStopper() = 0;
+      virtual esp_err_t disarmStopper() = 0;
+      // -- Whole-plan engines run a FIXED move on their own and report its end through onStopISR
+      virtual bool runsPlans() const { return false; }
+      virtual esp_err_t startPlan(const RampedMove &) { return ESP_ERR_NOT_SUPPORTED; }
+
+      /**
+       * @brief FromISR methods as plain function pointers, for the ISRs that must not read flash
+       *
+       * The vtable is in flash. Each counting engine points these at IRAM functions calling its own
+       * methods directly in init(); MotorHal copies them to RAM. Left null by the engines that run
+       * whole plans, which never get these calls.
+       */
+      struct IsrOps {
+          void (*releasePulses)(MotorBackend &);
+          void (*setPeriod)(MotorBackend &, uint32_t period_us);
+          void (*pausePulses)(MotorBackend &);
+          esp_err_t (*getCount)(MotorBackend &, int &count);
+          void (*clearCount)(MotorBackend &);
+      };
+      const IsrOps &isrOps() const { return isr_ops_; }
+
+    protected:
+      IsrOps isr_ops_ {};
+  };
+
+} // namespace motor
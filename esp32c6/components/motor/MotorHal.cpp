@@ -1,419 +1,769 @@
+#include <algorithm>
+#include <cinttypes>
 #include <cstdlib>
-#include <driver/gpio.h>
-#include <driver/pulse_cnt.h>
+#include <esp_attr.h>
 #include <esp_check.h>
 #include <esp_err.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 
 #include "MotorHal.hpp"
-#include "RampedMove.hpp"
-#include "hal/ledc_types.h"
 
 namespace motor {
 
-  static bool IRAM_ATTR
-  pcnt_on_reach_cb(pcnt_unit_handle_t pcnt, const pcnt_watch_event_data_t *ed, void *ctx) {
-    MotorHal *self = reinterpret_cast<MotorHal *>(ctx);
-    self->onStopISR();
-    return false;
-  }
-
-  static void IRAM_ATTR gpio_stopper_cb(void *ctx) {
-    MotorHal *self = reinterpret_cast<MotorHal *>(ctx);
-    self->onStopISR();
-  }
-
-  MotorHal::MotorHal(MotorCfg &motorConfig) : motor_cfg_(motorConfig) {};
+  MotorHal::MotorHal(MotorCfg &motorConfig, std::unique_ptr<MotorBackend> backend)
+    : motor_cfg_(motorConfig), backend_(backend ? std::move(backend) : MotorBackend::create(motorConfig)) {};
 
   esp_err_t MotorHal::init() {
-    ESP_RETURN_ON_ERROR(initGPIO(), MotorHal::TAG, "GPIO initialization failed");
-    ESP_RETURN_ON_ERROR(initStopper(), MotorHal::TAG, "Stopper initialization failed");
-    ESP_RETURN_ON_ERROR(initPCNT(), MotorHal::TAG, "PCNT initialization failed");
+    ESP_RETURN_ON_ERROR(backend_->init(this), MotorHal::TAG, "Backend initialization failed");
+    // Kept in RAM for the ISRs, the backend's vtable is in flash
+    runs_plans_ = backend_->runsPlans();
+    isr_ops_ = backend_->isrOps();
     return ESP_OK;
   }
 
-  esp_err_t MotorHal::initStopper() {
-    // -- GPIO config
-    gpio_config_t io = {
-      .pin_bit_mask = 1ULL << motor_cfg_.pins.stop,
-      .mode = GPIO_MODE_INPUT,
-      .pull_up_en = GPIO_PULLUP_ENABLE,
-      .pull_down_en = GPIO_PULLDOWN_DISABLE,
-      .intr_type = GPIO_INTR_NEGEDGE
-    };
-    ESP_RETURN_ON_ERROR(
-      gpio_config(&io), //
-      MotorHal::TAG, //
-      "gpio_config failed" //
-    );
-    // De-glitcher
-    gpio_pin_glitch_filter_config_t stopper_filter_cfg = {
-      .clk_src = GLITCH_FILTER_CLK_SRC_DEFAULT,
-      .gpio_num = motor_cfg_.pins.stop,
-    };
+  esp_err_t MotorHal::setupCounter() {
     ESP_RETURN_ON_ERROR(
-      gpio_new_pin_glitch_filter(&stopper_filter_cfg, &stopper_filter_),
+      backend_->clearCount(), //
       MotorHal::TAG, //
-      "gpio_new_glitch_filter failed" //
+      "clearCount failed"
     );
     ESP_RETURN_ON_ERROR(
-      gpio_glitch_filter_enable(stopper_filter_),
+      backend_->startCounter(), //
       MotorHal::TAG, //
-      "gpio_glitch_filter_enable failed" //
-    );
-    // -- ISR
-    ESP_RETURN_ON_ERROR(
-      gpio_install_isr_service(ESP_INTR_FLAG_IRAM), //
-      MotorHal::TAG, //
-      "gpio_install_isr_service failed" //
+      "startCounter failed"
     );
     return ESP_OK;
   }
 
-  esp_err_t MotorHal::initGPIO() {
-    auto &pins = motor_cfg_.pins;
-
-    // Configure STBY, EN, M0, M1, M2, M3 as pure outputs
-    // M2 will be reconfigured to INPUT_OUTPUT after mode setup
-    gpio_config_t io = {
-      .pin_bit_mask = (1ULL << pins.stby) | (1ULL << pins.en) | (1ULL << pins.m0) | (1ULL << pins.m1)
-                      | (1ULL << pins.m2) | (1ULL << pins.m3),
-      .mode = GPIO_MODE_OUTPUT,
-      .pull_up_en = GPIO_PULLUP_DISABLE,
-      .pull_down_en = GPIO_PULLDOWN_DISABLE,
-      .intr_type = GPIO_INTR_DISABLE
-    };
-
-    ESP_RETURN_ON_ERROR(
-      gpio_config(&io), //
-      MotorHal::TAG, //
-      "gpio_config failed" //
-    );
-
-    return ESP_OK;
-  }
-
-  esp_err_t MotorHal::initPCNT() {
-    // -- Unit
-    pcnt_unit_config_t pcnt_unit_cfg = {};
-    pcnt_unit_cfg.low_limit = -1;
-    pcnt_unit_cfg.high_limit = INT16_MAX;
-    ESP_RETURN_ON_ERROR(pcnt_new_unit(&pcnt_unit_cfg, &pcnt_unit_), MotorHal::TAG, "pcnt_new_unit failed");
-    // -- Channel
-    pcnt_chan_config_t pcnt_chan_cfg = {};
-    pcnt_chan_cfg.edge_gpio_num = motor_cfg_.pins.m2;
-    pcnt_chan_cfg.level_gpio_num = -1;
-    ESP_RETURN_ON_ERROR(
-      pcnt_new_channel(pcnt_unit_, &pcnt_chan_cfg, &pcnt_channel_), //
-      MotorHal::TAG, //
-      "pcnt_new_channel failed"
-    );
-    ESP_RETURN_ON_ERROR(
-      pcnt_channel_set_edge_action(
-        pcnt_channel_, PCNT_CHANNEL_EDGE_ACTION_INCREASE, PCNT_CHANNEL_EDGE_ACTION_HOLD
-      ), //
-      MotorHal::TAG, //
-      "pcnt_channel_set_edge_action"
-    );
-    pcnt_event_callbacks_t cbs {.on_reach = pcnt_on_reach_cb};
-    ESP_RETURN_ON_ERROR(
-      pcnt_unit_register_event_callbacks(pcnt_unit_, &cbs, this), //
+  esp_err_t MotorHal::addWatchPoint(int steps) {
+    int value = std::abs(steps);
+    for (uint8_t i = 0; i < watch_point_count_; ++i) {
+      if (watch_points_[i] == value) {
+        return ESP_OK;
+      }
+    }
+    ESP_RETURN_ON_FALSE(
+      watch_point_count_ < watch_points_.size(), //
+      ESP_ERR_NO_MEM, //
       MotorHal::TAG, //
-      "pcnt_unit_register_event_callbacks failed"
+      "No free watch point"
     );
     ESP_RETURN_ON_ERROR(
-      pcnt_unit_enable(pcnt_unit_), //
+      backend_->addWatchPoint(value), //
       MotorHal::TAG, //
-      "pcnt_unit_enable failed"
+      "addWatchPoint failed"
     );
+    watch_points_[watch_point_count_++] = value;
     return ESP_OK;
   }
 
-  esp_err_t MotorHal::setupDirection(int32_t degrees) {
-    uint8_t direction = (degrees >= 0) ? 1 : 0;
-    ESP_RETURN_ON_ERROR(
-      gpio_set_level(motor_cfg_.pins.m3, direction), //
-      MotorHal::TAG, //
-      "gpio_set_level"
-    );
+  // Watch points are left armed between moves, only the ones the next move does not use are replaced
+  esp_err_t MotorHal::syncWatchPoints(int first, int second, int third) {
+    first = std::abs(first);
+    second = std::abs(second);
+    third = std::abs(third);
+    for (uint8_t i = watch_point_count_; i-- > 0;) {
+      if (watch_points_[i] == first || watch_points_[i] == second || watch_points_[i] == third) {
+        setup_stats_.watchPointsKept++;
+        continue;
+      }
+      ESP_RETURN_ON_ERROR(
+        backend_->removeWatchPoint(watch_points_[i]), //
+        MotorHal::TAG, //
+        "removeWatchPoint failed"
+      );
+      watch_points_[i] = watch_points_[--watch_point_count_];
+    }
+    ESP_RETURN_ON_ERROR(addWatchPoint(first), MotorHal::TAG, "addWatchPoint failed");
+    if (second) {
+      ESP_RETURN_ON_ERROR(addWatchPoint(second), MotorHal::TAG, "addWatchPoint failed");
+    }
+    if (third) {
+      ESP_RETURN_ON_ERROR(addWatchPoint(third), MotorHal::TAG, "addWatchPoint failed");
+    }
     return ESP_OK;
   }
 
-  esp_err_t MotorHal::setupPCNT(int steps) {
-    ESP_RETURN_ON_ERROR(
-      pcnt_unit_clear_count(pcnt_unit_), //
-      MotorHal::TAG, //
-      "pcnt_unit_clear_count failed"
-    );
-    ESP_RETURN_ON_ERROR(
-      pcnt_unit_add_watch_point(pcnt_unit_, std::abs(steps)), //
-      MotorHal::TAG, //
-      "pcnt_unit_add_watch_point failed"
-    );
-    ESP_RETURN_ON_ERROR(
-      pcnt_unit_start(pcnt_unit_), //
+  esp_err_t MotorHal::startMove(Move &mv, MotorCmdId, int32_t steps, uint32_t stretch_q16, bool armed) {
+    int64_t start_us = esp_timer_get_time();
+    uint16_t factor = motor_cfg_.stepMode.getFactor();
+    ESP_RETURN_ON_FALSE(
+      mv.move_type != MoveType::JOG || !backend_->runsPlans(), //
+      ESP_ERR_NOT_SUPPORTED, //
       MotorHal::TAG, //
-      "pcnt_unit_start failed"
+      "Jog needs a step counter"
     );
-    return ESP_OK;
-  }
 
-  esp_err_t MotorHal::setupLEDC(uint32_t period_us) {
-    if (period_us == 0) {
-      return ESP_ERR_INVALID_ARG;
+    bool prepared = false;
+    if (mv.move_type == MoveType::FIXED) {
+      // Segments are pulled lazily from the plan, repeated and prepared moves skip planning altogether
+      prepared = prepared_.valid && prepared_.steps == steps && prepared_.factor == factor
+                 && prepared_.kinematics == motor_cfg_.kinematics;
+      if (prepared) {
+        plan_ = prepared_.plan;
+        setup_stats_.plansPrepared++;
+      } else {
+        plan_ = plan_cache_.get(steps, factor, motor_cfg_.kinematics);
+      }
+      prepared_.valid = false;
+      if (stretch_q16 > 0x10000) {
+        plan_ = plan_.stretched(stretch_q16);
+      }
+      ESP_RETURN_ON_FALSE(
+        plan_.next(segment_), //
+        ESP_ERR_INVALID_ARG, //
+        MotorHal::TAG, //
+        "Move of %" PRIi32 " steps has no segments", steps
+      );
+    }
+    last_move_ = mv;
+    move_factor_ = factor;
+    completed_steps_ = 0;
+    plan_finished_ = false;
+    stopper_hit_ = false;
+    armed_ = armed && mv.move_type == MoveType::FIXED;
+
+    // 1. Setup step mode (configures M3:M0 and STBY sequence), only when it differs from the latched one
+    uint8_t modeBits = prepared ? prepared_.modeBits
+                                : static_cast<uint8_t>(motor_cfg_.stepMode.getModeBits());
+    if (modeBits != latched_mode_) {
+      latched_mode_ = kNoMode;
+      ESP_RETURN_ON_ERROR(
+        backend_->latchMode(modeBits), //
+        MotorHal::TAG, //
+        "latchMode failed"
+      );
+      latched_mode_ = modeBits;
+      direction_ = 0; // M3 holds a mode bit until it is driven as DIR again
+      setup_stats_.latches++;
+    } else {
+      setup_stats_.latchesSkipped++;
     }
 
-    const uint32_t freq_hz = 1000000UL / period_us;
-
-    // Configure LEDC timer
-    ledc_timer_config_t ledc_timer_cfg = {};
-    ledc_timer_cfg.speed_mode = ledc_mode_;
-    ledc_timer_cfg.duty_resolution = LEDC_TIMER_14_BIT;
-    ledc_timer_cfg.timer_num = ledc_timer_;
-    ledc_timer_cfg.freq_hz = freq_hz;
-    ledc_timer_cfg.clk_cfg = LEDC_AUTO_CLK;
-
-    ESP_RETURN_ON_ERROR(
-      ledc_timer_config(&ledc_timer_cfg), //
-      MotorHal::TAG, //
-      "LEDC timer config failed"
-    );
-
-    // Configure LEDC channel on M2 (STEP pin)
-    ledc_channel_config_t ledc_chan_cfg = {};
-    ledc_chan_cfg.gpio_num = motor_cfg_.pins.m2;
-    ledc_chan_cfg.speed_mode = ledc_mode_;
-    ledc_chan_cfg.channel = ledc_channel_;
-    ledc_chan_cfg.timer_sel = ledc_timer_;
-    ledc_chan_cfg.duty = 0;
-    ledc_chan_cfg.hpoint = 0;
-
-    ESP_RETURN_ON_ERROR(
-      ledc_channel_config(&ledc_chan_cfg), //
-      MotorHal::TAG, //
-      "LEDC channel config failed"
-    );
-
-    // Set duty cycle to 12.5%
-    const uint32_t duty = 1U << (ledc_timer_cfg.duty_resolution - 3);
-    ESP_ERROR_CHECK(ledc_set_duty(ledc_mode_, ledc_channel_, duty));
-    ESP_ERROR_CHECK(ledc_update_duty(ledc_mode_, ledc_channel_));
-
-    return ESP_OK;
-  }
-
-  esp_err_t MotorHal::setupMode() {
-    auto &pins = motor_cfg_.pins;
+    // 2. Setup direction (M3 is now used as DIR after mode is latched)
+    int8_t direction = prepared ? prepared_.direction
+                                : (mv.move_type == MoveType::FIXED ? steps : mv.degrees) >= 0 ? +1 : -1;
+    if (direction != direction_) {
+      ESP_RETURN_ON_ERROR(
+        backend_->setDirection(direction > 0), //
+        MotorHal::TAG, //
+        "setDirection failed"
+      );
+      direction_ = direction;
+    } else {
+      setup_stats_.directionSkipped++;
+    }
 
-    // Reconfigure M2 to pure output mode for mode configuration
-    gpio_config_t m2_io = {
-      .pin_bit_mask = (1ULL << pins.m2),
-      .mode = GPIO_MODE_OUTPUT,
-      .pull_up_en = GPIO_PULLUP_DISABLE,
-      .pull_down_en = GPIO_PULLDOWN_DISABLE,
-      .intr_type = GPIO_INTR_DISABLE
-    };
-    ESP_RETURN_ON_ERROR(gpio_config(&m2_io), MotorHal::TAG, "M2 reconfigure to output failed");
+    int64_t setup_us = esp_timer_get_time();
+    latency_.record(LatencyStage::SETUP, setup_us - start_us);
 
-    // Explicitly drive M2 LOW to ensure clean state
-    gpio_set_level(pins.m2, 0);
+    if (mv.move_type == MoveType::FIXED && backend_->runsPlans()) {
+      // 3. The engine streams the whole plan and reports its end, no counter involved
+      if (armed_) {
+        backend_->setEnable(true);
+        return ESP_OK; // Streaming starts on releaseArmedPlan
+      }
+      ESP_RETURN_ON_ERROR(
+        backend_->startPlan(plan_),
+        MotorHal::TAG, //
+        "startPlan failed"
+      );
+    } else if (mv.move_type == MoveType::FIXED) {
+      // 3. Setup step counter before the first pulse goes out
+      if (motor_cfg_.segmentSwitch == SegmentSwitch::ISR) {
+        // Every segment size is watched for the whole move, the ISR ignores the ones not due
+        ESP_RETURN_ON_ERROR(
+          syncWatchPoints(
+            plan_.rampSegmentSteps(), plan_.middleHeadSteps(),
+            plan_.chainedMiddle() ? RampedMove::maxSegmentSteps : 0
+          ), //
+          MotorHal::TAG, //
+          "syncWatchPoints failed"
+        );
+        preloadSegment();
+      } else {
+        ESP_RETURN_ON_ERROR(
+          syncWatchPoints(segment_.steps), //
+          MotorHal::TAG, //
+          "syncWatchPoints failed"
+        );
+      }
+      ESP_RETURN_ON_ERROR(
+        setupCounter(),
+        MotorHal::TAG, //
+        "setupCounter failed"
+      );
 
-    // Put driver in standby with outputs disabled
-    gpio_set_level(pins.stby, 0);
-    gpio_set_level(pins.en, 0);
-    esp_rom_delay_us(200);
+      // 4. Start pulse generation, or set it up paused for releaseArmedFromISR
+      ESP_RETURN_ON_ERROR(
+        armed_ ? backend_->armPulses(segment_.period_us) : backend_->startPulses(segment_.period_us),
+        MotorHal::TAG, //
+        "startPulses failed"
+      );
+    }
 
-    // Prepare MODE pins (Fixed mode) BEFORE releasing STBY
-    const uint8_t stepModeBits = static_cast<uint8_t>(motor_cfg_.stepMode.getModeBits());
-    gpio_set_level(pins.m0, (stepModeBits >> 0) & 1);
-    gpio_set_level(pins.m1, (stepModeBits >> 1) & 1);
-    gpio_set_level(pins.m2, (stepModeBits >> 2) & 1);
-    gpio_set_level(pins.m3, (stepModeBits >> 3) & 1);
+    if (mv.move_type == MoveType::FREE) {
+      // Setup stopper interrupt
+      ESP_RETURN_ON_ERROR(
+        backend_->armStopper(), //
+        MotorHal::TAG, //
+        "armStopper failed"
+      );
 
-    // Delay before STBY edge
-    esp_rom_delay_us(200);
+      // Start pulse generation, ramped when configured and the engine has a step counter
+      const FreeRunCfg &freeRun = free_override_ ? *free_override_ : motor_cfg_.freeRun;
+      free_ramped_ = freeRun.velocity && !backend_->runsPlans();
+      if (free_ramped_) {
+        ESP_RETURN_ON_ERROR(startFreeRun(freeRun, factor), MotorHal::TAG, "startFreeRun failed");
+      } else {
+        ESP_RETURN_ON_ERROR(
+          backend_->startPulses(BASE_PERIOD_US), //
+          MotorHal::TAG, //
+          "startPulses failed"
+        );
+      }
+    }
 
-    // Release Standby => latches control mode per MODE[3:0]
-    gpio_set_level(pins.stby, 1);
+    if (mv.move_type == MoveType::JOG) {
+      ESP_RETURN_ON_ERROR(startJog(factor), MotorHal::TAG, "startJog failed");
+    }
 
-    // Delay after STBY edge
-    esp_rom_delay_us(500);
+    pulse_start_us_ = esp_timer_get_time();
+    latency_.record(LatencyStage::SETUP_TO_PULSE, pulse_start_us_ - setup_us);
+    if (!armed_) {
+      traceStart();
+    }
 
-    // Now reconfigure M2 for dual LEDC output + PCNT input use
-    m2_io.mode = GPIO_MODE_INPUT_OUTPUT;
-    ESP_RETURN_ON_ERROR(gpio_config(&m2_io), MotorHal::TAG, "M2 reconfigure for LEDC/PCNT failed");
+    // 5. Enable motor outputs
+    backend_->setEnable(true);
 
     return ESP_OK;
   }
 
-  esp_err_t MotorHal::setupStopper() {
-    ESP_RETURN_ON_ERROR(
-      gpio_isr_handler_add(motor_cfg_.pins.stop, gpio_stopper_cb, this), //
-      MotorHal::TAG, //
-      "gpio_isr_handler_add failed" //
-    );
+  bool MotorHal::preparePlan(int32_t steps, uint16_t factor) {
+    StepMode mode;
+    mode.setFactor(factor);
+    prepared_ = PreparedPlan {
+      .valid = false,
+      .steps = steps,
+      .factor = factor,
+      .kinematics = motor_cfg_.kinematics,
+      .plan = plan_cache_.get(steps, factor, motor_cfg_.kinematics),
+      .modeBits = static_cast<uint8_t>(mode.getModeBits()),
+      .direction = static_cast<int8_t>(steps >= 0 ? +1 : -1),
+    };
+    prepared_.valid = prepared_.plan.size() > 0;
+    return prepared_.valid;
+  }
+
+  // Starts at the table start rate, holding it until setJogTarget
+  esp_err_t MotorHal::startJog(uint16_t factor) {
+    jog_table_ = RampedMove::rampTable(motor_cfg_.kinematics, factor);
+    jog_index_ = 0;
+    jog_target_.store(jog_table_.period_us[0], std::memory_order_relaxed);
+    jog_stopped_.store(false, std::memory_order_relaxed);
     ESP_RETURN_ON_ERROR(
-      gpio_intr_enable(motor_cfg_.pins.stop), //
+      syncWatchPoints(jog_table_.segmentSteps), //
       MotorHal::TAG, //
-      "gpio_intr_enable failed" //
+      "syncWatchPoints failed"
     );
-    return ESP_OK;
-  }
-
-  esp_err_t MotorHal::startMove(Move &mv, MotorCmdId) {
-    last_move_ = mv;
-
-    // 1. Setup step mode (configures M3:M0 and STBY sequence)
     ESP_RETURN_ON_ERROR(
-      setupMode(), //
+      setupCounter(),
       MotorHal::TAG, //
-      "setupMode failed"
+      "setupCounter failed"
     );
-
-    uint16_t factor = motor_cfg_.stepMode.getFactor();
-
-    // 2. Setup direction (M3 is now used as DIR after mode is latched)
     ESP_RETURN_ON_ERROR(
-      setupDirection(mv.degrees), //
+      backend_->startPulses(jog_table_.period_us[0]), //
       MotorHal::TAG, //
-      "setupDirection failed"
+      "startPulses failed"
     );
+    return ESP_OK;
+  }
 
-    if (mv.move_type == MoveType::FIXED) {
-      // Generate motion profile segments
-      segments_ = RampedMove::generateSegments(mv.degrees, factor);
-      // ESP_LOGI(TAG, "Segments: ");
-      // for (SegmentData s : segments_) {
-      //   ESP_LOGI(TAG, "{ .steps = %d, .period_us = %u }", s.steps, s.period_us);
-      // }
-
-      current_segment_index_ = 0;
-      auto current_segment = segments_.at(current_segment_index_);
-
-      // 3. Setup LEDC first (starts generating pulses on M2)
-      ESP_RETURN_ON_ERROR(
-        setupLEDC(current_segment.period_us),
-        MotorHal::TAG, //
-        "setupLEDC failed"
-      );
-
-      // 4. Setup PCNT (monitors pulses on M2)
-      ESP_RETURN_ON_ERROR(
-        setupPCNT(current_segment.steps),
-        MotorHal::TAG, //
-        "setupPCNT failed"
+  /**
+   * @brief Packs the target the jog ISR steers to: the table entry to ramp to and the exact period
+   *
+   * Rates between two entries cruise at their own period once the lower entry is reached. Rates
+   * out of the table are clamped to it. A zero velocity or a reversal ramps down to the start rate
+   * and stops there.
+   */
+  void MotorHal::setJogTarget(int32_t velocity) {
+    const uint16_t top = jog_table_.size - 1;
+    bool stop = velocity == 0 || (velocity > 0) != (direction_ > 0);
+    uint16_t index = 0;
+    uint32_t period = jog_table_.period_us[0];
+    if (!stop) {
+      uint64_t rate = uint64_t(std::abs(velocity)) * move_factor_;
+      period = static_cast<uint32_t>(
+        std::clamp<uint64_t>(1000000 / rate, jog_table_.period_us[top], jog_table_.period_us[0])
       );
+      while (index < top && jog_table_.period_us[index + 1] >= period) {
+        ++index;
+      }
     }
+    jog_target_.store(period | uint32_t(index) << 16 | uint32_t(stop) << 24, std::memory_order_release);
+  }
 
-    if (mv.move_type == MoveType::FREE) {
-      // Setup stopper interrupt
-      ESP_RETURN_ON_ERROR(
-        setupStopper(), //
-        MotorHal::TAG, //
-        "setupStopper failed"
-      );
-
-      // Setup LEDC with initial period
+  esp_err_t MotorHal::restartJog(int8_t direction) {
+    int count = 0;
+    backend_->getCount(count);
+    int32_t units = count * (POSITION_UNITS_PER_STEP / move_factor_);
+    position_.fetch_add(direction_ > 0 ? units : -units, std::memory_order_relaxed);
+    if (direction != direction_) {
       ESP_RETURN_ON_ERROR(
-        setupLEDC(BASE_PERIOD_US), //
+        backend_->setDirection(direction > 0), //
         MotorHal::TAG, //
-        "setupLEDC failed"
+        "setDirection failed"
       );
+      direction_ = direction;
     }
+    ESP_RETURN_ON_ERROR(backend_->clearCount(), MotorHal::TAG, "clearCount failed");
+    jog_index_ = 0;
+    jog_target_.store(jog_table_.period_us[0], std::memory_order_relaxed);
+    plan_finished_ = false;
+    jog_stopped_.store(false, std::memory_order_release);
+    ESP_RETURN_ON_ERROR(backend_->resumePulses(), MotorHal::TAG, "resumePulses failed");
+    traceStart();
+    return ESP_OK;
+  }
 
-    // 5. Enable motor outputs
-    gpio_set_level(motor_cfg_.pins.en, 1);
-
+  /**
+   * @brief Starts a FREE run up the ramp table of the FreeRunCfg limits
+   *
+   * All ramp segments have the same length, so one watch point paces the whole run: each reach
+   * steps the period along the table, in either direction, from onFreeRunReachISR.
+   */
+  esp_err_t MotorHal::startFreeRun(const FreeRunCfg &cfg, uint16_t factor) {
+    free_table_ = RampedMove::rampTable(
+      Kinematics {.max_velocity = cfg.velocity, .acceleration = cfg.acceleration, .jerk = 0}, factor
+    );
+    free_index_ = 0;
+    free_phase_ = free_table_.size > 1 ? FreePhase::ACCEL : FreePhase::CRUISE;
+    brake_steps_ = 0;
+    free_steps_ = 0;
+    free_edge_steps_ = 0;
+    ESP_RETURN_ON_ERROR(
+      syncWatchPoints(free_table_.segmentSteps), //
+      MotorHal::TAG, //
+      "syncWatchPoints failed"
+    );
+    ESP_RETURN_ON_ERROR(
+      setupCounter(),
+      MotorHal::TAG, //
+      "setupCounter failed"
+    );
+    ESP_RETURN_ON_ERROR(
+      backend_->startPulses(free_table_.period_us[0]), //
+      MotorHal::TAG, //
+      "startPulses failed"
+    );
     return ESP_OK;
   }
 
   esp_err_t MotorHal::holdOrRelease(bool doHold) {
     ESP_RETURN_ON_ERROR(
-      gpio_set_level(
-        motor_cfg_.pins.en, //
-        uint32_t(doHold)
-      ),
-      MotorHal::TAG, "gpio_set_level failed"
+      backend_->setEnable(doHold), //
+      MotorHal::TAG, "setEnable failed"
     );
     return ESP_OK;
   }
 
+  void IRAM_ATTR MotorHal::releaseArmedFromISR() {
+    if (armed_ && !runs_plans_) {
+      isr_ops_.releasePulses(*backend_);
+      armed_ = false;
+      pulse_start_us_ = esp_timer_get_time();
+      traceStart();
+    }
+  }
+
+  esp_err_t MotorHal::releaseArmedPlan() {
+    if (!armed_) {
+      return ESP_OK;
+    }
+    armed_ = false;
+    pulse_start_us_ = esp_timer_get_time();
+    traceStart();
+    return backend_->startPlan(plan_);
+  }
+
+  // First segment of the move as started, from its plan, its ramp table or the fixed FREE rate
+  void IRAM_ATTR MotorHal::traceStart() {
+    if (!trace_.recording()) {
+      return;
+    }
+    int32_t planned = direction_;
+    uint32_t period_us = BASE_PERIOD_US;
+    uint32_t steps = 0;
+    if (last_move_.move_type == MoveType::FIXED) {
+      planned *= static_cast<int32_t>(plan_.plannedSteps());
+      period_us = segment_.period_us;
+      steps = std::abs(segment_.steps);
+    } else if (last_move_.move_type == MoveType::FREE && free_ramped_) {
+      period_us = free_table_.period_us[0];
+      steps = free_table_.segmentSteps;
+    } else if (last_move_.move_type == MoveType::JOG) {
+      period_us = jog_table_.period_us[0];
+      steps = jog_table_.segmentSteps;
+    }
+    trace_.record(TraceKind::START, planned, period_us, steps, move_factor_, static_cast<uint8_t>(last_move_.move_type));
+  }
+
   esp_err_t MotorHal::stopMove() {
     // 1. Disable motor outputs first (stop motion immediately)
     if (last_move_.end_action == EndAction::COAST) {
-      ESP_ERROR_CHECK(gpio_set_level(motor_cfg_.pins.en, 0));
+      ESP_ERROR_CHECK(backend_->setEnable(false));
     }
     // If HOLD, keep EN high to maintain holding torque
 
-    // 2. Stop PCNT first (stop counting before stopping pulse generation)
-    if (last_move_.move_type == MoveType::FIXED) {
-      ESP_ERROR_CHECK(pcnt_unit_stop(pcnt_unit_));
-      // Remove the watch point for the last segment
-      ESP_ERROR_CHECK(pcnt_unit_remove_watch_point(pcnt_unit_, std::abs(segments_.back().steps)));
+    // 2. Stop counter first (stop counting before stopping pulse generation)
+    bool counted = (last_move_.move_type == MoveType::FIXED && !backend_->runsPlans())
+                   || (last_move_.move_type == MoveType::FREE && free_ramped_)
+                   || last_move_.move_type == MoveType::JOG;
+    if (counted) {
+      if (!plan_finished_) {
+        // Stopped mid-move: no pulse may slip past the count read back for the position
+        ESP_ERROR_CHECK(backend_->pausePulses());
+      }
+      ESP_ERROR_CHECK(backend_->stopCounter());
     }
+    int count = 0;
+    if (counted && !plan_finished_ && trace_.recording()) {
+      backend_->getCount(count);
+    }
+    commitPosition();
+    trace_.record(TraceKind::STOP, position(), 0, 0, count, plan_finished_ ? 1 : 0);
+    latency_.record(LatencyStage::MOVE, esp_timer_get_time() - pulse_start_us_);
 
-    // 3. Stop and deconfigure LEDC (stop pulse generation)
-    ESP_ERROR_CHECK(ledc_stop(ledc_mode_, ledc_channel_, 0));
-    ESP_ERROR_CHECK(ledc_timer_pause(ledc_mode_, ledc_timer_));
-    ESP_ERROR_CHECK(ledc_set_duty(ledc_mode_, ledc_channel_, 0));
-    ESP_ERROR_CHECK(ledc_update_duty(ledc_mode_, ledc_channel_));
-
-    ledc_channel_config_t ledc_chan_cfg = {};
-    ledc_chan_cfg.deconfigure = true;
-    ESP_RETURN_ON_ERROR(
-      ledc_channel_config(&ledc_chan_cfg), //
-      MotorHal::TAG, //
-      "LEDC channel deconfig failed"
-    );
-
-    ledc_timer_config_t ledc_timer_cfg = {};
-    ledc_timer_cfg.deconfigure = true;
-    ledc_timer_cfg.timer_num = ledc_timer_;
-    ledc_timer_cfg.speed_mode = ledc_mode_;
+    // 3. Stop pulse generation
     ESP_RETURN_ON_ERROR(
-      ledc_timer_config(&ledc_timer_cfg), //
+      backend_->stopPulses(), //
       MotorHal::TAG, //
-      "LEDC timer deconfig failed"
+      "stopPulses failed"
     );
+    pulse_stop_us_ = esp_timer_get_time();
 
     // 4. Cleanup move-specific resources
     if (last_move_.move_type == MoveType::FREE) {
-      ESP_ERROR_CHECK(gpio_intr_disable(motor_cfg_.pins.stop));
-      ESP_ERROR_CHECK(gpio_isr_handler_remove(motor_cfg_.pins.stop));
+      ESP_ERROR_CHECK(backend_->disarmStopper());
     }
 
     return ESP_OK;
   }
 
+  /**
+   * @brief Decelerate-stop: the rest of the move becomes the ramp-down from the current rate
+   *
+   * Pulses are paused for the switch, so the count read back is exact and the pause only
+   * stretches one step period. Plans streamed by the engine cannot be replaced (ESP_ERR_NOT_SUPPORTED),
+   * an unramped FREE run is at the start rate already and stops right away.
+   */
+  esp_err_t MotorHal::decelerate(bool &stopped) {
+    stopped = true;
+    if (last_move_.move_type == MoveType::FREE) {
+      if (free_ramped_) {
+        portENTER_CRITICAL(&isr_lock_);
+        if ((free_phase_ == FreePhase::ACCEL || free_phase_ == FreePhase::CRUISE) && free_index_ > 0) {
+          int count = 0;
+          if (trace_.recording()) {
+            backend_->getCount(count);
+          }
+          backend_->clearCountFromISR();
+          free_phase_ = FreePhase::BRAKE;
+          backend_->setPeriodFromISR(free_table_.period_us[--free_index_]);
+          trace_.record(
+            TraceKind::DECEL, free_index_, free_table_.period_us[free_index_], free_table_.segmentSteps, count
+          );
+          stopped = false;
+        }
+        portEXIT_CRITICAL(&isr_lock_);
+      }
+      return ESP_OK;
+    }
+    if (last_move_.move_type != MoveType::FIXED || plan_finished_) {
+      return ESP_OK;
+    }
+    if (backend_->runsPlans()) {
+      return ESP_ERR_NOT_SUPPORTED;
+    }
+    ESP_RETURN_ON_ERROR(backend_->pausePulses(), MotorHal::TAG, "pausePulses failed");
+    portENTER_CRITICAL(&isr_lock_);
+    int count = 0;
+    backend_->getCount(count);
+    backend_->clearCountFromISR();
+    completed_steps_ += count;
+    bool isr = motor_cfg_.segmentSwitch == SegmentSwitch::ISR;
+    uint16_t current = plan_.nextIndex() - 1 - (isr && pending_valid_ ? 1 : 0);
+    plan_ = plan_.rampDownFrom(current);
+    pending_valid_ = false;
+    stopped = !plan_.next(segment_);
+    if (stopped) {
+      plan_finished_ = true;
+      trace_.record(TraceKind::DECEL, current, 0, 0, count);
+    } else {
+      backend_->setPeriodFromISR(segment_.period_us);
+      if (isr) {
+        preloadSegment();
+      }
+      trace_.record(TraceKind::DECEL, current, segment_.period_us, std::abs(segment_.steps), count);
+    }
+    portEXIT_CRITICAL(&isr_lock_);
+    if (stopped) {
+      return ESP_OK;
+    }
+    if (!isr) {
+      ESP_RETURN_ON_ERROR(syncWatchPoints(segment_.steps), MotorHal::TAG, "syncWatchPoints failed");
+    }
+    ESP_RETURN_ON_ERROR(backend_->resumePulses(), MotorHal::TAG, "resumePulses failed");
+    return ESP_OK;
+  }
+
+  void MotorHal::commitPosition() {
+    if (last_move_.move_type == MoveType::FREE) {
+      // FREE runs home against the stopper, which is the zero of the position
+      if (stopper_hit_) {
+        // A ramped run brakes past the edge: counted from the edge on, the rest cannot tell
+        int count = 0;
+        if (free_ramped_ && !plan_finished_) {
+          backend_->getCount(count);
+        }
+        int32_t units = static_cast<int32_t>(free_ramped_ ? brake_steps_ + count : 0)
+                        * (POSITION_UNITS_PER_STEP / move_factor_);
+        overshoot_.store(units, std::memory_order_relaxed);
+        setPosition(direction_ > 0 ? units : -units);
+      } else {
+        position_known_.store(false, std::memory_order_relaxed);
+      }
+      return;
+    }
+    if (last_move_.move_type == MoveType::JOG) {
+      // Whole segments are committed as they complete, only the last partial one is left
+      int count = 0;
+      if (!plan_finished_) {
+        backend_->getCount(count);
+      }
+      int32_t units = count * (POSITION_UNITS_PER_STEP / move_factor_);
+      position_.fetch_add(direction_ > 0 ? units : -units, std::memory_order_relaxed);
+      return;
+    }
+    if (last_move_.move_type != MoveType::FIXED) {
+      return;
+    }
+    uint32_t steps = completed_steps_;
+    if (!plan_finished_ && !armed_) {
+      int count = 0;
+      if (backend_->getCount(count) != ESP_OK) {
+        // Engine cannot tell how far an aborted move got
+        last_steps_.store(UINT32_MAX, std::memory_order_relaxed);
+        position_known_.store(false, std::memory_order_relaxed);
+        return;
+      }
+      steps += count;
+    }
+    last_steps_.store(steps, std::memory_order_relaxed);
+    int32_t units = static_cast<int32_t>(steps) * (POSITION_UNITS_PER_STEP / move_factor_);
+    position_.fetch_add(direction_ > 0 ? units : -units, std::memory_order_relaxed);
+  }
+
+  void MotorHal::setPosition(int32_t position) {
+    position_.store(position, std::memory_order_relaxed);
+    position_known_.store(true, std::memory_order_relaxed);
+  }
+
+  int32_t MotorHal::stepsTo(int32_t degrees) {
+    const int64_t unitsPerRevolution = int64_t(STEPS_PER_REVOLUTION) * POSITION_UNITS_PER_STEP;
+    // Both roundings are to nearest, ties away from zero
+    return stepsToPosition((int64_t(degrees) * unitsPerRevolution * 2 + (degrees >= 0 ? 360 : -360)) / 720);
+  }
+
+  int32_t MotorHal::stepsToPosition(int64_t target) {
+    const int32_t unitsPerStep = POSITION_UNITS_PER_STEP / motor_cfg_.stepMode.getFactor();
+    int64_t delta = target - position();
+    return static_cast<int32_t>((delta * 2 + (delta >= 0 ? unitsPerStep : -unitsPerStep)) / (2 * unitsPerStep));
+  }
+
   /**
    * @brief Transition to the next segment in a ramped move
    * @return true if move is complete (no more segments), false if continuing
    */
   bool MotorHal::nextSegment() {
-    if (current_segment_index_ < (segments_.size() - 1)) {
-      auto finished_segment = segments_.at(current_segment_index_++);
-      auto current_segment = segments_.at(current_segment_index_);
-
-      // 1. Pause pulse generation
-      ledc_timer_pause(ledc_mode_, ledc_timer_);
-
-      // 2. Reconfigure pulse counter for next segment
-      pcnt_unit_stop(pcnt_unit_);
-      pcnt_unit_clear_count(pcnt_unit_);
-      pcnt_unit_remove_watch_point(pcnt_unit_, std::abs(finished_segment.steps));
-      pcnt_unit_add_watch_point(pcnt_unit_, std::abs(current_segment.steps));
-      pcnt_unit_start(pcnt_unit_);
-
-      // 3. Update pulse frequency and resume generation
-      ledc_set_freq(ledc_mode_, ledc_timer_, 1000000 / current_segment.period_us);
-      ledc_timer_resume(ledc_mode_, ledc_timer_);
+    if (backend_->runsPlans()) {
+      // The engine ran the whole plan, the task is only woken up at the end
+      completed_steps_ = plan_.plannedSteps();
+      plan_finished_ = true;
+      ESP_LOGI(TAG, "Move complete");
+      return true;
+    }
+    if (motor_cfg_.segmentSwitch == SegmentSwitch::ISR) {
+      // Segments are chained in onReachISR, the task is only woken up once the plan is exhausted
+      ESP_LOGI(TAG, "Move complete");
+      return true;
+    }
+    // Pulses go on past the watch point until paused: the count read back is what the segment ran
+    uint32_t ended = std::abs(segment_.steps);
+    backend_->pausePulses();
+    backend_->stopCounter();
+    int count = 0;
+    backend_->getCount(count);
+    // A segment ending on the counter limit has reset the count there
+    count += ended == RampedMove::maxSegmentSteps ? ended : 0;
+    completed_steps_ += count;
+    if (plan_.next(segment_)) {
+      // Reconfigure pulse counter for next segment
+      backend_->clearCount();
+      syncWatchPoints(segment_.steps);
+      backend_->startCounter();
+
+      // Update pulse frequency and resume generation
+      backend_->setPeriod(segment_.period_us);
+      backend_->resumePulses();
+      trace_.record(TraceKind::SEGMENT, plan_.nextIndex() - 1, segment_.period_us, std::abs(segment_.steps), count);
       return false; // More segments remain
     }
 
+    // Left paused and counted: stopMove has nothing more to read back
+    backend_->clearCount();
+    plan_finished_ = true;
+    trace_.record(TraceKind::PAUSE, plan_.nextIndex(), 0, 0, count);
     ESP_LOGI(TAG, "Move complete");
     return true; // All segments done
   }
 
+  void IRAM_ATTR MotorHal::preloadSegment() { pending_valid_ = plan_.next(pending_); }
+
+  void IRAM_ATTR MotorHal::onFreeRunReachISR(int watch_point_value) {
+    if (!free_ramped_ || watch_point_value != static_cast<int>(free_table_.segmentSteps)) {
+      return;
+    }
+    backend_->clearCountFromISR();
+    if (free_phase_ == FreePhase::ACCEL || free_phase_ == FreePhase::CRUISE) {
+      free_steps_ += free_table_.segmentSteps;
+    }
+    switch (free_phase_) {
+      case FreePhase::ACCEL:
+        if (++free_index_ >= free_table_.size - 1) {
+          free_phase_ = FreePhase::CRUISE;
+        }
+        backend_->setPeriodFromISR(free_table_.period_us[free_index_]);
+        break;
+      case FreePhase::BRAKE:
+        brake_steps_ += free_table_.segmentSteps;
+        if (free_index_ == 0) {
+          // Down to the start rate: stopped, the task commits the position
+          backend_->pausePulsesFromISR();
+          free_phase_ = FreePhase::DONE;
+          plan_finished_ = true;
+          trace_.record(TraceKind::PAUSE, 0, 0, 0, watch_point_value);
+          onStopISR();
+          return;
+        }
+        backend_->setPeriodFromISR(free_table_.period_us[--free_index_]);
+        break;
+      default:
+        break; // Cruising: the count is only kept in range
+    }
+    trace_.record(
+      TraceKind::SEGMENT, free_index_, free_table_.period_us[free_index_], free_table_.segmentSteps, watch_point_value
+    );
+  }
+
+  void IRAM_ATTR MotorHal::onJogReachISR(int watch_point_value) {
+    if (watch_point_value != static_cast<int>(jog_table_.segmentSteps) || jog_stopped_.load(std::memory_order_relaxed)) {
+      return;
+    }
+    backend_->clearCountFromISR();
+    int32_t units = static_cast<int32_t>(jog_table_.segmentSteps) * (POSITION_UNITS_PER_STEP / move_factor_);
+    position_.fetch_add(direction_ > 0 ? units : -units, std::memory_order_relaxed);
+    uint32_t target = jog_target_.load(std::memory_order_acquire);
+    uint16_t index = (target >> 16) & 0xFF;
+    uint32_t period_us = target & 0xFFFF;
+    if (jog_index_ < index) {
+      period_us = jog_table_.period_us[++jog_index_];
+    } else if (jog_index_ > index) {
+      period_us = jog_table_.period_us[--jog_index_];
+    } else if (target >> 24) {
+      // At the start rate with a stop due: paused until the task restarts or ends the jog
+      backend_->pausePulsesFromISR();
+      plan_finished_ = true;
+      jog_stopped_.store(true, std::memory_order_release);
+      trace_.record(TraceKind::PAUSE, jog_index_, 0, 0, watch_point_value);
+      onStopISR();
+      return;
+    }
+    backend_->setPeriodFromISR(period_us);
+    trace_.record(TraceKind::SEGMENT, jog_index_, period_us, jog_table_.segmentSteps, watch_point_value);
+  }
+
+  void IRAM_ATTR MotorHal::onReachISR(int watch_point_value) {
+    if (last_move_.move_type == MoveType::FREE) {
+      onFreeRunReachISR(watch_point_value);
+      return;
+    }
+    if (last_move_.move_type == MoveType::JOG) {
+      onJogReachISR(watch_point_value);
+      return;
+    }
+    if (motor_cfg_.segmentSwitch == SegmentSwitch::ISR && last_move_.move_type == MoveType::FIXED) {
+      if (watch_point_value != std::abs(segment_.steps)) {
+        return; // Watch point of the other segment size, passed mid-segment
+      }
+      completed_steps_ += std::abs(segment_.steps);
+      if (pending_valid_) {
+        // New period is latched at the end of the current pulse: the step train is never paused
+        int64_t isr_us = esp_timer_get_time();
+        backend_->clearCountFromISR();
+        backend_->setPeriodFromISR(pending_.period_us);
+        segment_ = pending_;
+        preloadSegment();
+        latency_.record(LatencyStage::SEGMENT_SWITCH, esp_timer_get_time() - isr_us);
+        trace_.record(
+          TraceKind::SEGMENT, plan_.nextIndex() - 1 - (pending_valid_ ? 1 : 0), segment_.period_us,
+          std::abs(segment_.steps), watch_point_value
+        );
+        return;
+      }
+      // Plan is exhausted: no pulse past the last segment while the task wakes up
+      backend_->pausePulsesFromISR();
+      plan_finished_ = true;
+      trace_.record(TraceKind::PAUSE, plan_.nextIndex(), 0, 0, watch_point_value);
+    }
+    onStopISR();
+  }
+
+  // GPIO ISR, IRAM only: the backend is called through isr_ops_
+  void IRAM_ATTR MotorHal::onStopperISR() {
+    if (last_move_.move_type == MoveType::FREE && free_ramped_) {
+      if (free_phase_ == FreePhase::BRAKE || free_phase_ == FreePhase::DONE) {
+        return; // Edges past the first one while braking
+      }
+      // The overshoot is counted from the edge: brake down the table from the current rate
+      stopper_hit_ = true;
+      int count = 0;
+      isr_ops_.getCount(*backend_, count);
+      free_edge_steps_ = free_steps_ + count;
+      isr_ops_.clearCount(*backend_);
+      int32_t edge = static_cast<int32_t>(free_edge_steps_);
+      if (free_index_ > 0) {
+        free_phase_ = FreePhase::BRAKE;
+        isr_ops_.setPeriod(*backend_, free_table_.period_us[--free_index_]);
+        trace_.record(
+          TraceKind::STOPPER, edge, free_table_.period_us[free_index_], free_table_.segmentSteps, count
+        );
+        return;
+      }
+      isr_ops_.pausePulses(*backend_);
+      free_phase_ = FreePhase::DONE;
+      plan_finished_ = true;
+      trace_.record(TraceKind::STOPPER, edge, 0, 0, count);
+      onStopISR();
+      return;
+    }
+    stopper_hit_ = true;
+    trace_.record(TraceKind::STOPPER, 0, 0, 0, 0);
+    onStopISR();
+  }
+
   void IRAM_ATTR MotorHal::onStopISR() {
     BaseType_t hp = pdFALSE;
     if (task_) {
@@ -1,45 +1,162 @@
 #pragma once
-#include <driver/gpio_filter.h>
-#include <driver/ledc.h>
-#include <driver/pulse_cnt.h>
-#include <vector>
+#include <array>
+#include <atomic>
+#include <memory>
 
 #include "Common.hpp"
+#include "LatencyStats.hpp"
+#include "MotionTrace.hpp"
+#include "MotorBackend.hpp"
+#include "PlanCache.hpp"
+#include "RampedMove.hpp"
 
 namespace motor {
 
+  // Driver and peripheral calls avoided by startMove, for host-side checks
+  struct SetupStats {
+      uint32_t latches;
+      uint32_t latchesSkipped;
+      uint32_t directionSkipped;
+      uint32_t watchPointsKept;
+      uint32_t plansPrepared; // Taken from preparePlan instead of planned in startMove
+  };
+
   class MotorHal {
     public:
       esp_err_t init();
-      esp_err_t startMove(Move &mv, MotorCmdId id);
+      /**
+       * @param steps Signed length of a FIXED move, which may span several blended queued moves
+       * @param stretch_q16 Slows a FIXED move down by stretch_q16 / 65536, 0 runs it as planned
+       * @param armed FIXED move set up without its first pulse, the caller releases it
+       */
+      esp_err_t startMove(Move &mv, MotorCmdId id, int32_t steps = 0, uint32_t stretch_q16 = 0, bool armed = false);
+      /**
+       * @brief Plans a FIXED move ahead of its startMove, while the previous one runs
+       * @return false when it has no segments
+       */
+      bool preparePlan(int32_t steps, uint16_t factor);
+      // Release of an armed move: the ISR half resumes a paused timer, the task half starts a streamed plan
+      void releaseArmedFromISR();
+      esp_err_t releaseArmedPlan();
       esp_err_t stopMove();
+      // Replaces the rest of the move with its shortest ramp-down, stopped tells the move is over already
+      esp_err_t decelerate(bool &stopped);
       bool nextSegment();
+      // Jog: velocity in full steps/s, ramped to along the kinematics table, 0 or a reversal stops first
+      void setJogTarget(int32_t velocity);
+      // Jog paused at the start rate, for a stop or a reversal
+      bool jogStopped() const { return jog_stopped_.load(std::memory_order_acquire); }
+      // Restarts a stopped jog from the start rate, direction: +1/-1
+      esp_err_t restartJog(int8_t direction);
       esp_err_t holdOrRelease(bool doHold);
       void registerTaskHandle(TaskHandle_t h) { task_ = h; }
       void onStopISR();
-      MotorHal(MotorCfg &);
+      void onStopperISR();
+      // Absolute position in POSITION_UNITS_PER_STEP units, as of the end of the last move
+      int32_t position() const { return position_.load(std::memory_order_relaxed); }
+      bool positionKnown() const { return position_known_.load(std::memory_order_relaxed); }
+      void setPosition(int32_t position);
+      // Signed steps at the current factor from the position to an absolute angle
+      int32_t stepsTo(int32_t degrees);
+      // Same to an absolute position in POSITION_UNITS_PER_STEP units
+      int32_t stepsToPosition(int64_t target);
+      // Distance run past the stopper edge by the last ramped FREE run, in POSITION_UNITS_PER_STEP units
+      int32_t overshoot() const { return overshoot_.load(std::memory_order_relaxed); }
+      // FREE runs use cfg instead of MotorCfg::freeRun until reset with nullptr
+      void overrideFreeRun(const FreeRunCfg *cfg) { free_override_ = cfg; }
+      // Steps from the start of the last ramped FREE run to the stopper edge, at its step factor
+      uint32_t freeRunEdgeSteps() const { return free_edge_steps_; }
+      // Steps the last FIXED move ran at its own step factor, UINT32_MAX when the engine cannot tell
+      uint32_t lastMoveSteps() const { return last_steps_.load(std::memory_order_relaxed); }
+      uint16_t lastMoveFactor() const { return move_factor_; }
+      void onReachISR(int watch_point_value);
+      MotorBackend &backend() { return *backend_; }
+      PlanCache &planCache() { return plan_cache_; }
+      const SetupStats &setupStats() const { return setup_stats_; }
+      LatencyStats &latency() { return latency_; }
+      MotionTrace &trace() { return trace_; }
+      int64_t pulseStartUs() const { return pulse_start_us_; }
+      // When the last stopMove had the pulses stopped
+      int64_t pulseStopUs() const { return pulse_stop_us_; }
+      MotorHal(MotorCfg &, std::unique_ptr<MotorBackend> backend = nullptr);
 
     private:
       static constexpr const char *TAG = "MotorHal";
       MotorCfg &motor_cfg_;
+      std::unique_ptr<MotorBackend> backend_;
+      // Copied from backend_ by init, for the IRAM ISRs
+      bool runs_plans_ = false;
+      MotorBackend::IsrOps isr_ops_ {};
       Move last_move_;
       TaskHandle_t task_ = nullptr;
-      pcnt_unit_handle_t pcnt_unit_ = nullptr;
-      pcnt_channel_handle_t pcnt_channel_ = nullptr;
-      gpio_glitch_filter_handle_t stopper_filter_ = nullptr;
-      ledc_mode_t ledc_mode_ = LEDC_LOW_SPEED_MODE;
-      ledc_timer_t ledc_timer_ = LEDC_TIMER_0;
-      ledc_channel_t ledc_channel_ = LEDC_CHANNEL_0;
-      std::vector<SegmentData> segments_;
-      uint16_t current_segment_index_ = 0;
-      esp_err_t setupDirection(int32_t degrees);
-      esp_err_t setupPCNT(int target_steps);
-      esp_err_t setupLEDC(uint32_t period_us);
-      esp_err_t setupStopper();
-      esp_err_t setupMode();
-      esp_err_t initGPIO();
-      esp_err_t initPCNT();
-      esp_err_t initStopper();
+      RampedMove plan_;
+      SegmentData segment_ {};
+      PlanCache plan_cache_;
+      // Made by preparePlan, taken by the startMove of the same steps, factor and kinematics
+      struct PreparedPlan {
+          bool valid;
+          int32_t steps;
+          uint16_t factor;
+          Kinematics kinematics;
+          RampedMove plan;
+          // Driver state the move sets up, resolved ahead too
+          uint8_t modeBits;
+          int8_t direction;
+      };
+      PreparedPlan prepared_ {};
+      // ISR segment switching: next segment is preloaded
+      SegmentData pending_ {};
+      bool pending_valid_ = false;
+      // Ramp, middle head and chained middle sizes; the last one is the counter limit, no threshold needed
+      std::array<int, 3> watch_points_ {};
+      uint8_t watch_point_count_ = 0;
+      void preloadSegment();
+      esp_err_t addWatchPoint(int steps);
+      esp_err_t syncWatchPoints(int first, int second = 0, int third = 0);
+      esp_err_t setupCounter();
+      // Driver state left by the previous move: setup only applies what changed
+      static constexpr uint8_t kNoMode = 0xFF;
+      uint8_t latched_mode_ = kNoMode;
+      int8_t direction_ = 0;
+      SetupStats setup_stats_ {};
+      // Position: steps of the move are committed by stopMove, partial ones read back from the counter
+      std::atomic<int32_t> position_ {0};
+      std::atomic<bool> position_known_ {false};
+      uint16_t move_factor_ = 1;
+      uint32_t completed_steps_ = 0;
+      bool plan_finished_ = false;
+      bool stopper_hit_ = false;
+      // Armed and not released yet: no pulse has gone out
+      bool armed_ = false;
+      std::atomic<uint32_t> last_steps_ {0};
+      void commitPosition();
+      // Masks the step ISRs while the task rewrites the plan they chain (single core)
+      portMUX_TYPE isr_lock_ = portMUX_INITIALIZER_UNLOCKED;
+      // Ramped FREE run: up the ramp table, cruise at its last entry, down the table past the stopper
+      enum class FreePhase : uint8_t { ACCEL, CRUISE, BRAKE, DONE };
+      bool free_ramped_ = false;
+      FreePhase free_phase_ = FreePhase::DONE;
+      uint16_t free_index_ = 0;
+      RampTable free_table_ {};
+      uint32_t brake_steps_ = 0;
+      uint32_t free_steps_ = 0; // Before the edge, whole segments
+      uint32_t free_edge_steps_ = 0;
+      const FreeRunCfg *free_override_ = nullptr;
+      std::atomic<int32_t> overshoot_ {0};
+      esp_err_t startFreeRun(const FreeRunCfg &cfg, uint16_t factor);
+      void onFreeRunReachISR(int watch_point_value);
+      // Jog: up and down the ramp table one segment at a time, toward the packed target
+      RampTable jog_table_ {};
+      uint16_t jog_index_ = 0;
+      std::atomic<uint32_t> jog_target_ {0}; // period_us | index << 16 | stop << 24
+      std::atomic<bool> jog_stopped_ {false};
+      esp_err_t startJog(uint16_t factor);
+      void onJogReachISR(int watch_point_value);
+      LatencyStats latency_;
+      int64_t pulse_start_us_ = 0;
+      int64_t pulse_stop_us_ = 0;
+      MotionTrace trace_;
+      void traceStart();
   };
 
 } // namespace motor
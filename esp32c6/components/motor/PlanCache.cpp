@@ -0,0 +1,34 @@
+#include "PlanCache.hpp"
+
+namespace motor {
+
+  const RampedMove &PlanCache::get(int32_t steps, uint16_t factor, const Kinematics &kinematics) {
+    Entry *victim = &entries_[0];
+    const RampTable *table = nullptr;
+    for (Entry &e : entries_) {
+      if (!e.valid) {
+        victim = &e;
+        continue;
+      }
+      if (e.factor == factor && e.kinematics == kinematics) {
+        if (e.steps == steps) {
+          e.lastUse = ++clock_;
+          hits_.fetch_add(1, std::memory_order_relaxed);
+          return e.plan;
+        }
+        table = &e.plan.rampTable();
+      }
+      if (victim->valid && e.lastUse < victim->lastUse) {
+        victim = &e;
+      }
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    // The shared table may live in the victim itself, so the plan is built before it is replaced
+    RampedMove plan = table ? RampedMove(steps, *table) : RampedMove(steps, RampedMove::rampTable(kinematics, factor));
+    *victim = Entry {
+      .valid = true, .steps = steps, .factor = factor, .kinematics = kinematics, .lastUse = ++clock_, .plan = plan
+    };
+    return victim->plan;
+  }
+
+} // namespace motor
@@ -0,0 +1,50 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "Common.hpp"
+#include "RampedMove.hpp"
+
+namespace motor {
+  struct PlanCacheStats {
+      uint32_t hits;
+      uint32_t misses;
+  };
+
+  /**
+   * @brief Fixed-size cache of move plans keyed by (steps, step factor, kinematics)
+   *
+   * Host choreographies repeat the same few moves, so those are served without rebuilding the ramp
+   * table. On a miss the table is still shared with any cached plan of the same factor and
+   * kinematics; the least recently used entry is replaced.
+   */
+  class PlanCache {
+    public:
+      static constexpr size_t kSize = 8;
+
+      // Returned plan is unconsumed and stays valid until the next call
+      const RampedMove &get(int32_t steps, uint16_t factor, const Kinematics &kinematics);
+      PlanCacheStats stats() const {
+        return {.hits = hits_.load(std::memory_order_relaxed), .misses = misses_.load(std::memory_order_relaxed)};
+      }
+      void resetStats() {
+        hits_.store(0, std::memory_order_relaxed);
+        misses_.store(0, std::memory_order_relaxed);
+      }
+
+    private:
+      struct Entry {
+          bool valid;
+          int32_t steps;
+          uint16_t factor;
+          Kinematics kinematics;
+          uint32_t lastUse;
+          RampedMove plan;
+      };
+      std::array<Entry, kSize> entries_ {};
+      uint32_t clock_ = 0;
+      std::atomic<uint32_t> hits_ {0};
+      std::atomic<uint32_t> misses_ {0};
+  };
+} // namespace motor
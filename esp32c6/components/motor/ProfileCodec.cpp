@@ -0,0 +1,78 @@
+#include "ProfileCodec.hpp"
+
+namespace motor {
+
+  namespace ProfileCodec {
+    // Unsigned LEB128 of at most 32 bits
+    static bool readVarint(const uint8_t *&p, const uint8_t *end, uint32_t &value) {
+      value = 0;
+      for (int shift = 0; shift < 35; shift += 7) {
+        if (p == end) {
+          return false;
+        }
+        uint8_t byte = *p++;
+        if (shift == 28 && byte > 0x0F) {
+          return false;
+        }
+        value |= uint32_t(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    esp_err_t decode(const uint8_t *data, size_t length, uint16_t factor, Move *moves, size_t capacity, size_t &count) {
+      count = 0;
+      if (!length) {
+        return ESP_ERR_INVALID_SIZE;
+      }
+      Move prev {.degrees = 0, .delay_ms = 0, .end_action = EndAction::COAST, .move_type = MoveType::FIXED, .steps = 0, .step_factor = factor};
+      const uint8_t *p = data;
+      const uint8_t *end = data + length;
+      while (p < end) {
+        uint8_t header = *p++;
+        size_t repeat = 1;
+        if (!(header & LONG)) {
+          int64_t steps = int64_t(prev.steps) + static_cast<int8_t>(header << 1) / 2;
+          if (steps < INT32_MIN || steps > INT32_MAX) {
+            return ESP_ERR_INVALID_ARG;
+          }
+          prev.steps = static_cast<int32_t>(steps);
+        } else {
+          if (header & FLAG_FACTOR) {
+            if (p == end) {
+              return ESP_ERR_INVALID_SIZE;
+            }
+            uint8_t shift = *p++;
+            if (shift > 7) {
+              return ESP_ERR_INVALID_ARG;
+            }
+            prev.step_factor = 1u << shift;
+          }
+          uint32_t delay = 0;
+          if ((header & FLAG_DELAY) && !readVarint(p, end, delay)) {
+            return ESP_ERR_INVALID_SIZE;
+          }
+          uint32_t zigzag;
+          if (!readVarint(p, end, zigzag)) {
+            return ESP_ERR_INVALID_SIZE;
+          }
+          prev.steps = static_cast<int32_t>(zigzag >> 1) ^ -static_cast<int32_t>(zigzag & 1);
+          prev.delay_ms = delay;
+          prev.end_action = header & FLAG_HOLD ? EndAction::HOLD : EndAction::COAST;
+          prev.move_type = header & FLAG_ABSOLUTE ? MoveType::GOTO : MoveType::FIXED;
+          repeat += (header & ~LONG) >> REPEAT_SHIFT;
+        }
+        if (count + repeat > capacity) {
+          return ESP_ERR_INVALID_SIZE;
+        }
+        for (size_t i = 0; i < repeat; ++i) {
+          moves[count++] = prev;
+        }
+      }
+      return ESP_OK;
+    }
+  } // namespace ProfileCodec
+
+} // namespace motor
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <esp_err.h>
+
+#include "Common.hpp"
+
+namespace motor {
+
+  /**
+   * @brief Compact move stream of a v2 profile, little endian varints
+   *
+   * A record is either one byte for a move like the previous one, or a header byte and its fields:
+   *  - 0sssssss: the previous move again, its steps shifted by the signed 7-bit s
+   *  - 1rrrfdah: h holds at the end instead of coasting, a targets an absolute position (GOTO), then
+   *    f a log2 step factor byte, d a varint delay_ms, and always the zigzag varint steps follow;
+   *    the move is queued 1 + r times
+   * Steps are at the step factor in effect: the axis one until a record sets it, for the rest of the
+   * stream. Before the first record, the previous move is 0 steps, coasting, without delay.
+   */
+  namespace ProfileCodec {
+    inline constexpr uint8_t LONG = 0x80;
+    inline constexpr uint8_t FLAG_HOLD = 0x01;
+    inline constexpr uint8_t FLAG_ABSOLUTE = 0x02;
+    inline constexpr uint8_t FLAG_DELAY = 0x04;
+    inline constexpr uint8_t FLAG_FACTOR = 0x08;
+    inline constexpr uint8_t REPEAT_SHIFT = 4;
+
+    /**
+     * @param factor Step factor of the axis, the one in effect until a record sets another
+     * @return ESP_ERR_INVALID_SIZE when the stream is empty, truncated or decodes to more than capacity
+     * moves, ESP_ERR_INVALID_ARG for a step factor past 128 or steps out of the int32 range
+     */
+    esp_err_t decode(const uint8_t *data, size_t length, uint16_t factor, Move *moves, size_t capacity, size_t &count);
+  } // namespace ProfileCodec
+
+} // namespace motor
@@ -1,54 +1,175 @@
 #include <algorithm>
-#include <cmath>
-#include <vector>
+#include <cstdlib>
+#include <esp_attr.h>
 
 #include "Common.hpp"
 #include "RampedMove.hpp"
 
 namespace motor {
-  std::vector<SegmentData> RampedMove::generateSegments(int32_t degrees, uint32_t factor) {
-    // Compute total number of steps
-    int32_t dir = degrees > 0 ? +1 : -1;
-    uint32_t totalSteps = std::round(std::abs(degrees) * STEPS_PER_REVOLUTION * factor / 360.0f);
-
-    // Compute middle section size and profile cut point
-    int32_t midSegmentSize = static_cast<int32_t>(totalSteps)
-                             - static_cast<int32_t>(profile.size() * stepsPerSegment * factor * 2);
-    size_t profileCutPoint
-      = midSegmentSize >= 0 //
-          ? profile.size() //
-          : static_cast<size_t>(std::round(totalSteps / 2.0f / stepsPerSegment / factor)); //
-
-    // Build the ramp-up (start) sequence
-    std::vector<SegmentData> start;
-    start.reserve(profileCutPoint);
-    for (size_t i = 0; i < profileCutPoint; ++i) {
-      SegmentData seg;
-      seg.steps = stepsPerSegment * factor * dir;
-      seg.period_us = static_cast<uint32_t>(std::round(BASE_PERIOD_US * profile[i]));
-      start.push_back(seg);
-    }
-
-    // Ramp-down (end) is reversed copy of start
-    std::vector<SegmentData> end = start;
-    std::reverse(end.begin(), end.end());
-
-    // Optional middle segment
-    std::vector<SegmentData> middle;
-    if (midSegmentSize > 0) {
-      SegmentData midSeg;
-      midSeg.steps = midSegmentSize * dir;
-      midSeg.period_us = end.front().period_us;
-      middle.push_back(midSeg);
-    }
-
-    // Merge all parts
-    std::vector<SegmentData> plan;
-    plan.reserve(start.size() + middle.size() + end.size());
-    plan.insert(plan.end(), start.begin(), start.end());
-    plan.insert(plan.end(), middle.begin(), middle.end());
-    plan.insert(plan.end(), end.begin(), end.end());
+  // Ramp tables for every StepMode factor (1, 2, 4, ..., 128), built at compile time
+  static constexpr std::array<RampTable, 8> rampTables = {
+    RampedMove::makeRampTable(1),  RampedMove::makeRampTable(2),  RampedMove::makeRampTable(4),
+    RampedMove::makeRampTable(8),  RampedMove::makeRampTable(16), RampedMove::makeRampTable(32),
+    RampedMove::makeRampTable(64), RampedMove::makeRampTable(128),
+  };
+  static_assert(rampTables[0].period_us[1] == 3047 && rampTables[7].period_us[15] == 768);
 
+  RampTable RampedMove::rampTable(uint32_t factor) {
+    if (factor && factor <= maxFactor && (factor & (factor - 1)) == 0) {
+      return rampTables[__builtin_ctz(factor)];
+    }
+    return makeRampTable(factor);
+  }
+
+  /**
+   * @brief Ramp table of a time-optimal trapezoid (jerk == 0) or S-curve for the given limits
+   *
+   * Velocity is integrated block by block in integer milli-steps/s, starting from the
+   * BASE_PERIOD_US rate in full steps. Each block runs at the velocity reached at its start, so a
+   * move too short for a whole block runs at the start rate. The last entry is the cruise velocity.
+   * Block size doubles until the ramp fits in the table, up to maxSegmentSteps: a ramp longer than
+   * that cruises at the velocity it reached, which fits() tells apart.
+   */
+  RampTable RampedMove::rampTable(const Kinematics &kinematics, uint32_t factor) {
+    bool reached;
+    return rampTable(kinematics, factor, reached);
+  }
+
+  bool RampedMove::fits(const Kinematics &kinematics) {
+    // Not the finest factor alone: the rate cap flattens the ramps of the fine ones
+    for (uint32_t factor = 1; factor <= maxFactor; factor *= 2) {
+      bool reached;
+      rampTable(kinematics, factor, reached);
+      if (!reached) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  RampTable RampedMove::rampTable(const Kinematics &kinematics, uint32_t factor, bool &reached) {
+    reached = true;
+    if (!kinematics.max_velocity || !kinematics.acceleration) {
+      return rampTable(factor);
+    }
+    const int64_t vmax = std::min<int64_t>(kinematics.max_velocity * factor, 1000000 / MIN_PERIOD_US) * 1000;
+    const int64_t v0 = std::min<int64_t>(1000000000LL * factor / BASE_PERIOD_US, vmax);
+    const int64_t amax = int64_t(kinematics.acceleration) * factor;
+    const int64_t jerk = int64_t(kinematics.jerk) * factor;
+
+    // Ramp length estimate (steps), plus the distance covered while acceleration builds up
+    int64_t rampSteps = (vmax * vmax - v0 * v0) / 1000000 / (2 * amax);
+    if (jerk) {
+      rampSteps += vmax / 1000 * amax / jerk;
+    }
+    uint32_t segmentSteps = std::clamp<int64_t>(rampSteps / (kMaxRampSegments - 1) + 1, 1, maxSegmentSteps);
+
+    RampTable table {};
+    int64_t v = v0;
+    for (int attempt = 0; attempt < 16; ++attempt) {
+      table = {.segmentSteps = segmentSteps, .size = 0, .period_us = {}, .roundedCut = false};
+      v = v0;
+      int64_t a = jerk ? 0 : amax;
+      while (table.size < kMaxRampSegments - 1 && v < vmax) {
+        const int64_t dt_us = segmentSteps * 1000000000LL / v;
+        if (jerk) {
+          // Ease acceleration off once it alone would carry the velocity up to vmax
+          bool easing = v + a * a * 1000 / (2 * jerk) >= vmax;
+          a = easing ? std::max(amax / 16 + 1, a - jerk * dt_us / 1000000)
+                     : std::min(amax, a + jerk * dt_us / 1000000);
+        }
+        table.period_us[table.size++] = 1000000000LL / v;
+        v = std::min(vmax, v + a * dt_us / 1000);
+      }
+      if (v >= vmax || segmentSteps == maxSegmentSteps) {
+        break;
+      }
+      segmentSteps = std::min(2 * segmentSteps, maxSegmentSteps);
+    }
+    reached = v >= vmax;
+    table.period_us[table.size++] = 1000000000LL / v;
+    return table;
+  }
+
+  int32_t RampedMove::stepsFor(int32_t degrees, uint32_t factor) {
+    // A tie would need 200 * k == 180 mod 360; 64 bits past 83886 degrees at factor 128
+    int32_t steps = static_cast<int32_t>((std::abs(int64_t(degrees)) * STEPS_PER_REVOLUTION * factor + 180) / 360);
+    return degrees > 0 ? steps : -steps;
+  }
+
+  RampedMove::RampedMove(int32_t steps, const RampTable &table) : table_(table) {
+    dir_ = steps > 0 ? +1 : -1;
+    totalSteps_ = std::abs(steps);
+
+    if (!table_.roundedCut) {
+      // Whole ramp segments on both sides, the remainder cruises in the middle
+      cut_ = std::min<uint32_t>(table_.size, totalSteps_ / (2 * table_.segmentSteps));
+      midSteps_ = totalSteps_ - 2 * cut_ * table_.segmentSteps;
+    } else {
+      // Compute middle section size and profile cut point
+      int32_t midSegmentSize = static_cast<int32_t>(totalSteps_)
+                               - static_cast<int32_t>(table_.size * table_.segmentSteps * 2);
+      cut_ = midSegmentSize >= 0 //
+               ? table_.size //
+               : (totalSteps_ + table_.segmentSteps) / (2 * table_.segmentSteps);
+      midSteps_ = midSegmentSize > 0 ? midSegmentSize : 0;
+    }
+    midCount_ = (midSteps_ + maxSegmentSteps - 1) / maxSegmentSteps;
+    count_ = 2 * cut_ + midCount_;
+  }
+
+  // In IRAM: the step encoder and the segment preload call it from ISRs
+  SegmentData IRAM_ATTR RampedMove::at(uint16_t index) const {
+    // Ramp-up
+    if (index < cut_) {
+      return {.steps = static_cast<int32_t>(table_.segmentSteps) * dir_, .period_us = table_.period_us[index]};
+    }
+    // Optional middle segments, cruising at the last ramp-up period
+    if (index < cut_ + midCount_) {
+      uint32_t steps = index == cut_ ? middleHeadSteps() : maxSegmentSteps;
+      return {.steps = static_cast<int32_t>(steps) * dir_, .period_us = table_.period_us[cut_ ? cut_ - 1 : 0]};
+    }
+    // Ramp-down mirrors ramp-up
+    uint16_t mirror = count_ - 1 - index;
+    return {.steps = static_cast<int32_t>(table_.segmentSteps) * dir_, .period_us = table_.period_us[mirror]};
+  }
+
+  RampedMove RampedMove::rampDownFrom(uint16_t index) const {
+    // Ramp table entry the segment runs at
+    uint16_t level;
+    if (index < cut_) {
+      level = index;
+    } else if (index < cut_ + midCount_) {
+      level = cut_ ? cut_ - 1 : 0;
+    } else {
+      level = count_ - 1 - index;
+    }
+    // The ramp-down half of a plan cut at that level
+    RampedMove plan;
+    plan.table_ = table_;
+    plan.dir_ = dir_;
+    plan.cut_ = level;
+    plan.count_ = 2 * level;
+    plan.index_ = level;
+    plan.totalSteps_ = level * table_.segmentSteps;
+    return plan;
+  }
+
+  RampedMove RampedMove::stretched(uint32_t q16) const {
+    RampedMove plan = *this;
+    for (uint16_t i = 0; i < table_.size; ++i) {
+      uint64_t period = (uint64_t(table_.period_us[i]) * q16 + 0x8000) >> 16;
+      plan.table_.period_us[i] = static_cast<uint32_t>(std::min<uint64_t>(period, MAX_PERIOD_US));
+    }
     return plan;
   }
-}
\ No newline at end of file
+
+  uint64_t RampedMove::durationUs() const {
+    uint64_t duration = 0;
+    for (uint16_t i = 0; i < count_; ++i) {
+      SegmentData seg = at(i);
+      duration += uint64_t(std::abs(seg.steps)) * seg.period_us;
+    }
+    return duration;
+  }
+}
@@ -1,22 +1,107 @@
-#include "Common.hpp"
+#pragma once
+#include <array>
+#include <cstddef>
 #include <cstdint>
-#include <vector>
+
+#include "Common.hpp"
 
 namespace motor {
-  // const std::vector<float> profile = { //
-  //   1.0, 0.9, 0.6, 0.5
-  // };
-  const std::vector<float> profile = { //
-    1.000f, 0.992f, 0.968f, 0.931f, 0.883f, 0.826f, 0.763f, 0.697f,
-    0.633f, 0.571f, 0.514f, 0.466f, 0.429f, 0.402f, 0.382f, 0.250f
+  // Ramp profile in per-mille of BASE_PERIOD_US
+  inline constexpr std::array<uint16_t, 16> profile = { //
+    1000, 992, 968, 931, 883, 826, 763, 697, //
+    633, 571, 514, 466, 429, 402, 382, 250
   };
 
+  inline constexpr size_t kMaxRampSegments = 32;
+  static_assert(profile.size() <= kMaxRampSegments);
+
+  struct RampTable {
+      uint32_t segmentSteps;
+      uint16_t size;
+      std::array<uint32_t, kMaxRampSegments> period_us;
+      // Built-in profile: short moves are cut at the nearest whole ramp segment (not step exact)
+      bool roundedCut;
+  };
+
+  /**
+   * @brief Lazily evaluated segment plan of a single FIXED move
+   *
+   * The plan is ramp-up, optional cruise (middle) segments and mirrored ramp-down. The cruise is
+   * a head piece followed by as many maxSegmentSteps pieces as it takes. Nothing is materialized:
+   * segments are computed on demand from the move parameters and the ramp table.
+   */
   class RampedMove {
     public:
       static constexpr uint32_t stepsPerSegment = 20;
-      static std::vector<SegmentData> generateSegments(int32_t degrees, uint32_t factor);
+      static constexpr uint16_t maxFactor = 128;
+      // Longest segment the step counter can watch, a longer cruise is chained from pieces this long
+      static constexpr uint32_t maxSegmentSteps = INT16_MAX;
+
+      static constexpr RampTable makeRampTable(uint32_t factor) {
+        RampTable table {
+          .segmentSteps = stepsPerSegment * factor, .size = profile.size(), .period_us = {}, .roundedCut = true
+        };
+        for (size_t i = 0; i < profile.size(); ++i) {
+          // No ties possible: BASE_PERIOD_US * permille is never congruent to 500 mod 1000
+          table.period_us[i] = (BASE_PERIOD_US * profile[i] + 500) / 1000;
+        }
+        return table;
+      }
+      static RampTable rampTable(uint32_t factor);
+      static RampTable rampTable(const Kinematics &kinematics, uint32_t factor);
+      // Whether the ramp of these limits reaches max_velocity in segments the counter can watch, at any factor
+      static bool fits(const Kinematics &kinematics);
+
+      // Signed step count of a move, rounded to nearest
+      static int32_t stepsFor(int32_t degrees, uint32_t factor);
+
+      RampedMove() = default;
+      RampedMove(int32_t degrees, uint32_t factor) : RampedMove(degrees, factor, rampTable(factor)) {}
+      RampedMove(int32_t degrees, uint32_t factor, const RampTable &table)
+        : RampedMove(stepsFor(degrees, factor), table) {}
+      RampedMove(int32_t steps, const RampTable &table);
+      /**
+       * @brief Pull the next segment of the plan
+       * @return false if the plan is exhausted
+       */
+      bool next(SegmentData &seg) {
+        if (index_ >= count_) {
+          return false;
+        }
+        seg = at(index_++);
+        return true;
+      }
+      SegmentData at(uint16_t index) const;
+      uint16_t size() const { return count_; }
+      // Index of the segment next() returns next
+      uint16_t nextIndex() const { return index_; }
+      // Shortest legal stop from segment index: down the ramp table one entry per segment from its rate
+      RampedMove rampDownFrom(uint16_t index) const;
+      // Same plan with every period scaled by q16 / 65536, clamped to MAX_PERIOD_US
+      RampedMove stretched(uint32_t q16) const;
+      // Time the whole plan takes to run
+      uint64_t durationUs() const;
+      bool empty() const { return count_ == 0; }
+      uint32_t totalSteps() const { return totalSteps_; }
+      // Steps the segments add up to, short of totalSteps when the built-in profile cut rounds down
+      uint32_t plannedSteps() const { return 2 * cut_ * table_.segmentSteps + midSteps_; }
+      // Every segment of the plan is a ramp segment, the middle head or a maxSegmentSteps one
+      uint32_t rampSegmentSteps() const { return table_.segmentSteps; }
+      uint32_t middleSteps() const { return midSteps_; }
+      uint32_t middleHeadSteps() const { return midCount_ ? midSteps_ - (midCount_ - 1) * maxSegmentSteps : 0; }
+      bool chainedMiddle() const { return midCount_ > 1; }
+      const RampTable &rampTable() const { return table_; }
 
     private:
       static constexpr const char *TAG = "RampedMove";
+      static RampTable rampTable(const Kinematics &kinematics, uint32_t factor, bool &reached);
+      RampTable table_ {};
+      int32_t dir_ = +1;
+      uint32_t totalSteps_ = 0;
+      uint32_t midSteps_ = 0;
+      uint16_t cut_ = 0;
+      uint16_t midCount_ = 0;
+      uint16_t count_ = 0;
+      uint16_t index_ = 0;
   };
-}
\ No newline at end of file
+}
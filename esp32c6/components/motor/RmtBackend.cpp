@@ -0,0 +1,174 @@
+#include <esp_check.h>
+#include <esp_err.h>
+#include <esp_log.h>
+
+#include "MotorHal.hpp"
+#include "RmtBackend.hpp"
+
+namespace motor {
+
+  static size_t IRAM_ATTR rmt_step_encode_cb(
+    const void *data, //
+    size_t data_size,
+    size_t symbols_written,
+    size_t symbols_free,
+    rmt_symbol_word_t *symbols,
+    bool *done,
+    void *arg
+  ) {
+    StepEncoder *encoder = reinterpret_cast<StepEncoder *>(arg);
+    if (symbols_written == 0) {
+      encoder->reset(*reinterpret_cast<const RampedMove *>(data));
+    }
+    return encoder->encode(reinterpret_cast<StepSymbol *>(symbols), symbols_free, *done);
+  }
+
+  static bool IRAM_ATTR rmt_trans_done_cb(rmt_channel_handle_t, const rmt_tx_done_event_data_t *, void *ctx) {
+    RmtBackend *backend = reinterpret_cast<RmtBackend *>(ctx);
+    backend->onTransDoneISR();
+    return false;
+  }
+
+  esp_err_t RmtBackend::init(MotorHal *hal) {
+    hal_ = hal;
+    ESP_RETURN_ON_ERROR(pins_.init(), RmtBackend::TAG, "GPIO initialization failed");
+    ESP_RETURN_ON_ERROR(pins_.initStopper(), RmtBackend::TAG, "Stopper initialization failed");
+    rmt_simple_encoder_config_t step_encoder_cfg = {
+      .callback = rmt_step_encode_cb, //
+      .arg = &encoder_,
+      .min_chunk_size = 1
+    };
+    ESP_RETURN_ON_ERROR(
+      rmt_new_simple_encoder(&step_encoder_cfg, &step_encoder_), //
+      RmtBackend::TAG, //
+      "rmt_new_simple_encoder failed"
+    );
+    rmt_copy_encoder_config_t copy_encoder_cfg = {};
+    ESP_RETURN_ON_ERROR(
+      rmt_new_copy_encoder(&copy_encoder_cfg, &copy_encoder_), //
+      RmtBackend::TAG, //
+      "rmt_new_copy_encoder failed"
+    );
+    return ESP_OK;
+  }
+
+  esp_err_t RmtBackend::acquireChannel() {
+    if (channel_) {
+      return ESP_OK;
+    }
+    rmt_tx_channel_config_t channel_cfg = {};
+    channel_cfg.gpio_num = motor_cfg_.pins.m2;
+    channel_cfg.clk_src = RMT_CLK_SRC_DEFAULT;
+    channel_cfg.resolution_hz = StepEncoder::kResolutionHz;
+    channel_cfg.mem_block_symbols = RmtBackend::kMemBlockSymbols;
+    channel_cfg.trans_queue_depth = 1;
+    ESP_RETURN_ON_ERROR(
+      rmt_new_tx_channel(&channel_cfg, &channel_), //
+      RmtBackend::TAG, //
+      "rmt_new_tx_channel failed"
+    );
+    rmt_tx_event_callbacks_t cbs = {.on_trans_done = rmt_trans_done_cb};
+    ESP_RETURN_ON_ERROR(
+      rmt_tx_register_event_callbacks(channel_, &cbs, this), //
+      RmtBackend::TAG, //
+      "rmt_tx_register_event_callbacks failed"
+    );
+    ESP_RETURN_ON_ERROR(
+      rmt_enable(channel_), //
+      RmtBackend::TAG, //
+      "rmt_enable failed"
+    );
+    return ESP_OK;
+  }
+
+  esp_err_t RmtBackend::releaseChannel() {
+    if (!channel_) {
+      return ESP_OK;
+    }
+    active_.store(false);
+    ESP_RETURN_ON_ERROR(
+      rmt_disable(channel_), //
+      RmtBackend::TAG, //
+      "rmt_disable failed"
+    );
+    ESP_RETURN_ON_ERROR(
+      rmt_del_channel(channel_), //
+      RmtBackend::TAG, //
+      "rmt_del_channel failed"
+    );
+    channel_ = nullptr;
+    return ESP_OK;
+  }
+
+  esp_err_t RmtBackend::latchMode(uint8_t stepModeBits) {
+    // M2 is taken back from RMT for the mode pins, the channel gets created again for the next move
+    ESP_RETURN_ON_ERROR(releaseChannel(), RmtBackend::TAG, "RMT channel release failed");
+    return pins_.latchMode(stepModeBits, GPIO_MODE_OUTPUT);
+  }
+
+  esp_err_t RmtBackend::setDirection(bool forward) { return pins_.setDirection(forward); }
+
+  esp_err_t RmtBackend::setEnable(bool enable) { return pins_.setEnable(enable); }
+
+  esp_err_t RmtBackend::startPlan(const RampedMove &plan) {
+    ESP_RETURN_ON_ERROR(acquireChannel(), RmtBackend::TAG, "RMT channel acquire failed");
+    rmt_transmit_config_t tx_cfg = {};
+    tx_cfg.loop_count = 0;
+    tx_cfg.flags.eot_level = 0;
+    active_.store(true);
+    // The plan has to outlive the transmission, the encoder reads it from the TX ISR
+    esp_err_t err = rmt_transmit(channel_, step_encoder_, &plan, sizeof(plan), &tx_cfg);
+    if (err != ESP_OK) {
+      active_.store(false);
+    }
+    ESP_RETURN_ON_ERROR(err, RmtBackend::TAG, "rmt_transmit failed");
+    return ESP_OK;
+  }
+
+  esp_err_t RmtBackend::startPulses(uint32_t period_us) {
+    if (period_us == 0 || period_us > StepEncoder::kMaxPeriodUs) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    ESP_RETURN_ON_ERROR(acquireChannel(), RmtBackend::TAG, "RMT channel acquire failed");
+    free_symbol_ = StepEncoder::symbol(period_us);
+    rmt_transmit_config_t tx_cfg = {};
+    tx_cfg.loop_count = -1; // Until stopPulses
+    tx_cfg.flags.eot_level = 0;
+    ESP_RETURN_ON_ERROR(
+      rmt_transmit(channel_, copy_encoder_, &free_symbol_, sizeof(free_symbol_), &tx_cfg), //
+      RmtBackend::TAG, //
+      "rmt_transmit failed"
+    );
+    return ESP_OK;
+  }
+
+  esp_err_t RmtBackend::stopPulses() {
+    if (!channel_) {
+      return ESP_OK;
+    }
+    // Disabling aborts a transmission in flight and parks STEP at its idle level
+    active_.store(false);
+    ESP_RETURN_ON_ERROR(
+      rmt_disable(channel_), //
+      RmtBackend::TAG, //
+      "rmt_disable failed"
+    );
+    ESP_RETURN_ON_ERROR(
+      rmt_enable(channel_), //
+      RmtBackend::TAG, //
+      "rmt_enable failed"
+    );
+    return ESP_OK;
+  }
+
+  void IRAM_ATTR RmtBackend::onTransDoneISR() {
+    if (active_.exchange(false)) {
+      hal_->onStopISR();
+    }
+  }
+
+  esp_err_t RmtBackend::armStopper() { return pins_.armStopper(hal_); }
+
+  esp_err_t RmtBackend::disarmStopper() { return pins_.disarmStopper(); }
+
+} // namespace motor
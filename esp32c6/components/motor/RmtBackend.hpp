@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <driver/rmt_encoder.h>
+#include <driver/rmt_tx.h>
+
+#include "DriverPins.hpp"
+#include "MotorBackend.hpp"
+#include "StepEncoder.hpp"
+
+namespace motor {
+
+  /**
+   * @brief Step generation on RMT (STEP on M2), a whole FIXED move per transmission
+   *
+   * The step encoder streams one symbol per step from the plan, so a move runs without the CPU
+   * between segments and ends with the transmission done event. FREE runs loop a single symbol.
+   * There is no step counter: the segment methods of MotorBackend are not supported.
+   */
+  class RmtBackend : public MotorBackend {
+    public:
+      explicit RmtBackend(MotorCfg &motorConfig) : motor_cfg_(motorConfig), pins_(motorConfig.pins) {}
+      esp_err_t init(MotorHal *hal) override;
+      esp_err_t latchMode(uint8_t modeBits) override;
+      esp_err_t setDirection(bool forward) override;
+      esp_err_t setEnable(bool enable) override;
+      esp_err_t startPulses(uint32_t period_us) override;
+      esp_err_t pausePulses() override { return ESP_ERR_NOT_SUPPORTED; }
+      esp_err_t resumePulses() override { return ESP_ERR_NOT_SUPPORTED; }
+      esp_err_t setPeriod(uint32_t) override { return ESP_ERR_NOT_SUPPORTED; }
+      esp_err_t stopPulses() override;
+      void setPeriodFromISR(uint32_t) override {}
+      void pausePulsesFromISR() override {}
+      esp_err_t startCounter() override { return ESP_ERR_NOT_SUPPORTED; }
+      esp_err_t stopCounter() override { return ESP_ERR_NOT_SUPPORTED; }
+      esp_err_t clearCount() override { return ESP_ERR_NOT_SUPPORTED; }
+      esp_err_t addWatchPoint(int) override { return ESP_ERR_NOT_SUPPORTED; }
+      esp_err_t removeWatchPoint(int) override { return ESP_ERR_NOT_SUPPORTED; }
+      esp_err_t getCount(int &) override { return ESP_ERR_NOT_SUPPORTED; }
+      void clearCountFromISR() override {}
+      esp_err_t armStopper() override;
+      esp_err_t disarmStopper() override;
+      bool runsPlans() const override { return true; }
+      esp_err_t startPlan(const RampedMove &plan) override;
+      void onTransDoneISR();
+
+    private:
+      static constexpr const char *TAG = "RmtBackend";
+      static constexpr size_t kMemBlockSymbols = 48;
+      MotorCfg &motor_cfg_;
+      DriverPins pins_;
+      MotorHal *hal_ = nullptr;
+      rmt_channel_handle_t channel_ = nullptr;
+      rmt_encoder_handle_t step_encoder_ = nullptr;
+      rmt_encoder_handle_t copy_encoder_ = nullptr;
+      StepEncoder encoder_;
+      StepSymbol free_symbol_ {};
+      // A move is in flight: its done event is reported, the one of an aborted move is not
+      std::atomic<bool> active_ {false};
+      // The channel holds M2 from its creation until the next mode latch
+      esp_err_t acquireChannel();
+      esp_err_t releaseChannel();
+  };
+
+} // namespace motor
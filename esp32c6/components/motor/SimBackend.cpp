@@ -0,0 +1,264 @@
+#include <algorithm>
+
+#include "MotorHal.hpp"
+#include "SimBackend.hpp"
+
+namespace motor {
+
+  // Non-virtual like the ones of LedcPcntBackend, see MotorBackend::IsrOps
+  static void releasePulsesISR(MotorBackend &backend) {
+    static_cast<SimBackend &>(backend).SimBackend::releasePulsesFromISR();
+  }
+
+  static void setPeriodISR(MotorBackend &backend, uint32_t period_us) {
+    static_cast<SimBackend &>(backend).SimBackend::setPeriodFromISR(period_us);
+  }
+
+  static void pausePulsesISR(MotorBackend &backend) {
+    static_cast<SimBackend &>(backend).SimBackend::pausePulsesFromISR();
+  }
+
+  static esp_err_t getCountISR(MotorBackend &backend, int &count) {
+    return static_cast<SimBackend &>(backend).SimBackend::getCount(count);
+  }
+
+  static void clearCountISR(MotorBackend &backend) {
+    static_cast<SimBackend &>(backend).SimBackend::clearCountFromISR();
+  }
+
+  esp_err_t SimBackend::init(MotorHal *hal) {
+    std::lock_guard lock(mutex_);
+    hal_ = hal;
+    isr_ops_ = {
+      .releasePulses = releasePulsesISR,
+      .setPeriod = setPeriodISR,
+      .pausePulses = pausePulsesISR,
+      .getCount = getCountISR,
+      .clearCount = clearCountISR,
+    };
+    return ESP_OK;
+  }
+
+  esp_err_t SimBackend::latchMode(uint8_t modeBits) {
+    {
+      std::lock_guard lock(mutex_);
+      latched_mode_ = modeBits;
+      mode_latches_++;
+      enabled_ = false;
+    }
+    // STBY sequence busy-waits on the real driver
+    advance(kModeLatchUs);
+    return ESP_OK;
+  }
+
+  esp_err_t SimBackend::setDirection(bool forward) {
+    std::lock_guard lock(mutex_);
+    forward_ = forward;
+    return ESP_OK;
+  }
+
+  esp_err_t SimBackend::setEnable(bool enable) {
+    std::lock_guard lock(mutex_);
+    enabled_ = enable;
+    return ESP_OK;
+  }
+
+  esp_err_t SimBackend::startPulses(uint32_t period_us) {
+    if (period_us == 0) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard lock(mutex_);
+    period_us_ = period_us;
+    pending_period_us_ = 0;
+    next_step_us_ = now_us_;
+    pulsing_ = true;
+    return ESP_OK;
+  }
+
+  // Armed as if paused right before its first step
+  esp_err_t SimBackend::armPulses(uint32_t period_us) {
+    if (period_us == 0) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard lock(mutex_);
+    period_us_ = period_us;
+    pending_period_us_ = 0;
+    paused_remaining_us_ = 0;
+    pulsing_ = false;
+    return ESP_OK;
+  }
+
+  void SimBackend::releasePulsesFromISR() { resumePulses(); }
+
+  esp_err_t SimBackend::pausePulses() {
+    pausePulsesFromISR();
+    return ESP_OK;
+  }
+
+  esp_err_t SimBackend::resumePulses() {
+    std::lock_guard lock(mutex_);
+    if (!pulsing_ && period_us_) {
+      next_step_us_ = now_us_ + paused_remaining_us_;
+      pulsing_ = true;
+    }
+    return ESP_OK;
+  }
+
+  esp_err_t SimBackend::setPeriod(uint32_t period_us) {
+    setPeriodFromISR(period_us);
+    return ESP_OK;
+  }
+
+  esp_err_t SimBackend::stopPulses() {
+    std::lock_guard lock(mutex_);
+    pulsing_ = false;
+    period_us_ = 0;
+    pending_period_us_ = 0;
+    return ESP_OK;
+  }
+
+  void SimBackend::setPeriodFromISR(uint32_t period_us) {
+    std::lock_guard lock(mutex_);
+    pending_period_us_ = period_us;
+  }
+
+  void SimBackend::pausePulsesFromISR() {
+    std::lock_guard lock(mutex_);
+    if (pulsing_) {
+      paused_remaining_us_ = next_step_us_ - now_us_;
+      pulsing_ = false;
+    }
+  }
+
+  esp_err_t SimBackend::startCounter() {
+    std::lock_guard lock(mutex_);
+    counting_ = true;
+    return ESP_OK;
+  }
+
+  esp_err_t SimBackend::stopCounter() {
+    std::lock_guard lock(mutex_);
+    counting_ = false;
+    return ESP_OK;
+  }
+
+  esp_err_t SimBackend::clearCount() {
+    clearCountFromISR();
+    return ESP_OK;
+  }
+
+  esp_err_t SimBackend::addWatchPoint(int value) {
+    std::lock_guard lock(mutex_);
+    if (value > kCounterHighLimit || std::count(watch_points_.begin(), watch_points_.end(), value)) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    watch_points_.push_back(value);
+    return ESP_OK;
+  }
+
+  esp_err_t SimBackend::removeWatchPoint(int value) {
+    std::lock_guard lock(mutex_);
+    auto it = std::find(watch_points_.begin(), watch_points_.end(), value);
+    if (it == watch_points_.end()) {
+      return ESP_ERR_INVALID_STATE;
+    }
+    watch_points_.erase(it);
+    return ESP_OK;
+  }
+
+  esp_err_t SimBackend::getCount(int &count) {
+    std::lock_guard lock(mutex_);
+    count = count_;
+    return ESP_OK;
+  }
+
+  void SimBackend::clearCountFromISR() {
+    std::lock_guard lock(mutex_);
+    count_ = 0;
+  }
+
+  esp_err_t SimBackend::armStopper() {
+    std::lock_guard lock(mutex_);
+    stopper_armed_ = true;
+    return ESP_OK;
+  }
+
+  esp_err_t SimBackend::disarmStopper() {
+    std::lock_guard lock(mutex_);
+    stopper_armed_ = false;
+    return ESP_OK;
+  }
+
+  void SimBackend::emitStep() {
+    now_us_ = next_step_us_;
+    // Period written during the previous pulse is latched at this one
+    if (pending_period_us_) {
+      period_us_ = pending_period_us_;
+      pending_period_us_ = 0;
+    }
+    next_step_us_ = now_us_ + period_us_;
+    steps_.push_back({.t_us = now_us_, .forward = forward_, .enabled = enabled_});
+    if (!counting_) {
+      return;
+    }
+    count_++;
+    if (std::count(watch_points_.begin(), watch_points_.end(), count_)) {
+      hal_->onReachISR(count_);
+    }
+    if (count_ >= kCounterHighLimit) {
+      count_ = 0;
+    }
+  }
+
+  void SimBackend::advance(int64_t duration_us) {
+    std::lock_guard lock(mutex_);
+    int64_t until_us = now_us_ + duration_us;
+    while (pulsing_ && next_step_us_ <= until_us) {
+      emitStep();
+    }
+    now_us_ = until_us;
+  }
+
+  void SimBackend::triggerStopper() {
+    std::lock_guard lock(mutex_);
+    if (stopper_armed_) {
+      hal_->onStopperISR();
+    }
+  }
+
+  int64_t SimBackend::now() {
+    std::lock_guard lock(mutex_);
+    return now_us_;
+  }
+
+  std::vector<SimBackend::Step> SimBackend::steps() {
+    std::lock_guard lock(mutex_);
+    return steps_;
+  }
+
+  void SimBackend::clearSteps() {
+    std::lock_guard lock(mutex_);
+    steps_.clear();
+  }
+
+  uint8_t SimBackend::latchedMode() {
+    std::lock_guard lock(mutex_);
+    return latched_mode_;
+  }
+
+  uint32_t SimBackend::modeLatches() {
+    std::lock_guard lock(mutex_);
+    return mode_latches_;
+  }
+
+  uint32_t SimBackend::periodUs() {
+    std::lock_guard lock(mutex_);
+    return period_us_;
+  }
+
+  bool SimBackend::enabled() {
+    std::lock_guard lock(mutex_);
+    return enabled_;
+  }
+
+} // namespace motor
@@ -0,0 +1,87 @@
+#pragma once
+#include <mutex>
+#include <vector>
+
+#include "MotorBackend.hpp"
+
+namespace motor {
+
+  /**
+   * @brief Virtual-time simulator of the LEDC + PCNT + TC78H670 setup for the Linux target
+   *
+   * Nothing happens on its own: the harness moves virtual time forward with advance(), which emits
+   * the due steps, counts them, fires watch point events into MotorHal and records every step.
+   * Like LEDC, a new period is latched at the next pulse. advance() and triggerStopper() deliver
+   * events the way ISRs would, so they have to be called from a FreeRTOS task.
+   */
+  class SimBackend : public MotorBackend {
+    public:
+      struct Step {
+          int64_t t_us;
+          bool forward;
+          bool enabled;
+      };
+      static constexpr int kCounterHighLimit = INT16_MAX;
+      static constexpr int64_t kModeLatchUs = 900;
+
+      explicit SimBackend(MotorCfg &) {}
+      esp_err_t init(MotorHal *hal) override;
+      esp_err_t latchMode(uint8_t modeBits) override;
+      esp_err_t setDirection(bool forward) override;
+      esp_err_t setEnable(bool enable) override;
+      esp_err_t startPulses(uint32_t period_us) override;
+      esp_err_t armPulses(uint32_t period_us) override;
+      void releasePulsesFromISR() override;
+      esp_err_t pausePulses() override;
+      esp_err_t resumePulses() override;
+      esp_err_t setPeriod(uint32_t period_us) override;
+      esp_err_t stopPulses() override;
+      void setPeriodFromISR(uint32_t period_us) override;
+      void pausePulsesFromISR() override;
+      esp_err_t startCounter() override;
+      esp_err_t stopCounter() override;
+      esp_err_t clearCount() override;
+      esp_err_t addWatchPoint(int value) override;
+      esp_err_t removeWatchPoint(int value) override;
+      esp_err_t getCount(int &count) override;
+      void clearCountFromISR() override;
+      esp_err_t armStopper() override;
+      esp_err_t disarmStopper() override;
+
+      // -- Virtual time control
+      void advance(int64_t duration_us);
+      void triggerStopper();
+      int64_t now();
+      std::vector<Step> steps();
+      void clearSteps();
+      uint8_t latchedMode();
+      uint32_t modeLatches();
+      uint32_t periodUs();
+      bool enabled();
+
+    private:
+      MotorHal *hal_ = nullptr;
+      std::recursive_mutex mutex_;
+      int64_t now_us_ = 0;
+      // -- TC78H670
+      uint8_t latched_mode_ = 0;
+      uint32_t mode_latches_ = 0;
+      bool forward_ = true;
+      bool enabled_ = false;
+      // -- LEDC
+      bool pulsing_ = false;
+      uint32_t period_us_ = 0;
+      uint32_t pending_period_us_ = 0;
+      int64_t next_step_us_ = 0;
+      int64_t paused_remaining_us_ = 0;
+      // -- PCNT
+      bool counting_ = false;
+      int count_ = 0;
+      std::vector<int> watch_points_;
+      // -- Stopper
+      bool stopper_armed_ = false;
+      std::vector<Step> steps_;
+      void emitStep();
+  };
+
+} // namespace motor
@@ -0,0 +1,28 @@
+#include <cstdlib>
+#include <esp_attr.h>
+
+#include "StepEncoder.hpp"
+
+namespace motor {
+
+  size_t IRAM_ATTR StepEncoder::encode(StepSymbol *symbols, size_t capacity, bool &done) {
+    size_t written = 0;
+    while (written < capacity) {
+      if (!left_) {
+        if (!plan_ || index_ >= plan_->size()) {
+          break;
+        }
+        SegmentData seg = plan_->at(index_++);
+        left_ = std::abs(seg.steps);
+        symbol_ = symbol(seg.period_us);
+      }
+      size_t n = std::min<size_t>(left_, capacity - written);
+      std::fill_n(symbols + written, n, symbol_);
+      written += n;
+      left_ -= n;
+    }
+    done = !left_ && (!plan_ || index_ >= plan_->size());
+    return written;
+  }
+
+} // namespace motor
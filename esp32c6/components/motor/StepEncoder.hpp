@@ -0,0 +1,62 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "Common.hpp"
+#include "RampedMove.hpp"
+
+namespace motor {
+  // One STEP pulse, same layout as rmt_symbol_word_t
+  struct StepSymbol {
+      uint16_t duration0 : 15;
+      uint16_t level0 : 1;
+      uint16_t duration1 : 15;
+      uint16_t level1 : 1;
+  };
+  static_assert(sizeof(StepSymbol) == 4);
+
+  /**
+   * @brief Streams a FIXED move plan as one symbol per step
+   *
+   * Each step gets the period of its plan segment, so the emitted step train is exactly the
+   * planner output. Encoding is resumable: the RMT engine refills its symbol memory chunk by chunk
+   * from the TX ISR while the move runs.
+   */
+  class StepEncoder {
+    public:
+      // One tick per microsecond, like SegmentData::period_us
+      static constexpr uint32_t kResolutionHz = 1000000;
+      static constexpr uint32_t kMaxPeriodUs = 0x7FFF;
+      static_assert(BASE_PERIOD_US <= kMaxPeriodUs);
+
+      // High for 12.5% of the period, like the LEDC engine
+      static constexpr StepSymbol symbol(uint32_t period_us) {
+        uint32_t high = std::max<uint32_t>(1, period_us / 8);
+        return {
+          .duration0 = static_cast<uint16_t>(high),
+          .level0 = 1,
+          .duration1 = static_cast<uint16_t>(period_us - high),
+          .level1 = 0
+        };
+      }
+
+      void reset(const RampedMove &plan) {
+        plan_ = &plan;
+        index_ = 0;
+        left_ = 0;
+      }
+      /**
+       * @brief Write up to capacity symbols of the remaining steps
+       * @param done Set once the last step of the plan has been written
+       * @return Number of symbols written
+       */
+      size_t encode(StepSymbol *symbols, size_t capacity, bool &done);
+
+    private:
+      const RampedMove *plan_ = nullptr;
+      uint16_t index_ = 0;
+      uint32_t left_ = 0;
+      StepSymbol symbol_ {};
+  };
+} // namespace motor
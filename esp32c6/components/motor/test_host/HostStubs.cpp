@@ -0,0 +1,210 @@
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <esp_timer.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <map>
+#include <mutex>
+#include <nvs.h>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "HostTest.hpp"
+
+// -- Critical sections
+
+static std::recursive_mutex critical;
+
+void vPortEnterCritical() { critical.lock(); }
+
+void vPortExitCritical() { critical.unlock(); }
+
+// -- Tasks and their notification counts
+
+struct tskTaskControlBlock {
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint32_t count = 0;
+};
+
+static std::mutex tasks_mutex;
+// Made by xTaskCreate: the simulator rigs register handles of their own, never dereferenced
+static std::set<TaskHandle_t> tasks;
+static thread_local TaskHandle_t current_task = nullptr;
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *, uint32_t, void *arg, UBaseType_t, TaskHandle_t *created) {
+  TaskHandle_t task = new tskTaskControlBlock;
+  {
+    std::lock_guard lock(tasks_mutex);
+    tasks.insert(task);
+  }
+  if (created) {
+    *created = task;
+  }
+  std::thread([fn, arg, task] {
+    current_task = task;
+    fn(arg);
+  }).detach();
+  return pdPASS;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  {
+    std::lock_guard lock(tasks_mutex);
+    if (!tasks.count(task)) {
+      return pdPASS;
+    }
+  }
+  std::lock_guard lock(task->mutex);
+  task->count++;
+  task->cv.notify_all();
+  return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken) {
+  ++host_test::notifications;
+  xTaskNotifyGive(task);
+  *higherPriorityTaskWoken = pdFALSE;
+}
+
+// The timeout runs on the esp_timer clock, which only moves when the test moves it
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait) {
+  TaskHandle_t task = current_task;
+  int64_t deadline_us = host_test::clock_us + int64_t(ticksToWait) * portTICK_PERIOD_MS * 1000;
+  std::unique_lock lock(task->mutex);
+  while (!task->count) {
+    if (ticksToWait != portMAX_DELAY && host_test::clock_us >= deadline_us) {
+      return 0;
+    }
+    task->cv.wait_for(lock, std::chrono::microseconds(50));
+  }
+  uint32_t count = task->count;
+  task->count = clearCountOnExit ? 0 : count - 1;
+  return count;
+}
+
+// -- Binary semaphores
+
+struct QueueDefinition {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool given = false;
+};
+
+SemaphoreHandle_t xSemaphoreCreateBinary() { return new QueueDefinition; }
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  std::lock_guard lock(semaphore->mutex);
+  semaphore->given = true;
+  semaphore->cv.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait) {
+  std::unique_lock lock(semaphore->mutex);
+  if (ticksToWait) {
+    semaphore->cv.wait(lock, [semaphore] { return semaphore->given; });
+  }
+  bool given = semaphore->given;
+  semaphore->given = false;
+  return given ? pdTRUE : pdFALSE;
+}
+
+// -- esp_timer
+
+struct esp_timer {
+    esp_timer_create_args_t args;
+    int64_t due_us; // 0 when not started
+};
+
+static std::mutex timers_mutex;
+static std::vector<esp_timer *> timers;
+
+int64_t esp_timer_get_time() { return host_test::clock_us; }
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out) {
+  std::lock_guard lock(timers_mutex);
+  timers.push_back(new esp_timer {.args = *args, .due_us = 0});
+  *out = timers.back();
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+  std::lock_guard lock(timers_mutex);
+  if (timer->due_us) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->due_us = host_test::clock_us + static_cast<int64_t>(timeout_us);
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  std::lock_guard lock(timers_mutex);
+  if (!timer->due_us) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->due_us = 0;
+  return ESP_OK;
+}
+
+void host_test::setClock(int64_t now_us) {
+  clock_us = now_us;
+  std::vector<esp_timer *> due;
+  {
+    std::lock_guard lock(timers_mutex);
+    for (esp_timer *timer : timers) {
+      if (timer->due_us && timer->due_us <= now_us) {
+        timer->due_us = 0;
+        due.push_back(timer);
+      }
+    }
+  }
+  for (esp_timer *timer : due) {
+    timer->args.callback(timer->args.arg);
+  }
+}
+
+// -- NVS, a single namespace is enough for the motor component
+
+static std::mutex nvs_mutex;
+static std::map<std::string, std::vector<uint8_t>> nvs;
+
+esp_err_t nvs_open(const char *, nvs_open_mode_t, nvs_handle_t *out) {
+  *out = 1;
+  return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t, const char *key, void *out, size_t *length) {
+  std::lock_guard lock(nvs_mutex);
+  auto it = nvs.find(key);
+  if (it == nvs.end()) {
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  if (out) {
+    if (*length < it->second.size()) {
+      return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(out, it->second.data(), it->second.size());
+  }
+  *length = it->second.size();
+  return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t, const char *key, const void *value, size_t length) {
+  std::lock_guard lock(nvs_mutex);
+  const uint8_t *bytes = static_cast<const uint8_t *>(value);
+  nvs[key].assign(bytes, bytes + length);
+  return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t, const char *key) {
+  std::lock_guard lock(nvs_mutex);
+  return nvs.erase(key) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_commit(nvs_handle_t) { return ESP_OK; }
+
+void nvs_close(nvs_handle_t) {}
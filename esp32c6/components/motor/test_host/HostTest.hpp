@@ -0,0 +1,37 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+// Checks for the host tests: a failure is printed and counted, main returns host_test::result()
+namespace host_test {
+  inline int failures = 0;
+  // Returned by esp_timer_get_time
+  inline std::atomic<int64_t> clock_us = 0;
+  // Task notifications given from ISRs
+  inline std::atomic<uint32_t> notifications = 0;
+  // Moves clock_us on to now_us and runs the esp_timer callbacks due by then, see HostStubs.cpp
+  void setClock(int64_t now_us);
+
+  inline bool check(bool ok, const char *expr, const char *file, int line) {
+    if (!ok && ++failures <= 20) {
+      std::printf("%s:%d: CHECK(%s) failed\n", file, line, expr);
+    }
+    return ok;
+  }
+
+  inline bool checkEq(long long a, long long b, const char *expr, const char *file, int line) {
+    if (a != b && ++failures <= 20) {
+      std::printf("%s:%d: CHECK_EQ(%s) failed: %lld != %lld\n", file, line, expr, a, b);
+    }
+    return a == b;
+  }
+
+  inline int result() {
+    std::printf("%s: %d failure(s)\n", failures ? "FAILED" : "OK", failures);
+    return failures ? 1 : 0;
+  }
+} // namespace host_test
+
+#define CHECK(cond) host_test::check((cond), #cond, __FILE__, __LINE__)
+#define CHECK_EQ(a, b) host_test::checkEq((long long)(a), (long long)(b), #a ", " #b, __FILE__, __LINE__)
@@ -0,0 +1,97 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "HostTest.hpp"
+#include "Motor.hpp"
+#include "SimBackend.hpp"
+
+/**
+ * @brief Motor::instance() on the simulator backend, its task on a thread of its own
+ *
+ * Another thread plays the ISRs: it moves the simulator and the esp_timer clock on by kTickUs at a
+ * time, in a critical section like an interrupt on the single core. The motor task only sees that
+ * virtual time, as fast as the host runs it.
+ */
+class MotorRig {
+  public:
+    static constexpr int64_t kTickUs = 50;
+    // Real time a wait gives up after
+    static constexpr auto kTimeout = std::chrono::seconds(20);
+    motor::Motor &motor = motor::Motor::instance();
+    motor::SimBackend *sim = nullptr;
+    // Records popped from the completion FIFO so far, in order
+    std::vector<motor::MoveCompletion> done;
+
+    MotorRig() {
+      CHECK_EQ(motor.init(), ESP_OK);
+      sim = static_cast<motor::SimBackend *>(&motor.hal().backend());
+      isr_ = std::thread([this] {
+        portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+        while (running_.load(std::memory_order_relaxed)) {
+          portENTER_CRITICAL(&mux);
+          sim->advance(kTickUs);
+          host_test::setClock(sim->now());
+          portEXIT_CRITICAL(&mux);
+          std::this_thread::yield();
+        }
+      });
+    }
+
+    ~MotorRig() {
+      running_ = false;
+      isr_.join();
+    }
+
+    // Pops the completion records until pred(), false when it does not come true in time
+    template <typename Pred> bool waitUntil(Pred &&pred) {
+      auto deadline = std::chrono::steady_clock::now() + kTimeout;
+      for (;;) {
+        motor::MoveCompletion record;
+        while (motor.popCompletion(record)) {
+          done.push_back(record);
+        }
+        if (pred()) {
+          return true;
+        }
+        if (std::chrono::steady_clock::now() > deadline) {
+          return false;
+        }
+        std::this_thread::yield();
+      }
+    }
+
+    /**
+     * @brief Waits until everything submitted so far is run or flushed
+     *
+     * A DWELL without delay goes in behind it: its record is the last one once the task got to it.
+     */
+    bool drain() {
+      motor::Move marker {.move_type = motor::MoveType::DWELL};
+      if (!CHECK_EQ(motor.submit(marker), ESP_OK)) {
+        return false;
+      }
+      motor::MotorCmdId id = motor.lastQueuedId();
+      return CHECK(waitUntil([this, id] { return !done.empty() && done.back().id == id; }));
+    }
+
+    // Waits until the simulator has emitted count steps in all
+    bool waitSteps(size_t count) {
+      return CHECK(waitUntil([this, count] { return sim->steps().size() >= count; }));
+    }
+
+    // Net steps emitted so far, forward positive
+    int64_t netSteps() {
+      int64_t net = 0;
+      for (const motor::SimBackend::Step &step : sim->steps()) {
+        net += step.forward ? 1 : -1;
+      }
+      return net;
+    }
+
+  private:
+    std::atomic<bool> running_ {true};
+    std::thread isr_;
+};
@@ -0,0 +1,43 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "Common.hpp"
+
+// The float planner RampedMove replaced, kept as the reference its plans are checked against
+namespace reference {
+  inline const std::vector<float> profile = { //
+    1.000f, 0.992f, 0.968f, 0.931f, 0.883f, 0.826f, 0.763f, 0.697f,
+    0.633f, 0.571f, 0.514f, 0.466f, 0.429f, 0.402f, 0.382f, 0.250f
+  };
+  inline constexpr uint32_t stepsPerSegment = 20;
+
+  inline std::vector<motor::SegmentData> generateSegments(int32_t degrees, uint32_t factor) {
+    using motor::SegmentData;
+    int32_t dir = degrees > 0 ? +1 : -1;
+    uint32_t totalSteps = std::round(std::abs(degrees) * motor::STEPS_PER_REVOLUTION * factor / 360.0f);
+
+    int32_t midSegmentSize = static_cast<int32_t>(totalSteps)
+                             - static_cast<int32_t>(profile.size() * stepsPerSegment * factor * 2);
+    size_t profileCutPoint = midSegmentSize >= 0 //
+                               ? profile.size() //
+                               : static_cast<size_t>(std::round(totalSteps / 2.0f / stepsPerSegment / factor));
+
+    std::vector<SegmentData> start;
+    for (size_t i = 0; i < profileCutPoint; ++i) {
+      start.push_back({
+        .steps = static_cast<int32_t>(stepsPerSegment * factor) * dir,
+        .period_us = static_cast<uint32_t>(std::round(motor::BASE_PERIOD_US * profile[i])),
+      });
+    }
+    std::vector<SegmentData> end(start.rbegin(), start.rend());
+
+    std::vector<SegmentData> plan = start;
+    if (midSegmentSize > 0) {
+      plan.push_back({.steps = midSegmentSize * dir, .period_us = end.front().period_us});
+    }
+    plan.insert(plan.end(), end.begin(), end.end());
+    return plan;
+  }
+} // namespace reference
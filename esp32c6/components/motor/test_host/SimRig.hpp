@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdlib>
+#include <memory>
+
+#include "HostTest.hpp"
+#include "MotorHal.hpp"
+#include "SimBackend.hpp"
+
+// One axis on a simulator backend, driven the way the motor task drives MotorHal
+template <typename Sim> struct BasicSimRig {
+    motor::MotorCfg cfg;
+    Sim *sim;
+    motor::MotorHal hal;
+    uint32_t wakeups = 0; // Task wake-ups of the last runFixed
+
+    BasicSimRig(motor::SegmentSwitch segmentSwitch, uint16_t factor, motor::Kinematics kinematics = {})
+      : cfg {.stepMode = motor::StepMode(), .pins = {}, .segmentSwitch = segmentSwitch, .kinematics = kinematics},
+        hal(cfg, makeSim(cfg, sim)) {
+      cfg.stepMode.setFactor(factor);
+      hal.init();
+      hal.registerTaskHandle(reinterpret_cast<TaskHandle_t>(this));
+    }
+
+    /**
+     * @brief Runs a FIXED move to its end, the task handling each notification lag_us after it
+     * @return Whether the move ended within the step budget
+     */
+    bool runFixed(int32_t steps, int64_t lag_us = 10) {
+      // The direction is taken from the sign of degrees
+      motor::Move mv {.degrees = steps < 0 ? -1 : +1};
+      if (hal.startMove(mv, 1, steps) != ESP_OK) {
+        return false;
+      }
+      host_test::notifications = 0;
+      wakeups = 0;
+      bool done = false;
+      // Generous for the slowest step rate
+      for (int64_t budget_us = (std::abs(int64_t(steps)) + 1) * 2 * motor::BASE_PERIOD_US; !done && budget_us > 0; budget_us -= lag_us) {
+        sim->advance(lag_us);
+        if (host_test::notifications) {
+          host_test::notifications = 0;
+          wakeups++;
+          done = hal.nextSegment();
+        }
+      }
+      hal.stopMove();
+      return done;
+    }
+
+    // Net steps emitted so far, forward positive
+    int64_t netSteps() {
+      int64_t net = 0;
+      for (const motor::SimBackend::Step &step : sim->steps()) {
+        net += step.forward ? 1 : -1;
+      }
+      return net;
+    }
+
+  private:
+    static std::unique_ptr<motor::MotorBackend> makeSim(motor::MotorCfg &cfg, Sim *&sim) {
+      auto backend = std::make_unique<Sim>(cfg);
+      sim = backend.get();
+      return backend;
+    }
+};
+
+using SimRig = BasicSimRig<motor::SimBackend>;
@@ -0,0 +1,48 @@
+#include <chrono>
+#include <cstdio>
+
+#include "RampedMove.hpp"
+#include "ReferencePlanner.hpp"
+
+using namespace motor;
+
+// Plan time of the integer planner against the float one it replaced, every angle up to a turn
+template <typename F> static double nsPerPlan(F &&plan) {
+  constexpr int kRounds = 20;
+  uint64_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < kRounds; ++round) {
+    for (uint32_t factor = 1; factor <= RampedMove::maxFactor; factor *= 2) {
+      for (int32_t degrees = -360; degrees <= 360; ++degrees) {
+        sink += plan(degrees, factor);
+      }
+    }
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  std::printf("  (checksum %llu)\n", static_cast<unsigned long long>(sink));
+  return elapsed.count() / (kRounds * 8 * 721);
+}
+
+int main() {
+  double floats = nsPerPlan([](int32_t degrees, uint32_t factor) {
+    uint64_t sum = 0;
+    for (const SegmentData &seg : reference::generateSegments(degrees, factor)) {
+      sum += seg.period_us;
+    }
+    return sum;
+  });
+  double integers = nsPerPlan([](int32_t degrees, uint32_t factor) {
+    uint64_t sum = 0;
+    RampedMove plan(degrees, factor);
+    SegmentData seg;
+    while (plan.next(seg)) {
+      sum += seg.period_us;
+    }
+    return sum;
+  });
+  // The host has an FPU: on the C6 every float operation of the reference is a soft-float call
+  std::printf("float planner   %8.1f ns/plan\n", floats);
+  std::printf("integer planner %8.1f ns/plan\n", integers);
+  std::printf("speedup         %8.2fx\n", floats / integers);
+  return 0;
+}
@@ -0,0 +1,3 @@
+#pragma once
+// Host stand-in for the IDF header: everything runs from RAM
+#define IRAM_ATTR
@@ -0,0 +1,19 @@
+#pragma once
+// Host stand-in for the IDF header, without the logging
+#include "esp_err.h"
+#include "esp_log.h"
+
+#define ESP_RETURN_ON_ERROR(x, log_tag, format, ...) \
+  do { \
+    esp_err_t err_rc_ = (x); \
+    if (err_rc_ != ESP_OK) { \
+      return err_rc_; \
+    } \
+  } while (0)
+
+#define ESP_RETURN_ON_FALSE(a, err_code, log_tag, format, ...) \
+  do { \
+    if (!(a)) { \
+      return err_code; \
+    } \
+  } while (0)
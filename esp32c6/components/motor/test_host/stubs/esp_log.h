@@ -0,0 +1,6 @@
+#pragma once
+// Host stand-in for the IDF header: logging compiles away
+#define ESP_LOGE(tag, format, ...) (void)(tag)
+#define ESP_LOGW(tag, format, ...) (void)(tag)
+#define ESP_LOGI(tag, format, ...) (void)(tag)
+#define ESP_LOGD(tag, format, ...) (void)(tag)
@@ -0,0 +1,28 @@
+#pragma once
+// Host stand-in for the FreeRTOS types the motor component uses: tasks are threads, see HostStubs.cpp
+#include <cstdint>
+
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+typedef struct tskTaskControlBlock *TaskHandle_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xFFFFFFFFu
+#define portTICK_PERIOD_MS 1
+#define configMAX_TASK_NAME_LEN 16
+#define portYIELD_FROM_ISR(x) (void)(x)
+
+// One core: a critical section holds off the other tasks and the ISRs, whatever the lock
+typedef struct {
+    int owner;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+void vPortEnterCritical();
+void vPortExitCritical();
+#define portENTER_CRITICAL(mux) ((void)(mux), vPortEnterCritical())
+#define portEXIT_CRITICAL(mux) ((void)(mux), vPortExitCritical())
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux) portEXIT_CRITICAL(mux)
@@ -0,0 +1,13 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+
+// Starts fn on a thread of its own, stack size and priority are ignored
+BaseType_t xTaskCreate(
+  TaskFunction_t fn, const char *name, uint32_t stackDepth, void *arg, UBaseType_t priority, TaskHandle_t *created
+);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken);
+// Timeouts are in ticks of the esp_timer clock, 1 ms each
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait);
@@ -0,0 +1,7 @@
+#pragma once
+// Host build: the component's Linux target with its Kconfig defaults
+#define CONFIG_IDF_TARGET_LINUX 1
+#define CONFIG_MOTOR_AXIS_COUNT 1
+// Traced, for test_motion_trace
+#define CONFIG_MOTOR_TRACE 1
+#define CONFIG_MOTOR_TRACE_DEPTH 256
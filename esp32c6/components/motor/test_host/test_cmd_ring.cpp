@@ -0,0 +1,118 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "CmdRing.hpp"
+#include "HostTest.hpp"
+
+using namespace motor;
+
+struct Item {
+    uint32_t producer;
+    uint32_t seq; // Per producer, from 0
+    uint32_t index; // In its batch
+    uint32_t size; // Of its batch
+};
+
+// A batch goes in whole or not at all, the ring never holds more than N
+static void testBatchesAreAllOrNothing() {
+  CmdRing<Item, 8> ring;
+  Item items[9] {};
+  CHECK(ring.push(items, 0));
+  CHECK(!ring.push(items, 9));
+  CHECK(ring.push(items, 5));
+  CHECK(!ring.push(items, 4));
+  CHECK(ring.push(items, 3));
+  CHECK(!ring.push(items, 1));
+  Item out;
+  for (int i = 0; i < 8; ++i) {
+    CHECK(ring.pop(out));
+  }
+  CHECK(!ring.pop(out));
+  CHECK(ring.push(items, 8));
+}
+
+// flush() drops what was queued before it, peek() and take() see it too
+static void testFlush() {
+  CmdRing<Item, 8> ring;
+  Item items[3] = {{.seq = 0}, {.seq = 1}, {.seq = 2}};
+  Item out;
+  CHECK(ring.push(items, 3));
+  CHECK(ring.peek(out));
+  ring.flush();
+  CHECK(!ring.take());
+  CHECK(!ring.pop(out));
+  CHECK(ring.push(items + 1, 2));
+  CHECK(ring.pop(out) && out.seq == 1);
+  CHECK(ring.peek(out) && out.seq == 2);
+  CHECK(ring.take());
+  CHECK(!ring.peek(out));
+  // Flushed slots are free again
+  CHECK(ring.push(3, [](size_t i) { return Item {.seq = uint32_t(i)}; }));
+  ring.flush();
+  CHECK(ring.push(3, [](size_t i) { return Item {.seq = uint32_t(10 + i)}; }));
+  CHECK(ring.pop(out) && out.seq == 10);
+}
+
+// Producers racing on a small ring: nothing lost or duplicated, each producer's order kept, batches never split
+static void testProducersRace() {
+  constexpr uint32_t kProducers = 4;
+  constexpr uint32_t kItems = 200000;
+  CmdRing<Item, 16> ring;
+  std::atomic<uint32_t> running {kProducers};
+  std::vector<std::thread> producers;
+  for (uint32_t p = 0; p < kProducers; ++p) {
+    producers.emplace_back([&ring, &running, p] {
+      uint32_t seq = 0;
+      for (uint32_t batch = 0; seq < kItems; ++batch) {
+        uint32_t size = std::min(1 + (batch * 7 + p) % 6, kItems - seq);
+        auto make = [p, seq, size](size_t i) {
+          return Item {.producer = p, .seq = seq + uint32_t(i), .index = uint32_t(i), .size = size};
+        };
+        while (!ring.push(size, make)) {
+          std::this_thread::yield();
+        }
+        seq += size;
+      }
+      running.fetch_sub(1, std::memory_order_release);
+    });
+  }
+
+  std::vector<uint32_t> next(kProducers, 0);
+  Item batch {.index = 0, .size = 1}; // As if a whole batch came before
+  Item out;
+  uint32_t popped = 0;
+  for (;;) {
+    bool stopped = running.load(std::memory_order_acquire) == 0;
+    if (!ring.pop(out)) {
+      if (stopped) {
+        break;
+      }
+      std::this_thread::yield();
+      continue;
+    }
+    popped++;
+    if (!CHECK(out.producer < kProducers) || !CHECK_EQ(out.seq, next[out.producer])) {
+      break;
+    }
+    next[out.producer]++;
+    // Inside a batch, the items follow each other with nothing in between
+    if (out.index) {
+      CHECK(out.producer == batch.producer && out.index == batch.index + 1 && out.size == batch.size);
+    } else {
+      CHECK(batch.index + 1 == batch.size);
+    }
+    batch = out;
+  }
+  for (std::thread &t : producers) {
+    t.join();
+  }
+  CHECK_EQ(popped, kProducers * kItems);
+}
+
+int main() {
+  testBatchesAreAllOrNothing();
+  testFlush();
+  testProducersRace();
+  return host_test::result();
+}
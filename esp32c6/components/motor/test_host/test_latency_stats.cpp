@@ -0,0 +1,40 @@
+#include "HostTest.hpp"
+#include "LatencyStats.hpp"
+
+using namespace motor;
+
+// Bucket b holds [2^(b-1), 2^b) us, the last one everything longer; negative intervals count as 0
+static void testBuckets() {
+  LatencyStats stats;
+  for (int64_t us : {-5LL, 0LL, 1LL, 2LL, 3LL, 1023LL, 1024LL, 1LL << 40}) {
+    stats.record(LatencyStage::MOVE, us);
+  }
+  const LatencyHistogram &h = stats.histogram(LatencyStage::MOVE);
+  CHECK_EQ(h.counts[0], 2);
+  CHECK_EQ(h.counts[1], 1);
+  CHECK_EQ(h.counts[2], 2);
+  CHECK_EQ(h.counts[10], 1);
+  CHECK_EQ(h.counts[11], 1);
+  CHECK_EQ(h.counts[LatencyHistogram::kBuckets - 1], 1);
+  CHECK_EQ(h.max_us, UINT32_MAX);
+  CHECK_EQ(stats.histogram(LatencyStage::SETUP).counts[0], 0);
+}
+
+// Counts stop at UINT16_MAX instead of wrapping, reset() clears every stage
+static void testSaturatesAndResets() {
+  LatencyStats stats;
+  for (uint32_t i = 0; i < UINT16_MAX + 10u; ++i) {
+    stats.record(LatencyStage::QUEUE_WAIT, 100);
+  }
+  CHECK_EQ(stats.histogram(LatencyStage::QUEUE_WAIT).counts[7], UINT16_MAX);
+  CHECK_EQ(stats.histogram(LatencyStage::QUEUE_WAIT).max_us, 100);
+  stats.reset();
+  CHECK_EQ(stats.histogram(LatencyStage::QUEUE_WAIT).counts[7], 0);
+  CHECK_EQ(stats.histogram(LatencyStage::QUEUE_WAIT).max_us, 0);
+}
+
+int main() {
+  testBuckets();
+  testSaturatesAndResets();
+  return host_test::result();
+}
@@ -0,0 +1,51 @@
+#include "SimRig.hpp"
+
+using namespace motor;
+
+// Largest angle REG_MOTOR_PROFILE takes
+static constexpr int32_t kMaxDegrees = INT16_MAX;
+// Fast enough to keep the longest moves short in virtual time
+static constexpr Kinematics kFast {.max_velocity = 20000, .acceleration = 60000, .jerk = 0};
+
+// The longest moves are planned in full, with a cruise chained from pieces the step counter can watch
+static void testPlans() {
+  for (uint16_t factor = 1; factor <= RampedMove::maxFactor; factor *= 2) {
+    for (const Kinematics &k : {Kinematics {}, kFast}) {
+      int32_t steps = RampedMove::stepsFor(kMaxDegrees, factor);
+      RampedMove plan(steps, RampedMove::rampTable(k, factor));
+      CHECK_EQ(plan.plannedSteps(), steps);
+      CHECK_EQ(plan.chainedMiddle(), plan.middleSteps() > RampedMove::maxSegmentSteps);
+      uint64_t total = 0;
+      SegmentData seg;
+      while (plan.next(seg)) {
+        CHECK(seg.steps > 0 && seg.steps <= static_cast<int32_t>(RampedMove::maxSegmentSteps));
+        total += seg.steps;
+      }
+      CHECK_EQ(total, steps);
+    }
+  }
+  CHECK(RampedMove(RampedMove::stepsFor(kMaxDegrees, 128), RampedMove::rampTable(128)).chainedMiddle());
+}
+
+// Run to the end at every factor, both ways and with both segment switches: every step is accounted for
+static void testRuns() {
+  for (SegmentSwitch segmentSwitch : {SegmentSwitch::ISR, SegmentSwitch::TASK}) {
+    for (uint16_t factor = 1; factor <= RampedMove::maxFactor; factor *= 2) {
+      int32_t steps = RampedMove::stepsFor(factor % 4 ? kMaxDegrees : -kMaxDegrees, factor);
+      SimRig rig(segmentSwitch, factor, kFast);
+      rig.hal.setPosition(0);
+      // The task keeps up with the shortest step period
+      CHECK(rig.runFixed(steps, segmentSwitch == SegmentSwitch::ISR ? 1000 : MIN_PERIOD_US - 10));
+      CHECK_EQ(rig.sim->steps().size(), std::abs(steps));
+      CHECK_EQ(rig.netSteps(), steps);
+      CHECK_EQ(rig.hal.lastMoveSteps(), std::abs(steps));
+      CHECK_EQ(rig.hal.position(), steps * (POSITION_UNITS_PER_STEP / factor));
+    }
+  }
+}
+
+int main() {
+  testPlans();
+  testRuns();
+  return host_test::result();
+}
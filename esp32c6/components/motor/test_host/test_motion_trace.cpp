@@ -0,0 +1,86 @@
+#include <vector>
+
+#include "SimRig.hpp"
+
+using namespace motor;
+
+static std::vector<TraceEvent> drain(MotionTrace &trace) {
+  std::vector<TraceEvent> events;
+  TraceEvent event;
+  while (trace.pop(event)) {
+    events.push_back(event);
+  }
+  return events;
+}
+
+// Nothing is recorded outside start() and stop()
+static void testIdle() {
+  SimRig rig(SegmentSwitch::ISR, 8);
+  CHECK(rig.runFixed(RampedMove::stepsFor(90, 8)));
+  CHECK(drain(rig.hal.trace()).empty());
+  rig.hal.trace().start();
+  rig.hal.trace().stop();
+  CHECK(rig.runFixed(RampedMove::stepsFor(90, 8)));
+  CHECK(drain(rig.hal.trace()).empty());
+}
+
+// A move traces its start, its segments in plan order and its stop; the counts add up to the steps run
+static void testMove(SegmentSwitch segmentSwitch) {
+  SimRig rig(segmentSwitch, 8);
+  int32_t steps = RampedMove::stepsFor(-720, 8);
+  rig.hal.trace().start();
+  // The TASK switches are late, pulses run past the watch points
+  CHECK(rig.runFixed(steps, segmentSwitch == SegmentSwitch::TASK ? 5000 : 10));
+  std::vector<TraceEvent> events = drain(rig.hal.trace());
+  if (!CHECK(events.size() > 3)) {
+    return;
+  }
+  const TraceEvent &start = events.front();
+  CHECK(start.kind == TraceKind::START);
+  CHECK_EQ(start.value, steps);
+  CHECK_EQ(start.count, 8);
+  CHECK_EQ(start.arg, static_cast<uint8_t>(MoveType::FIXED));
+  const TraceEvent &stop = events.back();
+  CHECK(stop.kind == TraceKind::STOP);
+  CHECK_EQ(stop.value, rig.hal.position());
+  CHECK_EQ(stop.arg, 1);
+  CHECK(events[events.size() - 2].kind == TraceKind::PAUSE);
+  int64_t counted = 0;
+  int32_t index = -1;
+  for (size_t i = 1; i + 1 < events.size(); ++i) {
+    counted += events[i].count;
+    if (events[i].kind == TraceKind::SEGMENT) {
+      CHECK(events[i].value > index);
+      index = events[i].value;
+    }
+  }
+  CHECK_EQ(counted, rig.sim->steps().size());
+  CHECK_EQ(rig.hal.trace().dropped(), 0);
+}
+
+// A full ring keeps the oldest events and counts the rest
+static void testDropped() {
+  SimRig rig(SegmentSwitch::ISR, 8);
+  rig.hal.trace().start();
+  uint32_t recorded = 0;
+  while (rig.hal.trace().dropped() == 0 && recorded < 10 * MotionTrace::kDepth) {
+    CHECK(rig.runFixed(RampedMove::stepsFor(recorded % 2 ? 360 : -360, 8)));
+    recorded++;
+  }
+  CHECK(rig.hal.trace().dropped() > 0);
+  std::vector<TraceEvent> events = drain(rig.hal.trace());
+  CHECK_EQ(events.size(), MotionTrace::kDepth);
+  CHECK(events.front().kind == TraceKind::START);
+  // start() clears the ring and the count
+  rig.hal.trace().start();
+  CHECK_EQ(rig.hal.trace().dropped(), 0);
+  CHECK(drain(rig.hal.trace()).empty());
+}
+
+int main() {
+  testIdle();
+  testMove(SegmentSwitch::ISR);
+  testMove(SegmentSwitch::TASK);
+  testDropped();
+  return host_test::result();
+}
@@ -0,0 +1,328 @@
+#include <random>
+
+#include "MotionProgram.hpp"
+#include "MotorRig.hpp"
+
+using namespace motor;
+
+static constexpr int32_t kUnits = POSITION_UNITS_PER_STEP; // Per step at the full step factor
+
+// Pops the completion records for us of real time, so that the FIFO does not overflow
+static void pollFor(MotorRig &rig, uint32_t us) {
+  auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(us);
+  rig.waitUntil([until] { return std::chrono::steady_clock::now() >= until; });
+}
+
+static void reset(MotorRig &rig) {
+  rig.drain();
+  rig.done.clear();
+  rig.sim->clearSteps();
+  rig.motor.setPosition(0);
+}
+
+// Moves, dwells, HOLD and RELEASE run in the order submitted, each one reported once
+static void testRunsInOrder(MotorRig &rig) {
+  reset(rig);
+  const Move batch[] = {
+    {.degrees = 90, .end_action = EndAction::HOLD},
+    {.delay_ms = 20, .move_type = MoveType::DWELL},
+    {.degrees = -90},
+    {.move_type = MoveType::HOLD},
+    {.move_type = MoveType::RELEASE},
+  };
+  CHECK_EQ(rig.motor.submitBatch(batch, std::size(batch)), ESP_OK);
+  MotorCmdId first = rig.motor.lastQueuedId() - std::size(batch) + 1;
+  if (!rig.drain() || !CHECK_EQ(rig.done.size(), std::size(batch) + 1)) {
+    return;
+  }
+  for (size_t i = 0; i < std::size(batch); ++i) {
+    CHECK_EQ(rig.done[i].id, first + i);
+    CHECK_EQ(rig.done[i].first_id, first + i);
+    CHECK_EQ(rig.done[i].type, static_cast<uint8_t>(batch[i].move_type));
+    CHECK(rig.done[i].end == MoveEnd::COMPLETED);
+  }
+  // Short moves are cut at whole ramp segments
+  uint32_t steps = RampedMove(90, 1).plannedSteps();
+  CHECK_EQ(rig.done[0].steps, steps);
+  CHECK_EQ(rig.done[2].steps, steps);
+  std::vector<SimBackend::Step> emitted = rig.sim->steps();
+  if (CHECK_EQ(emitted.size(), 2 * steps)) {
+    // The dwell between the two moves
+    CHECK(emitted[steps].t_us - emitted[steps - 1].t_us >= 20000);
+  }
+  CHECK_EQ(rig.netSteps(), 0);
+  CHECK_EQ(rig.motor.getPosition(), 0);
+  CHECK(!rig.sim->enabled());
+}
+
+// An emergency STOP ends the running move where it is and drops the queued ones
+static void testStopFlushesQueue(MotorRig &rig) {
+  reset(rig);
+  const Move batch[] = {
+    {.degrees = 3600},
+    {.degrees = 90, .delay_ms = 1},
+    {.degrees = 90, .delay_ms = 1},
+  };
+  CHECK_EQ(rig.motor.submitBatch(batch, std::size(batch)), ESP_OK);
+  MotorCmdId first = rig.motor.lastQueuedId() - std::size(batch) + 1;
+  rig.waitSteps(200);
+  CHECK_EQ(rig.motor.stop(StopMode::EMERGENCY), ESP_OK);
+  CHECK(static_cast<int32_t>(rig.motor.flushedThroughId() - (first + 2)) >= 0);
+  if (!rig.drain() || !CHECK_EQ(rig.done.size(), 2)) {
+    return;
+  }
+  CHECK_EQ(rig.done[0].id, first);
+  CHECK(rig.done[0].end == MoveEnd::EMERGENCY);
+  size_t emitted = rig.sim->steps().size();
+  CHECK(emitted < static_cast<size_t>(RampedMove::stepsFor(3600, 1)));
+  CHECK_EQ(rig.done[0].steps, emitted);
+  CHECK_EQ(rig.motor.getLastMove().steps, emitted);
+  CHECK_EQ(rig.motor.getPosition(), rig.netSteps() * kUnits);
+}
+
+// A decelerate STOP ramps down from the current rate: the steps after it slow down to the start rate
+static void testDecelerateStop(MotorRig &rig) {
+  reset(rig);
+  Move mv {.degrees = 3600};
+  CHECK_EQ(rig.motor.submit(mv), ESP_OK);
+  rig.waitSteps(1000);
+  CHECK_EQ(rig.motor.stop(StopMode::DECELERATE), ESP_OK);
+  size_t at_stop = rig.sim->steps().size();
+  if (!rig.drain() || !CHECK_EQ(rig.done.size(), 2)) {
+    return;
+  }
+  CHECK(rig.done[0].end == MoveEnd::DECELERATED);
+  std::vector<SimBackend::Step> emitted = rig.sim->steps();
+  CHECK(emitted.size() > at_stop && emitted.size() < static_cast<size_t>(RampedMove::stepsFor(3600, 1)));
+  CHECK_EQ(rig.done[0].steps, emitted.size());
+  size_t n = emitted.size();
+  CHECK(emitted[n - 1].t_us - emitted[n - 2].t_us > emitted[at_stop].t_us - emitted[at_stop - 1].t_us);
+  CHECK_EQ(rig.motor.getPosition(), rig.netSteps() * kUnits);
+}
+
+// Moves that continue each other run as one, and their record covers all of their ids
+static void testBlendedRecord(MotorRig &rig) {
+  reset(rig);
+  const Move batch[] = {{.degrees = 90}, {.degrees = 90}, {.degrees = 180, .end_action = EndAction::HOLD}};
+  CHECK_EQ(rig.motor.submitBatch(batch, std::size(batch)), ESP_OK);
+  MotorCmdId first = rig.motor.lastQueuedId() - std::size(batch) + 1;
+  if (!rig.drain() || !CHECK_EQ(rig.done.size(), 2)) {
+    return;
+  }
+  CHECK_EQ(rig.done[0].first_id, first);
+  CHECK_EQ(rig.done[0].id, first + 2);
+  CHECK_EQ(rig.done[0].steps, static_cast<uint32_t>(RampedMove::stepsFor(360, 1)));
+  CHECK_EQ(rig.netSteps(), RampedMove::stepsFor(360, 1));
+  CHECK(rig.sim->enabled());
+  CHECK_EQ(rig.motor.submit(Move {.move_type = MoveType::RELEASE}), ESP_OK);
+}
+
+// The moves queued behind a running one are blended and planned while it runs, then started from that plan
+static void testPreparesBlendedNext(MotorRig &rig) {
+  reset(rig);
+  const Move batch[] = {
+    {.degrees = 720},
+    // Its delay keeps it from blending into the first move, the two behind it blend into it
+    {.degrees = -90, .delay_ms = 1},
+    {.degrees = -180},
+    {.degrees = -360},
+  };
+  SetupStats before = rig.motor.hal().setupStats();
+  rig.motor.hal().planCache().resetStats();
+  CHECK_EQ(rig.motor.submitBatch(batch, std::size(batch)), ESP_OK);
+  MotorCmdId first = rig.motor.lastQueuedId() - std::size(batch) + 1;
+  if (!rig.drain() || !CHECK_EQ(rig.done.size(), 3)) {
+    return;
+  }
+  CHECK_EQ(rig.done[0].id, first);
+  CHECK_EQ(rig.done[0].first_id, first);
+  // One record for the three blended moves
+  CHECK_EQ(rig.done[1].first_id, first + 1);
+  CHECK_EQ(rig.done[1].id, first + 3);
+  int32_t blended = 0;
+  for (size_t i = 1; i < std::size(batch); ++i) {
+    blended += RampedMove::stepsFor(batch[i].degrees, 1);
+  }
+  uint32_t planned = RampedMove(blended, RampedMove::rampTable(1)).plannedSteps();
+  CHECK_EQ(rig.done[1].steps, planned);
+  CHECK_EQ(rig.motor.hal().setupStats().plansPrepared - before.plansPrepared, 1);
+  // One plan cache access a move, the prepared one included
+  PlanCacheStats stats = rig.motor.hal().planCache().stats();
+  CHECK_EQ(stats.hits + stats.misses, 2);
+  CHECK_EQ(rig.netSteps(), rig.done[0].steps - planned);
+  CHECK_EQ(rig.motor.getPosition(), rig.netSteps() * kUnits);
+}
+
+// Kinematics whose ramp does not fit the table are refused and the ones in effect stay
+static void testRejectsOverlongRamps(MotorRig &rig) {
+  const Kinematics fitting {.max_velocity = 2000, .acceleration = 8000, .jerk = 40000};
+  CHECK_EQ(rig.motor.setKinematics(fitting), ESP_OK);
+  const Kinematics overlong[] = {
+    {.max_velocity = UINT16_MAX, .acceleration = 1, .jerk = 0},
+    {.max_velocity = 20000, .acceleration = 1000, .jerk = 1},
+    {.max_velocity = 1000, .acceleration = 0, .jerk = 0},
+  };
+  for (const Kinematics &k : overlong) {
+    CHECK_EQ(rig.motor.setKinematics(k), ESP_ERR_INVALID_ARG);
+    CHECK(rig.motor.getKinematics() == fitting);
+  }
+  CHECK_EQ(rig.motor.setKinematics({}), ESP_OK);
+}
+
+static void saveProgram(uint8_t id, std::initializer_list<ProgramInstr> instrs) {
+  MotionProgram program;
+  size_t length = instrs.size() * sizeof(ProgramInstr);
+  CHECK_EQ(program.assign(reinterpret_cast<const uint8_t *>(instrs.begin()), length), ESP_OK);
+  CHECK_EQ(ProgramStore::save(id, program), ESP_OK);
+}
+
+// Forever loops that neither move nor wait end after one pass instead of spinning the task
+static void testProgramLoopsWithoutProgress(MotorRig &rig) {
+  reset(rig);
+  saveProgram(1, {{ProgramOp::REPEAT}, {ProgramOp::HOLD}, {ProgramOp::LOOP}});
+  saveProgram(2, {{ProgramOp::REPEAT}, {ProgramOp::RELEASE}, {ProgramOp::LOOP}});
+  // At the position already
+  saveProgram(3, {{ProgramOp::REPEAT}, {ProgramOp::GOTO}, {ProgramOp::LOOP}});
+  saveProgram(4, {
+    {ProgramOp::REPEAT},
+    {ProgramOp::MOVE},
+    {ProgramOp::REPEAT},
+    {ProgramOp::RELEASE},
+    {ProgramOp::LOOP},
+    {ProgramOp::LOOP},
+  });
+  for (uint8_t id = 1; id <= 4; ++id) {
+    Move mv {.degrees = id, .move_type = MoveType::PROGRAM};
+    CHECK_EQ(rig.motor.submit(mv), ESP_OK);
+  }
+  if (!rig.drain() || !CHECK_EQ(rig.done.size(), 5)) {
+    return;
+  }
+  for (size_t i = 0; i < 4; ++i) {
+    CHECK(rig.done[i].end == MoveEnd::COMPLETED);
+  }
+  CHECK(rig.sim->steps().empty());
+}
+
+// Loops that move run all their passes, and forever until a STOP
+static void testProgramLoopsThatMove(MotorRig &rig) {
+  reset(rig);
+  uint32_t steps = RampedMove(90, 1).plannedSteps();
+  saveProgram(5, {{ProgramOp::REPEAT, 0, 3}, {ProgramOp::MOVE, 0, 90}, {ProgramOp::HOLD}, {ProgramOp::LOOP}});
+  Move counted {.degrees = 5, .move_type = MoveType::PROGRAM};
+  CHECK_EQ(rig.motor.submit(counted), ESP_OK);
+  if (!rig.drain() || !CHECK_EQ(rig.done.size(), 2)) {
+    return;
+  }
+  CHECK_EQ(rig.done[0].steps, 3 * steps);
+  CHECK_EQ(rig.netSteps(), 3 * steps);
+
+  reset(rig);
+  saveProgram(6, {{ProgramOp::REPEAT}, {ProgramOp::GOTO, 0, 90}, {ProgramOp::GOTO}, {ProgramOp::LOOP}});
+  Move forever {.degrees = 6, .move_type = MoveType::PROGRAM};
+  CHECK_EQ(rig.motor.submit(forever), ESP_OK);
+  rig.waitSteps(10 * steps);
+  CHECK_EQ(rig.motor.stop(StopMode::EMERGENCY), ESP_OK);
+  if (rig.drain() && CHECK_EQ(rig.done.size(), 2)) {
+    CHECK(rig.done[0].end == MoveEnd::EMERGENCY);
+  }
+  CHECK_EQ(rig.motor.getPosition(), rig.netSteps() * kUnits);
+}
+
+/**
+ * @brief Every id submitted after first is reported once, in order, or flushed; the position
+ * follows the steps. A record covers the ids of the moves blended into it.
+ */
+static void checkAccounted(MotorRig &rig, MotorCmdId first) {
+  MotorCmdId last = rig.motor.lastQueuedId();
+  size_t next = 0;
+  for (MotorCmdId id = first; id != last + 1; ++id) {
+    if (next < rig.done.size() && rig.done[next].first_id == id) {
+      id = rig.done[next++].id;
+      continue;
+    }
+    if (!CHECK(static_cast<int32_t>(rig.motor.flushedThroughId() - id) >= 0)) {
+      std::printf("  id %u neither run nor flushed\n", static_cast<unsigned>(id));
+      return;
+    }
+  }
+  CHECK_EQ(next, rig.done.size());
+  CHECK_EQ(rig.motor.droppedCompletions(), 0);
+  CHECK_EQ(rig.motor.getPosition(), rig.netSteps() * kUnits);
+}
+
+// STOPs and queue resets land anywhere: before a dequeue, between it and the first pulse, mid-move
+static void testStopRaces(MotorRig &rig) {
+  reset(rig);
+  std::mt19937 random(1);
+  MotorCmdId first = rig.motor.lastQueuedId() + 1;
+  for (int round = 0; round < 300; ++round) {
+    Move batch[4];
+    size_t count = 1 + random() % 4;
+    for (size_t i = 0; i < count; ++i) {
+      // Moves the same way as the one before blend into it
+      batch[i] = Move {.degrees = (random() % 2 ? -1 : 1) * static_cast<int32_t>(5 + random() % 40)};
+    }
+    CHECK_EQ(rig.motor.submitBatch(batch, count), ESP_OK);
+    pollFor(rig, random() % 400);
+    switch (random() % 3) {
+      case 0:
+        rig.motor.stop(StopMode::EMERGENCY);
+        break;
+      case 1:
+        rig.motor.stop(StopMode::DECELERATE);
+        break;
+      default:
+        rig.motor.resetQueue();
+        break;
+    }
+    if (!rig.drain()) {
+      return;
+    }
+  }
+  checkAccounted(rig, first);
+}
+
+// Another task submits while this one flushes: nothing is run twice or lost unreported
+static void testSubmitFlushRace(MotorRig &rig) {
+  reset(rig);
+  MotorCmdId first = rig.motor.lastQueuedId() + 1;
+  std::atomic<bool> submitting = true;
+  std::thread submitter([&rig, &submitting] {
+    for (int i = 0; i < 2000; ++i) {
+      Move mv {.degrees = i % 2 ? -3 : 3};
+      rig.motor.submit(mv);
+      std::this_thread::yield();
+    }
+    submitting = false;
+  });
+  std::mt19937 random(2);
+  while (submitting) {
+    pollFor(rig, random() % 200);
+    if (random() % 2) {
+      rig.motor.resetQueue();
+    } else {
+      rig.motor.stop(StopMode::EMERGENCY);
+    }
+  }
+  submitter.join();
+  if (rig.drain()) {
+    checkAccounted(rig, first);
+  }
+}
+
+int main() {
+  MotorRig rig;
+  testRunsInOrder(rig);
+  testRejectsOverlongRamps(rig);
+  testBlendedRecord(rig);
+  testPreparesBlendedNext(rig);
+  testStopFlushesQueue(rig);
+  testDecelerateStop(rig);
+  testProgramLoopsWithoutProgress(rig);
+  testProgramLoopsThatMove(rig);
+  testStopRaces(rig);
+  testSubmitFlushRace(rig);
+  rig.drain();
+  return host_test::result();
+}
@@ -0,0 +1,154 @@
+#include "SimRig.hpp"
+
+using namespace motor;
+
+// Simulator that also counts the driver and counter calls MotorHal makes
+class CountingSim : public SimBackend {
+  public:
+    uint32_t latches = 0;
+    uint32_t directions = 0;
+    uint32_t watchPointsAdded = 0;
+    uint32_t watchPointsRemoved = 0;
+
+    explicit CountingSim(MotorCfg &cfg) : SimBackend(cfg) {}
+    esp_err_t latchMode(uint8_t modeBits) override {
+      latches++;
+      return SimBackend::latchMode(modeBits);
+    }
+    esp_err_t setDirection(bool forward) override {
+      directions++;
+      return SimBackend::setDirection(forward);
+    }
+    esp_err_t addWatchPoint(int value) override {
+      watchPointsAdded++;
+      return SimBackend::addWatchPoint(value);
+    }
+    esp_err_t removeWatchPoint(int value) override {
+      watchPointsRemoved++;
+      return SimBackend::removeWatchPoint(value);
+    }
+};
+
+using CountingRig = BasicSimRig<CountingSim>;
+
+// Moves at the same factor latch the mode once, and the same direction and segment sizes are kept
+static void testRepeatedMovesSkipSetup() {
+  constexpr uint32_t kMoves = 10;
+  CountingRig rig(SegmentSwitch::ISR, 8);
+  int32_t steps = RampedMove::stepsFor(720, 8);
+  for (uint32_t i = 0; i < kMoves; ++i) {
+    int64_t start_us = rig.sim->now();
+    size_t before = rig.sim->steps().size();
+    CHECK(rig.runFixed(steps));
+    // Pulses start at once when the mode is already latched
+    CHECK_EQ(rig.sim->steps()[before].t_us - start_us, i ? 0 : SimBackend::kModeLatchUs);
+  }
+  const SetupStats &stats = rig.hal.setupStats();
+  CHECK_EQ(rig.sim->latches, 1);
+  CHECK_EQ(stats.latches, 1);
+  CHECK_EQ(stats.latchesSkipped, kMoves - 1);
+  CHECK_EQ(rig.sim->directions, 1);
+  CHECK_EQ(stats.directionSkipped, kMoves - 1);
+  CHECK_EQ(rig.sim->watchPointsRemoved, 0);
+  CHECK_EQ(stats.watchPointsKept, (kMoves - 1) * rig.sim->watchPointsAdded);
+  CHECK_EQ(rig.netSteps(), kMoves * steps);
+}
+
+// A reversal only drives DIR; a factor change latches again, and the latch takes DIR back with it
+static void testChangesAreApplied() {
+  CountingRig rig(SegmentSwitch::ISR, 8);
+  CHECK(rig.runFixed(RampedMove::stepsFor(90, 8)));
+  CHECK(rig.runFixed(RampedMove::stepsFor(-90, 8)));
+  CHECK_EQ(rig.sim->latches, 1);
+  CHECK_EQ(rig.sim->directions, 2);
+  rig.cfg.stepMode.setFactor(32);
+  CHECK(rig.runFixed(RampedMove::stepsFor(-90, 32)));
+  CHECK_EQ(rig.sim->latches, 2);
+  CHECK_EQ(rig.sim->directions, 3);
+  CHECK_EQ(rig.sim->latchedMode(), static_cast<uint8_t>(StepMode::ModeBits::FixedThirtySecond));
+  CHECK_EQ(rig.hal.setupStats().directionSkipped, 0);
+  // The plan of another length watches other segment sizes
+  CHECK(rig.sim->watchPointsRemoved > 0);
+}
+
+// Segments left to pull from plan
+static uint16_t remaining(RampedMove plan) {
+  uint16_t count = 0;
+  SegmentData seg;
+  while (plan.next(seg)) {
+    ++count;
+  }
+  return count;
+}
+
+// Repeated moves are served from the plan cache, the least recently used plan goes first
+static void testPlanCache() {
+  const Kinematics builtin {};
+  const Kinematics trapezoid {.max_velocity = 1000, .acceleration = 4000, .jerk = 0};
+  PlanCache cache;
+  for (int32_t i = 0; i < static_cast<int32_t>(PlanCache::kSize); ++i) {
+    CHECK_EQ(cache.get(1000 + i, 16, builtin).totalSteps(), 1000 + i);
+  }
+  CHECK_EQ(cache.stats().misses, PlanCache::kSize);
+  CHECK_EQ(cache.stats().hits, 0);
+  // Hits whatever was consumed from the plan last time
+  for (int32_t i = 0; i < static_cast<int32_t>(PlanCache::kSize); ++i) {
+    RampedMove plan = cache.get(1000 + i, 16, builtin);
+    SegmentData seg;
+    while (plan.next(seg)) {
+    }
+    const RampedMove &again = cache.get(1000 + i, 16, builtin);
+    CHECK_EQ(remaining(again), again.size());
+  }
+  CHECK_EQ(cache.stats().hits, 2 * PlanCache::kSize);
+  // Another factor or kinematics is another plan
+  CHECK_EQ(cache.get(1000, 8, builtin).rampSegmentSteps(), RampedMove::stepsPerSegment * 8);
+  CHECK(cache.get(1001, 16, trapezoid).rampTable().period_us == RampedMove::rampTable(trapezoid, 16).period_us);
+  CHECK_EQ(cache.stats().misses, PlanCache::kSize + 2);
+  // Those two evicted 1000 and 1001, the least recently used, 1002 is still there
+  cache.resetStats();
+  cache.get(1002, 16, builtin);
+  cache.get(1000, 16, builtin);
+  cache.get(1001, 16, builtin);
+  CHECK_EQ(cache.stats().hits, 1);
+  CHECK_EQ(cache.stats().misses, 2);
+}
+
+// MotorHal plans a repeated move once
+static void testRepeatedMovesHitPlanCache() {
+  SimRig rig(SegmentSwitch::ISR, 1);
+  for (int i = 0; i < 6; ++i) {
+    CHECK(rig.runFixed(i % 2 ? -400 : 400));
+  }
+  CHECK_EQ(rig.hal.planCache().stats().misses, 2);
+  CHECK_EQ(rig.hal.planCache().stats().hits, 4);
+}
+
+// A plan prepared while the previous move runs is taken by the move it was made for, and only by it
+static void testPreparedPlan() {
+  SimRig rig(SegmentSwitch::ISR, 8);
+  int32_t steps = RampedMove::stepsFor(360, 8);
+  CHECK(rig.hal.preparePlan(steps, 8));
+  CHECK(rig.runFixed(steps));
+  CHECK_EQ(rig.hal.setupStats().plansPrepared, 1);
+  // Another length, say after a blend, is planned in startMove and drops the prepared one
+  CHECK(rig.hal.preparePlan(steps, 8));
+  CHECK(rig.runFixed(2 * steps));
+  CHECK(rig.runFixed(steps));
+  CHECK_EQ(rig.hal.setupStats().plansPrepared, 1);
+  // So is another factor
+  CHECK(rig.hal.preparePlan(steps, 4));
+  CHECK(rig.runFixed(steps));
+  CHECK_EQ(rig.hal.setupStats().plansPrepared, 1);
+  CHECK_EQ(rig.netSteps(), 5 * steps);
+  CHECK(!rig.hal.preparePlan(0, 8));
+}
+
+int main() {
+  testRepeatedMovesSkipSetup();
+  testChangesAreApplied();
+  testPlanCache();
+  testRepeatedMovesHitPlanCache();
+  testPreparedPlan();
+  return host_test::result();
+}
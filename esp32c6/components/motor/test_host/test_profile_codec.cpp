@@ -0,0 +1,293 @@
+#include <vector>
+
+#include "HostTest.hpp"
+#include "ProfileCodec.hpp"
+
+using namespace motor;
+namespace pc = ProfileCodec;
+
+static constexpr uint16_t kAxisFactor = 8;
+static constexpr size_t kCapacity = 64;
+
+// A move as the host encoder takes it, factor 0 for the one in effect
+struct Spec {
+    int32_t steps;
+    uint16_t factor = 0;
+    bool hold = false;
+    bool absolute = false;
+    uint32_t delay = 0;
+};
+
+static void varint(std::vector<uint8_t> &out, uint32_t value) {
+  do {
+    uint8_t byte = value & 0x7F;
+    value >>= 7;
+    out.push_back(value ? byte | 0x80 : byte);
+  } while (value);
+}
+
+static uint32_t zigzag(int32_t n) { return (static_cast<uint32_t>(n) << 1) ^ static_cast<uint32_t>(n >> 31); }
+
+// One frame the way encodeProfile in apps/api/src/tools/motor.js packs it
+static std::vector<uint8_t> encode(const std::vector<Spec> &moves) {
+  std::vector<uint8_t> out;
+  Spec prev {.steps = 0};
+  uint16_t frameFactor = 0;
+  uint16_t factor = 0;
+  for (size_t i = 0; i < moves.size();) {
+    Spec move = moves[i];
+    move.factor = move.factor ? move.factor : factor;
+    auto same = [&move](const Spec &b) {
+      return b.steps == move.steps && b.hold == move.hold && b.absolute == move.absolute && b.delay == move.delay
+             && (!b.factor || b.factor == move.factor);
+    };
+    int64_t delta = int64_t(move.steps) - prev.steps;
+    bool brief = move.hold == prev.hold && move.absolute == prev.absolute && move.delay == prev.delay
+                 && move.factor == frameFactor && delta >= -64 && delta <= 63;
+    size_t repeat = 1;
+    while (repeat <= 7 && i + repeat < moves.size() && same(moves[i + repeat])) {
+      repeat++;
+    }
+    std::vector<uint8_t> record {static_cast<uint8_t>(
+      pc::LONG | (move.hold ? pc::FLAG_HOLD : 0) | (move.absolute ? pc::FLAG_ABSOLUTE : 0)
+      | (move.delay ? pc::FLAG_DELAY : 0) | (move.factor != frameFactor ? pc::FLAG_FACTOR : 0)
+      | (repeat - 1) << pc::REPEAT_SHIFT
+    )};
+    if (move.factor != frameFactor) {
+      record.push_back(__builtin_ctz(move.factor));
+    }
+    if (move.delay) {
+      varint(record, move.delay);
+    }
+    varint(record, zigzag(move.steps));
+    if (brief && record.size() > repeat) {
+      record = {static_cast<uint8_t>(delta & 0x7F)};
+      repeat = 1;
+    }
+    out.insert(out.end(), record.begin(), record.end());
+    prev = move;
+    frameFactor = factor = move.factor;
+    i += repeat;
+  }
+  return out;
+}
+
+static esp_err_t decode(const std::vector<uint8_t> &bytes, std::vector<Move> &moves, size_t capacity = kCapacity) {
+  moves.resize(capacity);
+  size_t count = 0;
+  esp_err_t err = pc::decode(bytes.data(), bytes.size(), kAxisFactor, moves.data(), capacity, count);
+  moves.resize(err == ESP_OK ? count : 0);
+  return err;
+}
+
+static bool matches(const Move &m, const Spec &s) {
+  return m.steps == s.steps && m.step_factor == (s.factor ? s.factor : kAxisFactor)
+         && m.end_action == (s.hold ? EndAction::HOLD : EndAction::COAST)
+         && m.move_type == (s.absolute ? MoveType::GOTO : MoveType::FIXED) && m.delay_ms == s.delay && m.degrees == 0;
+}
+
+// Every record shape, hand encoded
+static void testRecordShapes() {
+  std::vector<Move> moves;
+  // Short records: steps moved by -64..63 from the previous move, 0 steps before the first one
+  CHECK_EQ(decode({0x05, 0x7F, 0x40, 0x3F}, moves), ESP_OK);
+  CHECK_EQ(moves.size(), 4);
+  CHECK(matches(moves[0], {.steps = 5}) && matches(moves[1], {.steps = 4}));
+  CHECK(matches(moves[2], {.steps = -60}) && matches(moves[3], {.steps = 3}));
+  // Long records, one flag at a time: -300 is zigzag 599
+  CHECK_EQ(decode({0x80, 0xD7, 0x04}, moves), ESP_OK);
+  CHECK(moves.size() == 1 && matches(moves[0], {.steps = -300}));
+  CHECK_EQ(decode({0x81, 0x02}, moves), ESP_OK);
+  CHECK(moves.size() == 1 && matches(moves[0], {.steps = 1, .hold = true}));
+  CHECK_EQ(decode({0x82, 0x02}, moves), ESP_OK);
+  CHECK(moves.size() == 1 && matches(moves[0], {.steps = 1, .absolute = true}));
+  CHECK_EQ(decode({0x84, 0xDC, 0x0B, 0x02}, moves), ESP_OK);
+  CHECK(moves.size() == 1 && matches(moves[0], {.steps = 1, .delay = 1500}));
+  CHECK_EQ(decode({0x88, 0x05, 0x02}, moves), ESP_OK);
+  CHECK(moves.size() == 1 && matches(moves[0], {.steps = 1, .factor = 32}));
+  // All of them, queued 1 + 7 times; a short record after it keeps all but the steps
+  CHECK_EQ(decode({0xFF, 0x07, 0x0A, 0x02, 0x01}, moves), ESP_OK);
+  CHECK_EQ(moves.size(), 9);
+  Spec all {.steps = 1, .factor = 128, .hold = true, .absolute = true, .delay = 10};
+  for (size_t i = 0; i < 8; ++i) {
+    CHECK(matches(moves[i], all));
+  }
+  all.steps = 2;
+  CHECK(matches(moves[8], all));
+  // The factor stays in effect until a record sets another one
+  CHECK_EQ(decode({0x88, 0x00, 0x02, 0x80, 0x04, 0x88, 0x07, 0x06}, moves), ESP_OK);
+  CHECK(moves.size() == 3 && moves[0].step_factor == 1 && moves[1].step_factor == 1 && moves[2].step_factor == 128);
+}
+
+// A record cut anywhere, an overlong varint or an empty stream is rejected, not read past
+static void testTruncated() {
+  std::vector<Move> moves;
+  CHECK_EQ(decode({}, moves), ESP_ERR_INVALID_SIZE);
+  CHECK_EQ(decode({0x80}, moves), ESP_ERR_INVALID_SIZE);
+  CHECK_EQ(decode({0x88}, moves), ESP_ERR_INVALID_SIZE);
+  CHECK_EQ(decode({0x84, 0xDC}, moves), ESP_ERR_INVALID_SIZE);
+  CHECK_EQ(decode({0x84, 0xDC, 0x0B}, moves), ESP_ERR_INVALID_SIZE);
+  CHECK_EQ(decode({0x05, 0x80, 0xFF, 0xFF}, moves), ESP_ERR_INVALID_SIZE);
+  // Past 32 bits
+  CHECK_EQ(decode({0x80, 0xFF, 0xFF, 0xFF, 0xFF, 0x1F}, moves), ESP_ERR_INVALID_SIZE);
+  CHECK_EQ(decode({0x80, 0xFF, 0xFF, 0xFF, 0xFF, 0x8F, 0x00}, moves), ESP_ERR_INVALID_SIZE);
+  CHECK_EQ(decode({0x80, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F}, moves), ESP_OK);
+  CHECK(moves.size() == 1 && moves[0].steps == INT32_MIN);
+}
+
+static void testInvalidValues() {
+  std::vector<Move> moves;
+  // Step factor past 128
+  CHECK_EQ(decode({0x88, 0x08, 0x02}, moves), ESP_ERR_INVALID_ARG);
+  // A short record past the int32 range
+  CHECK_EQ(decode({0x80, 0xFE, 0xFF, 0xFF, 0xFF, 0x0F, 0x01}, moves), ESP_ERR_INVALID_ARG);
+  CHECK_EQ(decode({0x80, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0x7F}, moves), ESP_ERR_INVALID_ARG);
+}
+
+// Repeats count against the capacity like the moves they stand for
+static void testCapacity() {
+  std::vector<Move> moves;
+  CHECK_EQ(decode({0xF0, 0x02}, moves, 8), ESP_OK);
+  CHECK_EQ(moves.size(), 8);
+  CHECK_EQ(decode({0xF0, 0x02}, moves, 7), ESP_ERR_INVALID_SIZE);
+  CHECK_EQ(decode({0xF0, 0x02, 0x00}, moves, 8), ESP_ERR_INVALID_SIZE);
+  std::vector<uint8_t> shortOnes(kCapacity, 0x01);
+  CHECK_EQ(decode(shortOnes, moves), ESP_OK);
+  CHECK(moves.size() == kCapacity && moves.back().steps == static_cast<int32_t>(kCapacity));
+  shortOnes.push_back(0x01);
+  CHECK_EQ(decode(shortOnes, moves), ESP_ERR_INVALID_SIZE);
+}
+
+// What the host encoder packs decodes to the same moves
+static void testRoundTrip() {
+  uint32_t seed = 1;
+  auto random = [&seed](uint32_t n) {
+    seed = seed * 1664525 + 1013904223;
+    return (seed >> 8) % n;
+  };
+  for (int round = 0; round < 2000; ++round) {
+    std::vector<Spec> specs;
+    while (specs.size() < 1 + random(kCapacity)) {
+      Spec s {.steps = 0};
+      switch (random(4)) {
+        case 0: // Small steps, the common case
+          s.steps = specs.empty() ? 0 : specs.back().steps + static_cast<int32_t>(random(129)) - 64;
+          break;
+        case 1:
+          s.steps = static_cast<int32_t>(random(1u << 24)) - (1 << 23);
+          break;
+        case 2:
+          s.steps = random(2) ? INT32_MAX : INT32_MIN;
+          break;
+        default: // Same again
+          s = specs.empty() ? s : specs.back();
+          s.factor = 0;
+          break;
+      }
+      s.factor = random(8) ? s.factor : 1u << random(8);
+      s.hold = random(6) == 0;
+      s.absolute = random(6) == 0;
+      s.delay = random(5) ? 0 : random(4) ? random(2000) : UINT32_MAX;
+      specs.push_back(s);
+    }
+    std::vector<Move> moves;
+    if (!CHECK_EQ(decode(encode(specs), moves), ESP_OK) || !CHECK_EQ(moves.size(), specs.size())) {
+      return;
+    }
+    uint16_t factor = 0;
+    for (size_t i = 0; i < specs.size(); ++i) {
+      Spec expected = specs[i];
+      factor = expected.factor = expected.factor ? expected.factor : factor;
+      if (!CHECK(matches(moves[i], expected))) {
+        std::printf("  round %d, move %zu\n", round, i);
+        return;
+      }
+    }
+  }
+}
+
+// Small moves without delay take a byte each: a 63-byte frame holds over four times the 15 moves of v1
+static void testDensity() {
+  std::vector<Spec> specs;
+  for (int i = 0; i < 63; ++i) {
+    specs.push_back({.steps = 30 + i * 37 % 60});
+  }
+  std::vector<uint8_t> bytes = encode(specs);
+  CHECK(bytes.size() <= 63);
+  std::vector<Move> moves;
+  CHECK_EQ(decode(bytes, moves), ESP_OK);
+  CHECK(moves.size() == specs.size() && moves.size() > 4 * 15);
+}
+
+// Frames encodeProfile in apps/api/src/tools/motor.js sent for these moves
+static void testHostEncoderFrames() {
+  const std::vector<Spec> choreography {
+    {.steps = 1600, .factor = 8, .hold = true},
+    {.steps = 1610, .hold = true},
+    {.steps = 1610, .hold = true},
+    {.steps = 1610, .hold = true},
+    {.steps = -50, .delay = 250},
+    {.steps = 0, .factor = 32, .absolute = true},
+    {.steps = 12800, .absolute = true},
+  };
+  const std::vector<uint8_t> choreographyFrame {
+    0x89, 0x03, 0x80, 0x19, 0xA1, 0x94, 0x19, 0x84, 0xFA, 0x01, 0x63, 0x8A, 0x05, 0x00, 0x82, 0x80, 0xC8, 0x01
+  };
+  CHECK(encode(choreography) == choreographyFrame);
+  std::vector<Move> moves;
+  CHECK_EQ(decode(choreographyFrame, moves), ESP_OK);
+  if (CHECK_EQ(moves.size(), choreography.size())) {
+    uint16_t factor = 0;
+    for (size_t i = 0; i < moves.size(); ++i) {
+      Spec expected = choreography[i];
+      factor = expected.factor = expected.factor ? expected.factor : factor;
+      CHECK(matches(moves[i], expected));
+    }
+  }
+  // Nine of the same move: a long record queued 8 times and a short one
+  CHECK_EQ(decode({0xF0, 0xFF, 0x31, 0x00}, moves), ESP_OK);
+  CHECK_EQ(moves.size(), 9);
+  for (const Move &m : moves) {
+    CHECK(matches(m, {.steps = -3200}));
+  }
+  // 80 moves split in frames of 63 bytes at most, each one starting over with the factor in effect
+  const std::vector<std::vector<uint8_t>> frames {
+    {0x80, 0xC8, 0x01, 0x80, 0xC9, 0x01, 0x80, 0xCC, 0x01, 0x80, 0xCD, 0x01, 0x80, 0xD0, 0x01, 0x80,
+     0xD1, 0x01, 0x80, 0xD4, 0x01, 0x80, 0xD5, 0x01, 0x80, 0xD8, 0x01, 0x80, 0xD9, 0x01, 0x80, 0xDC,
+     0x01, 0x80, 0xDD, 0x01, 0x80, 0xE0, 0x01, 0x80, 0xE1, 0x01, 0x80, 0xE4, 0x01, 0x80, 0xE5, 0x01,
+     0x80, 0xE8, 0x01, 0x80, 0xE9, 0x01, 0x80, 0xEC, 0x01, 0x80, 0xED, 0x01, 0x80, 0xF0, 0x01},
+    {0x80, 0xF1, 0x01, 0x80, 0xF4, 0x01, 0x80, 0xF5, 0x01, 0x80, 0xF8, 0x01, 0x80, 0xF9, 0x01, 0x80,
+     0xFC, 0x01, 0x80, 0xFD, 0x01, 0x80, 0x80, 0x02, 0x80, 0x81, 0x02, 0x80, 0x84, 0x02, 0x80, 0x85,
+     0x02, 0x80, 0x88, 0x02, 0x80, 0x89, 0x02, 0x80, 0x8C, 0x02, 0x80, 0x8D, 0x02, 0x80, 0x90, 0x02,
+     0x80, 0x91, 0x02, 0x80, 0x94, 0x02, 0x80, 0x95, 0x02, 0x88, 0x02, 0x98, 0x02},
+    {0x88, 0x02, 0x99, 0x02, 0x80, 0x9C, 0x02, 0x80, 0x9D, 0x02, 0x80, 0xA0, 0x02, 0x80, 0xA1, 0x02,
+     0x80, 0xA4, 0x02, 0x80, 0xA5, 0x02, 0x80, 0xA8, 0x02, 0x80, 0xA9, 0x02, 0x80, 0xAC, 0x02, 0x80,
+     0xAD, 0x02, 0x80, 0xB0, 0x02, 0x80, 0xB1, 0x02, 0x80, 0xB4, 0x02, 0x80, 0xB5, 0x02, 0x80, 0xB8,
+     0x02, 0x80, 0xB9, 0x02, 0x80, 0xBC, 0x02, 0x80, 0xBD, 0x02, 0x80, 0xC0, 0x02},
+    {0x88, 0x02, 0xC1, 0x02, 0x80, 0xC4, 0x02, 0x80, 0xC5, 0x02, 0x80, 0xC8, 0x02, 0x80, 0xC9, 0x02,
+     0x80, 0xCC, 0x02, 0x80, 0xCD, 0x02, 0x80, 0xD0, 0x02, 0x80, 0xD1, 0x02, 0x80, 0xD4, 0x02, 0x80,
+     0xD5, 0x02, 0x80, 0xD8, 0x02, 0x80, 0xD9, 0x02, 0x80, 0xDC, 0x02, 0x80, 0xDD, 0x02, 0x80, 0xE0,
+     0x02, 0x80, 0xE1, 0x02, 0x80, 0xE4, 0x02, 0x80, 0xE5, 0x02},
+  };
+  int32_t i = 0;
+  for (const std::vector<uint8_t> &frame : frames) {
+    CHECK(frame.size() <= 63);
+    CHECK_EQ(decode(frame, moves), ESP_OK);
+    for (const Move &m : moves) {
+      CHECK(matches(m, {.steps = (i % 2 ? -1 : 1) * (100 + i), .factor = static_cast<uint16_t>(i < 40 ? 0 : 4)}));
+      i++;
+    }
+  }
+  CHECK_EQ(i, 80);
+}
+
+int main() {
+  testRecordShapes();
+  testTruncated();
+  testInvalidValues();
+  testCapacity();
+  testRoundTrip();
+  testDensity();
+  testHostEncoderFrames();
+  return host_test::result();
+}
@@ -0,0 +1,65 @@
+#include <cstdlib>
+#include <vector>
+
+#include "HostTest.hpp"
+#include "RampedMove.hpp"
+#include "ReferencePlanner.hpp"
+
+using namespace motor;
+
+// The plan as the float planner made it: one middle segment however long the cruise
+static std::vector<SegmentData> unchained(RampedMove plan) {
+  std::vector<SegmentData> segments;
+  uint32_t middle = (plan.middleSteps() + RampedMove::maxSegmentSteps - 1) / RampedMove::maxSegmentSteps;
+  uint32_t ramp = (plan.size() - middle) / 2;
+  SegmentData seg;
+  for (uint32_t i = 0; plan.next(seg); ++i) {
+    if (i > ramp && i < ramp + middle) {
+      segments.back().steps += seg.steps;
+    } else {
+      segments.push_back(seg);
+    }
+  }
+  return segments;
+}
+
+static_assert(RampedMove::makeRampTable(1).period_us[0] == BASE_PERIOD_US);
+static_assert(RampedMove::makeRampTable(128).segmentSteps == RampedMove::stepsPerSegment * 128);
+
+// Same plans as the float planner, for every factor and every angle it computed exactly
+static void testMatchesFloatPlanner() {
+  for (uint32_t factor = 1; factor <= RampedMove::maxFactor; ++factor) {
+    // Past 2^24 the float step count is rounded before the division
+    int32_t exact = std::min<int32_t>(INT16_MAX, (1 << 24) / (STEPS_PER_REVOLUTION * factor));
+    for (int32_t degrees = -exact; degrees <= exact; ++degrees) {
+      std::vector<SegmentData> expected = reference::generateSegments(degrees, factor);
+      std::vector<SegmentData> actual = unchained(RampedMove(degrees, factor));
+      bool same = CHECK_EQ(actual.size(), expected.size());
+      for (size_t i = 0; same && i < expected.size(); ++i) {
+        same = CHECK_EQ(actual[i].steps, expected[i].steps) && CHECK_EQ(actual[i].period_us, expected[i].period_us);
+      }
+      if (!same) {
+        std::printf("  factor %u, %d degrees\n", factor, degrees);
+        return;
+      }
+    }
+  }
+}
+
+// StepMode factors take the tables built at compile time, other factors build the same table
+static void testRampTables() {
+  for (uint32_t factor = 1; factor <= RampedMove::maxFactor; factor *= 2) {
+    RampTable table = RampedMove::rampTable(factor);
+    RampTable built = RampedMove::makeRampTable(factor);
+    CHECK_EQ(table.segmentSteps, built.segmentSteps);
+    CHECK_EQ(table.size, profile.size());
+    CHECK(table.period_us == built.period_us);
+    CHECK(table.roundedCut);
+  }
+}
+
+int main() {
+  testMatchesFloatPlanner();
+  testRampTables();
+  return host_test::result();
+}
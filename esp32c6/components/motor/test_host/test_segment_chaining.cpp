@@ -0,0 +1,93 @@
+#include <vector>
+
+#include "SimRig.hpp"
+
+using namespace motor;
+
+static const Kinematics kinematics[] = {
+  {.max_velocity = 0, .acceleration = 0, .jerk = 0},
+  {.max_velocity = 1200, .acceleration = 3000, .jerk = 0},
+};
+
+// The PCNT ISR chains a whole plan on the watch points of a ramp segment and the middle head, the
+// chained pieces end on the counter limit
+static void testWatchedSegmentSizes() {
+  for (uint32_t factor = 1; factor <= RampedMove::maxFactor; factor *= 2) {
+    for (int32_t degrees : {1, -9, 90, -720, 3000, 32767}) {
+      RampedMove plan(degrees, factor);
+      uint32_t head = plan.chainedMiddle() ? plan.middleHeadSteps() : plan.middleSteps();
+      SegmentData seg;
+      while (plan.next(seg)) {
+        uint32_t size = std::abs(seg.steps);
+        CHECK(
+          size == plan.rampSegmentSteps() || size == head || (plan.chainedMiddle() && size == RampedMove::maxSegmentSteps)
+        );
+      }
+    }
+  }
+}
+
+// Step period after each step of the plan, the one of the segment the step belongs to
+static std::vector<uint32_t> plannedPeriods(int32_t degrees, uint16_t factor, const Kinematics &k = {}) {
+  std::vector<uint32_t> periods;
+  RampedMove plan(degrees, factor, RampedMove::rampTable(k, factor));
+  SegmentData seg;
+  while (plan.next(seg)) {
+    periods.insert(periods.end(), std::abs(seg.steps), seg.period_us);
+  }
+  return periods;
+}
+
+// Largest difference between the planned step periods and the emitted ones, over the steps both have
+static int64_t boundaryGap(SimRig &rig, const std::vector<uint32_t> &planned) {
+  std::vector<SimBackend::Step> steps = rig.sim->steps();
+  int64_t gap = 0;
+  for (size_t i = 0; i + 1 < std::min(steps.size(), planned.size()); ++i) {
+    gap = std::max<int64_t>(gap, std::abs(steps[i + 1].t_us - steps[i].t_us - planned[i]));
+  }
+  return gap;
+}
+
+// ISR switching runs the planned step train to the microsecond and wakes the task once, at the end
+static void testIsrSwitchHasNoGap() {
+  for (uint16_t factor : {1, 16, 128}) {
+    for (const Kinematics &k : kinematics) {
+      for (int32_t degrees : {90, -720, 3000}) {
+        SimRig rig(SegmentSwitch::ISR, factor, k);
+        std::vector<uint32_t> planned = plannedPeriods(degrees, factor, k);
+        CHECK(rig.runFixed(RampedMove::stepsFor(degrees, factor), 500));
+        CHECK_EQ(rig.sim->steps().size(), planned.size());
+        CHECK_EQ(boundaryGap(rig, planned), 0);
+        CHECK_EQ(rig.wakeups, 1);
+      }
+    }
+  }
+}
+
+// TASK switching is exact only while the task keeps up: a late switch runs on at the old rate, past the end too
+static void testTaskSwitchFollowsTaskLatency() {
+  std::vector<uint32_t> planned = plannedPeriods(720, 16);
+  uint32_t segments = RampedMove(720, 16).size();
+  for (int64_t lag_us : {10, 5000}) {
+    SimRig rig(SegmentSwitch::TASK, 16);
+    CHECK(rig.runFixed(RampedMove::stepsFor(720, 16), lag_us));
+    int64_t gap = boundaryGap(rig, planned);
+    size_t overrun = rig.sim->steps().size() - planned.size();
+    // Step periods of the move are 768 to 3072 us
+    CHECK(lag_us < 768 ? gap == 0 && overrun == 0 : gap > 0 && overrun > 0);
+    CHECK_EQ(rig.wakeups, segments);
+    // The steps of a late switch are counted all the same
+    CHECK_EQ(rig.hal.lastMoveSteps(), rig.sim->steps().size());
+    std::printf(
+      "TASK switch, task %lld us late: off the plan by up to %lld us, %zu steps past the end\n", (long long)lag_us,
+      (long long)gap, overrun
+    );
+  }
+}
+
+int main() {
+  testWatchedSegmentSizes();
+  testIsrSwitchHasNoGap();
+  testTaskSwitchFollowsTaskLatency();
+  return host_test::result();
+}
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#include "HostTest.hpp"
+#include "RampedMove.hpp"
+
+using namespace motor;
+
+// Every heap allocation of the test binary goes through here
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+  ++allocations;
+  if (void *p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+static const Kinematics kinematics[] = {
+  {.max_velocity = 0, .acceleration = 0, .jerk = 0},
+  {.max_velocity = 1200, .acceleration = 3000, .jerk = 0},
+  {.max_velocity = 2000, .acceleration = 8000, .jerk = 40000},
+};
+static const int32_t moves[] = {0, 1, -1, 39, -40, 640, -641, 6400, -51200, 838861, -INT32_MAX / 2};
+
+// Pulling a plan segment by segment matches random access, covers the move and never allocates
+static void testLazyPlan() {
+  for (uint32_t factor = 1; factor <= RampedMove::maxFactor; factor *= 2) {
+    for (const Kinematics &k : kinematics) {
+      for (int32_t steps : moves) {
+        size_t before = allocations;
+        RampedMove plan(steps, RampedMove::rampTable(k, factor));
+        RampedMove copy = plan;
+        uint64_t total = 0;
+        SegmentData seg;
+        for (uint16_t i = 0; plan.next(seg); ++i) {
+          SegmentData at = copy.at(i);
+          CHECK_EQ(seg.steps, at.steps);
+          CHECK_EQ(seg.period_us, at.period_us);
+          CHECK(steps > 0 ? seg.steps > 0 : seg.steps < 0);
+          CHECK(std::abs(seg.steps) <= static_cast<int32_t>(RampedMove::maxSegmentSteps));
+          CHECK_EQ(plan.nextIndex(), i + 1);
+          total += std::abs(seg.steps);
+        }
+        CHECK(!plan.next(seg));
+        CHECK_EQ(plan.nextIndex(), plan.size());
+        CHECK_EQ(allocations, before);
+        CHECK_EQ(total, plan.plannedSteps());
+        // Only the built-in profile rounds a short move to whole ramp segments
+        if (k.max_velocity) {
+          CHECK_EQ(plan.plannedSteps(), static_cast<uint32_t>(std::abs(steps)));
+        }
+      }
+    }
+  }
+}
+
+// A copy is a snapshot: it resumes where the original was, whatever the original does next
+static void testCopyResumes() {
+  RampedMove plan(RampedMove::stepsFor(720, 16), RampedMove::rampTable(16));
+  SegmentData seg;
+  for (int i = 0; i < 5; ++i) {
+    plan.next(seg);
+  }
+  RampedMove copy = plan;
+  while (plan.next(seg)) {
+  }
+  CHECK_EQ(copy.nextIndex(), 5);
+  CHECK(copy.next(seg));
+  CHECK_EQ(seg.period_us, plan.at(5).period_us);
+}
+
+// Limits at the ends of their range: the tables stay within the step counter, fits() tells the ramps cut short
+static void testKinematicsExtremes() {
+  const uint16_t velocities[] = {1, 157, 1000, 20000, UINT16_MAX};
+  const uint16_t accelerations[] = {1, 10, 1000, UINT16_MAX};
+  const uint16_t jerks[] = {0, 1, 100, UINT16_MAX};
+  for (uint16_t v : velocities) {
+    for (uint16_t a : accelerations) {
+      for (uint16_t j : jerks) {
+        Kinematics k {.max_velocity = v, .acceleration = a, .jerk = j};
+        bool reached = true;
+        for (uint32_t factor = 1; factor <= RampedMove::maxFactor; factor *= 2) {
+          RampTable table = RampedMove::rampTable(k, factor);
+          CHECK(table.segmentSteps >= 1 && table.segmentSteps <= RampedMove::maxSegmentSteps);
+          CHECK(table.size >= 1 && table.size <= kMaxRampSegments);
+          for (uint16_t i = 1; i < table.size; ++i) {
+            CHECK(table.period_us[i] <= table.period_us[i - 1]);
+          }
+          // The cruise entry is max_velocity, up to the MIN_PERIOD_US rate cap
+          uint64_t vmax_mhz = std::min<uint64_t>(uint64_t(v) * factor, 1000000 / MIN_PERIOD_US) * 1000;
+          reached = reached && table.period_us[table.size - 1] == 1000000000ULL / vmax_mhz;
+          RampedMove plan(-INT32_MAX / 2, table);
+          SegmentData seg;
+          while (plan.next(seg)) {
+            CHECK(std::abs(seg.steps) <= static_cast<int32_t>(RampedMove::maxSegmentSteps));
+          }
+        }
+        CHECK_EQ(RampedMove::fits(k), reached);
+      }
+    }
+  }
+  // Slow acceleration up to the rate cap is far past the table at full steps, while the finest factor
+  // already starts at the cap
+  const Kinematics slow {.max_velocity = UINT16_MAX, .acceleration = 1, .jerk = 0};
+  CHECK(!RampedMove::fits(slow));
+  CHECK(RampedMove::rampTable(slow, RampedMove::maxFactor).size == 1);
+  for (const Kinematics &k : kinematics) {
+    CHECK(RampedMove::fits(k));
+  }
+}
+
+int main() {
+  testLazyPlan();
+  testKinematicsExtremes();
+  testCopyResumes();
+  return host_test::result();
+}
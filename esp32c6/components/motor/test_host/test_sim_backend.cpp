@@ -0,0 +1,168 @@
+#include <numeric>
+
+#include "SimRig.hpp"
+
+using namespace motor;
+
+// Counts the FromISR calls made through the vtable, which is in flash on the chip
+class VirtualCallSim : public SimBackend {
+  public:
+    uint32_t virtualIsrCalls = 0;
+
+    explicit VirtualCallSim(MotorCfg &cfg) : SimBackend(cfg) {}
+    void releasePulsesFromISR() override {
+      virtualIsrCalls++;
+      SimBackend::releasePulsesFromISR();
+    }
+    void setPeriodFromISR(uint32_t period_us) override {
+      virtualIsrCalls++;
+      SimBackend::setPeriodFromISR(period_us);
+    }
+    void pausePulsesFromISR() override {
+      virtualIsrCalls++;
+      SimBackend::pausePulsesFromISR();
+    }
+    esp_err_t getCount(int &count) override {
+      virtualIsrCalls++;
+      return SimBackend::getCount(count);
+    }
+    void clearCountFromISR() override {
+      virtualIsrCalls++;
+      SimBackend::clearCountFromISR();
+    }
+};
+
+// The driver mode is latched once, with its STBY wait, the steps carry the direction and enable
+static void testDriverPins() {
+  SimRig rig(SegmentSwitch::ISR, 16);
+  CHECK(rig.runFixed(RampedMove::stepsFor(180, 16)));
+  CHECK(rig.runFixed(RampedMove::stepsFor(-180, 16)));
+  CHECK_EQ(rig.sim->latchedMode(), static_cast<uint8_t>(StepMode::ModeBits::FixedSixteenth));
+  CHECK_EQ(rig.sim->modeLatches(), 1);
+  std::vector<SimBackend::Step> steps = rig.sim->steps();
+  CHECK_EQ(steps.front().t_us, SimBackend::kModeLatchUs);
+  size_t half = steps.size() / 2;
+  for (size_t i = 0; i < steps.size(); ++i) {
+    CHECK(steps[i].enabled);
+    CHECK_EQ(steps[i].forward, i < half);
+  }
+}
+
+// An unramped FREE run steps at the base rate until the stopper, which zeroes the position
+static void testStopperEndsFreeRun() {
+  SimRig rig(SegmentSwitch::ISR, 1);
+  Move run {.degrees = -1, .move_type = MoveType::FREE};
+  CHECK_EQ(rig.hal.startMove(run, 1), ESP_OK);
+  host_test::notifications = 0;
+  int64_t start_us = rig.sim->now();
+  rig.sim->advance(100 * BASE_PERIOD_US - 1);
+  CHECK_EQ(rig.sim->steps().size(), 100);
+  CHECK_EQ(rig.sim->steps().front().t_us, start_us);
+  CHECK_EQ(host_test::notifications, 0);
+  rig.sim->triggerStopper();
+  CHECK_EQ(host_test::notifications, 1);
+  rig.hal.stopMove();
+  rig.sim->advance(100 * BASE_PERIOD_US);
+  CHECK_EQ(rig.sim->steps().size(), 100);
+  CHECK_EQ(rig.netSteps(), -100);
+  CHECK(rig.hal.positionKnown());
+  CHECK_EQ(rig.hal.position(), 0);
+  // Disarmed once the run is over
+  rig.sim->triggerStopper();
+  CHECK_EQ(host_test::notifications, 1);
+}
+
+// A ramped FREE run brakes from the stopper edge down its ramp, the stopper ISR not going through the vtable
+static void testStopperBrakesRampedRun() {
+  BasicSimRig<VirtualCallSim> rig(SegmentSwitch::ISR, 8);
+  rig.cfg.freeRun = {.velocity = 400, .acceleration = 1600};
+  Move run {.degrees = 1, .move_type = MoveType::FREE};
+  CHECK_EQ(rig.hal.startMove(run, 1), ESP_OK);
+  host_test::notifications = 0;
+  rig.sim->advance(500000);
+  uint32_t calls = rig.sim->virtualIsrCalls;
+  size_t edge = rig.sim->steps().size();
+  rig.sim->triggerStopper();
+  CHECK_EQ(rig.sim->virtualIsrCalls, calls);
+  CHECK_EQ(host_test::notifications, 0);
+  for (int i = 0; i < 1000 && !host_test::notifications; ++i) {
+    rig.sim->advance(1000);
+  }
+  CHECK_EQ(host_test::notifications, 1);
+  rig.hal.stopMove();
+  CHECK_EQ(rig.hal.freeRunEdgeSteps(), edge);
+  CHECK(rig.sim->steps().size() > edge);
+  CHECK_EQ(rig.hal.overshoot(), (rig.sim->steps().size() - edge) * (POSITION_UNITS_PER_STEP / 8));
+}
+
+// The position follows the steps emitted, in whole moves and in moves stopped part way
+static void testPositionFollowsSteps() {
+  for (SegmentSwitch mode : {SegmentSwitch::ISR, SegmentSwitch::TASK}) {
+    for (uint16_t factor : {1, 4, 32}) {
+      SimRig rig(mode, factor);
+      rig.hal.setPosition(0);
+      CHECK(rig.runFixed(RampedMove::stepsFor(450, factor)));
+      CHECK(rig.runFixed(RampedMove::stepsFor(-90, factor)));
+      Move mv {.degrees = -1};
+      CHECK_EQ(rig.hal.startMove(mv, 1, RampedMove::stepsFor(-720, factor)), ESP_OK);
+      rig.sim->advance(10 * BASE_PERIOD_US);
+      rig.hal.stopMove();
+      CHECK(rig.hal.positionKnown());
+      CHECK_EQ(rig.hal.position(), rig.netSteps() * (POSITION_UNITS_PER_STEP / factor));
+    }
+  }
+}
+
+// An armed move sends no pulse until released, and the release does not go through the vtable
+static void testArmedRelease() {
+  BasicSimRig<VirtualCallSim> rig(SegmentSwitch::ISR, 8);
+  Move mv {.degrees = 1};
+  CHECK_EQ(rig.hal.startMove(mv, 1, RampedMove::stepsFor(90, 8), 0, true), ESP_OK);
+  rig.sim->advance(10000);
+  CHECK(rig.sim->steps().empty());
+  int64_t release_us = rig.sim->now();
+  uint32_t calls = rig.sim->virtualIsrCalls;
+  rig.hal.releaseArmedFromISR();
+  CHECK_EQ(rig.sim->virtualIsrCalls, calls);
+  rig.sim->advance(10 * BASE_PERIOD_US);
+  CHECK(!rig.sim->steps().empty() && rig.sim->steps().front().t_us == release_us);
+  rig.hal.stopMove();
+}
+
+// Back-to-back moves take their planned time, the mode latch and nothing more than the task latency in between
+static void testThroughput() {
+  constexpr int kMoves = 50;
+  constexpr int64_t kLagUs = 20;
+  SimRig rig(SegmentSwitch::ISR, 4);
+  RampedMove plan(90, 4);
+  uint64_t planned_us = 0;
+  uint32_t planned_steps = 0;
+  SegmentData seg;
+  while (plan.next(seg)) {
+    planned_us += uint64_t(std::abs(seg.steps)) * seg.period_us;
+    planned_steps += std::abs(seg.steps);
+  }
+  int32_t steps = RampedMove::stepsFor(90, 4);
+  for (int i = 0; i < kMoves; ++i) {
+    CHECK(rig.runFixed(i % 2 ? -steps : steps, kLagUs));
+  }
+  int64_t elapsed = rig.sim->now();
+  CHECK_EQ(rig.sim->steps().size(), kMoves * planned_steps);
+  CHECK_EQ(rig.netSteps(), 0);
+  CHECK(elapsed <= kMoves * (static_cast<int64_t>(planned_us) + SimBackend::kModeLatchUs + kLagUs));
+  std::printf("%d moves of 90 degrees: %.1f moves/s\n", kMoves, kMoves * 1e6 / elapsed);
+
+  // Every switch of every move goes through the segment switch ISR, and each one is timed
+  const LatencyHistogram &switches = rig.hal.latency().histogram(LatencyStage::SEGMENT_SWITCH);
+  CHECK_EQ(std::accumulate(switches.counts.begin(), switches.counts.end(), 0), kMoves * (plan.size() - 1));
+}
+
+int main() {
+  testDriverPins();
+  testStopperEndsFreeRun();
+  testStopperBrakesRampedRun();
+  testPositionFollowsSteps();
+  testThroughput();
+  testArmedRelease();
+  return host_test::result();
+}
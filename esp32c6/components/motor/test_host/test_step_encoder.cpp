@@ -0,0 +1,78 @@
+#include <vector>
+
+#include "HostTest.hpp"
+#include "StepEncoder.hpp"
+
+using namespace motor;
+
+static_assert(StepEncoder::symbol(3072).duration0 == 384 && StepEncoder::symbol(3072).duration1 == 2688);
+static_assert(StepEncoder::symbol(5).duration0 == 1);
+
+// Step periods the plan asks for, one per step
+static std::vector<uint32_t> plannedPeriods(RampedMove plan) {
+  std::vector<uint32_t> periods;
+  SegmentData seg;
+  while (plan.next(seg)) {
+    periods.insert(periods.end(), std::abs(seg.steps), seg.period_us);
+  }
+  return periods;
+}
+
+// Encoded in chunks of any size, the symbols are the planned step train, one pulse per step
+static void testMatchesPlan() {
+  const Kinematics kinematics[] = {{}, {.max_velocity = 2000, .acceleration = 8000, .jerk = 40000}};
+  for (uint16_t factor : {1, 16, 128}) {
+    for (const Kinematics &k : kinematics) {
+      for (int32_t degrees : {1, -90, 720}) {
+        RampedMove plan(RampedMove::stepsFor(degrees, factor), RampedMove::rampTable(k, factor));
+        std::vector<uint32_t> planned = plannedPeriods(plan);
+        for (size_t capacity : {1, 7, 64, 1000}) {
+          StepEncoder encoder;
+          encoder.reset(plan);
+          std::vector<StepSymbol> chunk(capacity);
+          std::vector<uint32_t> encoded;
+          bool done = false;
+          while (!done) {
+            size_t n = encoder.encode(chunk.data(), capacity, done);
+            if (!CHECK(n == capacity || done)) {
+              return;
+            }
+            for (size_t i = 0; i < n; ++i) {
+              CHECK(chunk[i].level0 == 1 && chunk[i].level1 == 0);
+              CHECK(chunk[i].duration0 >= 1 && chunk[i].duration0 <= chunk[i].duration1);
+              encoded.push_back(chunk[i].duration0 + chunk[i].duration1);
+            }
+          }
+          CHECK(encoded == planned);
+          CHECK_EQ(encoder.encode(chunk.data(), capacity, done), 0);
+          CHECK(done);
+        }
+      }
+    }
+  }
+}
+
+// reset() starts over, a plan without segments is done at once
+static void testReset() {
+  RampedMove plan(RampedMove::stepsFor(45, 2), RampedMove::rampTable(2));
+  StepSymbol symbols[16];
+  bool done = false;
+  StepEncoder encoder;
+  encoder.reset(plan);
+  encoder.encode(symbols, 16, done);
+  encoder.reset(plan);
+  CHECK_EQ(encoder.encode(symbols, 1, done), 1);
+  CHECK_EQ(symbols[0].duration0 + symbols[0].duration1, plan.at(0).period_us);
+  CHECK(!done);
+
+  RampedMove empty;
+  encoder.reset(empty);
+  CHECK_EQ(encoder.encode(symbols, 16, done), 0);
+  CHECK(done);
+}
+
+int main() {
+  testMatchesPlan();
+  testReset();
+  return host_test::result();
+}
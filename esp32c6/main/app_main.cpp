@@ -30,7 +30,9 @@ extern "C" void app_main(void) {
   ESP_LOGI("MAIN", "=== NORMAL MODE ===");
   ESP_ERROR_CHECK(ota::OTA::instance().init());
   // -- App components
-  ESP_ERROR_CHECK(motor::Motor::instance().init());
+  for (uint8_t axis = 0; axis < motor::Motor::kAxisCount; ++axis) {
+    ESP_ERROR_CHECK(motor::Motor::axis(axis).init());
+  }
   ESP_ERROR_CHECK(i2c_slave::I2C::instance().init());
   ESP_ERROR_CHECK(zigbee::Coordinator::instance().init());
 }